@@ -0,0 +1,213 @@
+#include "balancekernel.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BALANCE_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+typedef DebtOvertime (*BalanceFunction)(const qint32*, const qint32*, const qint32*, const qint32*, int);
+
+// SIMD kernels sum debt and overtime in 32-bit lanes and flush them to 64-bit
+// totals every FLUSH_INTERVAL iterations. Debt and overtime of one day are less
+// than 2 * 24 hours, so lanes can't overflow in between
+static constexpr int FLUSH_INTERVAL = 4096;
+
+static inline void addDay(qint32 checkIn, qint32 checkOut, qint32 begin, qint32 end, DebtOvertime* sum)
+{
+    qint32 overlap = qMax(0, qMin(checkIn, end) - qMax(begin, checkOut));
+
+    sum->overtime += qMax(0, begin - checkIn) + qMax(0, checkOut - end);
+    sum->debt     += qMax(0, checkIn - begin) + qMax(0, end - checkOut) - overlap;
+    sum->invalid  += begin < 0;
+}
+
+static DebtOvertime sumScalar(const qint32 *checkIns, const qint32 *checkOuts,
+                              const qint32 *begins, const qint32 *ends, int count)
+{
+    DebtOvertime sum;
+    for (int i = 0; i < count; ++i)
+        addDay(checkIns[i], checkOuts[i], begins[i], ends[i], &sum);
+    return sum;
+}
+
+#ifdef BALANCE_KERNEL_X86
+
+__attribute__((target("sse4.1")))
+static inline __m128i widenSse41(__m128i lanes)
+{
+    return _mm_add_epi64(_mm_cvtepi32_epi64(lanes), _mm_cvtepi32_epi64(_mm_srli_si128(lanes, 8)));
+}
+
+__attribute__((target("sse4.1")))
+static DebtOvertime sumSse41(const qint32 *checkIns, const qint32 *checkOuts,
+                             const qint32 *begins, const qint32 *ends, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i debt64     = zero;
+    __m128i overtime64 = zero;
+    __m128i invalid    = zero;
+
+    int i = 0;
+    while (count - i >= 4)
+    {
+        __m128i debt     = zero;
+        __m128i overtime = zero;
+
+        for (int n = qMin((count - i) / 4, FLUSH_INTERVAL); n > 0; --n, i += 4)
+        {
+            __m128i in  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(checkIns + i));
+            __m128i out = _mm_loadu_si128(reinterpret_cast<const __m128i*>(checkOuts + i));
+            __m128i b   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begins + i));
+            __m128i e   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ends + i));
+
+            __m128i overlap = _mm_max_epi32(_mm_sub_epi32(_mm_min_epi32(in, e), _mm_max_epi32(b, out)), zero);
+
+            overtime = _mm_add_epi32(overtime, _mm_max_epi32(_mm_sub_epi32(b, in), zero));
+            overtime = _mm_add_epi32(overtime, _mm_max_epi32(_mm_sub_epi32(out, e), zero));
+
+            debt = _mm_add_epi32(debt, _mm_max_epi32(_mm_sub_epi32(in, b), zero));
+            debt = _mm_add_epi32(debt, _mm_max_epi32(_mm_sub_epi32(e, out), zero));
+            debt = _mm_sub_epi32(debt, overlap);
+
+            // Comparison gives -1 in lanes with negative schedule begin
+            invalid = _mm_sub_epi32(invalid, _mm_cmplt_epi32(b, zero));
+        }
+
+        debt64     = _mm_add_epi64(debt64, widenSse41(debt));
+        overtime64 = _mm_add_epi64(overtime64, widenSse41(overtime));
+    }
+
+    qint64 d[2], o[2];
+    qint32 v[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d), debt64);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(o), overtime64);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(v), invalid);
+
+    DebtOvertime sum;
+    sum.debt     = d[0] + d[1];
+    sum.overtime = o[0] + o[1];
+    sum.invalid  = v[0] + v[1] + v[2] + v[3];
+
+    for (; i < count; ++i)
+        addDay(checkIns[i], checkOuts[i], begins[i], ends[i], &sum);
+
+    return sum;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i widenAvx2(__m256i lanes)
+{
+    return _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(lanes)),
+                            _mm256_cvtepi32_epi64(_mm256_extracti128_si256(lanes, 1)));
+}
+
+__attribute__((target("avx2")))
+static DebtOvertime sumAvx2(const qint32 *checkIns, const qint32 *checkOuts,
+                            const qint32 *begins, const qint32 *ends, int count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i debt64     = zero;
+    __m256i overtime64 = zero;
+    __m256i invalid    = zero;
+
+    int i = 0;
+    while (count - i >= 8)
+    {
+        __m256i debt     = zero;
+        __m256i overtime = zero;
+
+        for (int n = qMin((count - i) / 8, FLUSH_INTERVAL); n > 0; --n, i += 8)
+        {
+            __m256i in  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(checkIns + i));
+            __m256i out = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(checkOuts + i));
+            __m256i b   = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begins + i));
+            __m256i e   = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ends + i));
+
+            __m256i overlap = _mm256_max_epi32(_mm256_sub_epi32(_mm256_min_epi32(in, e), _mm256_max_epi32(b, out)), zero);
+
+            overtime = _mm256_add_epi32(overtime, _mm256_max_epi32(_mm256_sub_epi32(b, in), zero));
+            overtime = _mm256_add_epi32(overtime, _mm256_max_epi32(_mm256_sub_epi32(out, e), zero));
+
+            debt = _mm256_add_epi32(debt, _mm256_max_epi32(_mm256_sub_epi32(in, b), zero));
+            debt = _mm256_add_epi32(debt, _mm256_max_epi32(_mm256_sub_epi32(e, out), zero));
+            debt = _mm256_sub_epi32(debt, overlap);
+
+            invalid = _mm256_sub_epi32(invalid, _mm256_cmpgt_epi32(zero, b));
+        }
+
+        debt64     = _mm256_add_epi64(debt64, widenAvx2(debt));
+        overtime64 = _mm256_add_epi64(overtime64, widenAvx2(overtime));
+    }
+
+    qint64 d[4], o[4];
+    qint32 v[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(d), debt64);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(o), overtime64);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(v), invalid);
+
+    DebtOvertime sum;
+    sum.debt     = d[0] + d[1] + d[2] + d[3];
+    sum.overtime = o[0] + o[1] + o[2] + o[3];
+    for (int lane = 0; lane < 8; ++lane)
+        sum.invalid += v[lane];
+
+    for (; i < count; ++i)
+        addDay(checkIns[i], checkOuts[i], begins[i], ends[i], &sum);
+
+    return sum;
+}
+
+#endif // BALANCE_KERNEL_X86
+
+static BalanceFunction balanceFunction(BalanceKernel kernel)
+{
+    if (!isBalanceKernelSupported(kernel))
+        return sumScalar;
+
+    switch (kernel)
+    {
+#ifdef BALANCE_KERNEL_X86
+    case BalanceKernel::Sse41:
+        return sumSse41;
+    case BalanceKernel::Avx2:
+        return sumAvx2;
+#endif
+    case BalanceKernel::Auto:
+        return isBalanceKernelSupported(BalanceKernel::Avx2)  ? balanceFunction(BalanceKernel::Avx2) :
+               isBalanceKernelSupported(BalanceKernel::Sse41) ? balanceFunction(BalanceKernel::Sse41) :
+                                                                sumScalar;
+    default:
+        return sumScalar;
+    }
+}
+
+bool isBalanceKernelSupported(BalanceKernel kernel)
+{
+    switch (kernel)
+    {
+    case BalanceKernel::Auto:
+    case BalanceKernel::Scalar:
+        return true;
+#ifdef BALANCE_KERNEL_X86
+    case BalanceKernel::Sse41:
+        return __builtin_cpu_supports("sse4.1");
+    case BalanceKernel::Avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+DebtOvertime sumDebtOvertime(const qint32 *checkIns, const qint32 *checkOuts,
+                             const qint32 *scheduleBegins, const qint32 *scheduleEnds,
+                             int count, BalanceKernel kernel)
+{
+    // CPU features are checked once
+    static const BalanceFunction best = balanceFunction(BalanceKernel::Auto);
+
+    auto function = kernel == BalanceKernel::Auto ? best : balanceFunction(kernel);
+    return function(checkIns, checkOuts, scheduleBegins, scheduleEnds, count);
+}
@@ -0,0 +1,40 @@
+#ifndef BALANCEKERNEL_H
+#define BALANCEKERNEL_H
+
+#include <QtGlobal>
+
+// Batch computation of debt and overtime for days without leave passes.
+// All arrays hold seconds since midnight, for every day i:
+//     overtime = max(0, begin - checkIn) + max(0, checkOut - end)
+//     debt     = max(0, checkIn - begin) + max(0, end - checkOut) - overlap of these two ranges
+// that is the same as WorktimeSnapshot::dayBalance() without leave passes.
+// Days with negative schedule begin are counted as invalid, their debt and overtime are undefined.
+//
+// Auto picks the best kernel supported by the CPU at runtime (AVX2, SSE4.1 or scalar).
+// SIMD kernels are only built for x86 with GCC or Clang, otherwise scalar one is used.
+
+enum class BalanceKernel
+{
+    Auto,
+    Scalar,
+    Sse41,
+    Avx2
+};
+
+struct DebtOvertime
+{
+    qint64 debt     = 0;
+    qint64 overtime = 0;
+    int    invalid  = 0;
+};
+
+bool isBalanceKernelSupported(BalanceKernel kernel);
+
+DebtOvertime sumDebtOvertime(const qint32* checkIns,
+                             const qint32* checkOuts,
+                             const qint32* scheduleBegins,
+                             const qint32* scheduleEnds,
+                             int count,
+                             BalanceKernel kernel = BalanceKernel::Auto);
+
+#endif // BALANCEKERNEL_H
@@ -276,3 +276,117 @@ bool execQueryVerbosely(QSqlQuery *q, const QString &cmd)
 
     return result;
 }
+
+QString scheduleColumnSql()
+{
+    // Assignments don't overlap, so the only candidate is the last one beginning before the date
+    return "COALESCE((SELECT CASE WHEN a.End >= worktime.Date THEN a.Schedule END FROM scheduleassignment a "
+           "WHERE a.Employee = worktime.Employee AND a.Begin <= worktime.Date ORDER BY a.Begin DESC LIMIT 1), "
+           "worktime.Schedule) AS Schedule";
+}
+
+QDate periodBegin(const QDate &date, SummaryPeriod period)
+{
+    if (!date.isValid())
+        return QDate();
+
+    switch (period)
+    {
+    case SummaryPeriod::Week:
+        return date.addDays(1 - date.dayOfWeek());
+    case SummaryPeriod::Month:
+        return QDate(date.year(), date.month(), 1);
+    default:
+        return date;
+    }
+}
+
+QDate periodEnd(const QDate &date, SummaryPeriod period)
+{
+    if (!date.isValid())
+        return QDate();
+
+    switch (period)
+    {
+    case SummaryPeriod::Week:
+        return date.addDays(7 - date.dayOfWeek());
+    case SummaryPeriod::Month:
+        return QDate(date.year(), date.month(), date.daysInMonth());
+    default:
+        return date;
+    }
+}
+
+template <typename Char>
+static inline int digit(Char c, unsigned* bad)
+{
+    unsigned d = unsigned(c) - '0';
+    *bad |= d > 9;
+    return int(d);
+}
+
+template <typename Char>
+static QDate parseIsoDateFixed(const Char* s, int size, bool* ok)
+{
+    unsigned bad = size != 10;
+    if (bad) {
+        *ok = false;
+        return QDate();
+    }
+
+    bad |= (s[4] != '-') | (s[7] != '-');
+
+    int y = digit(s[0], &bad) * 1000 + digit(s[1], &bad) * 100 + digit(s[2], &bad) * 10 + digit(s[3], &bad);
+    int m = digit(s[5], &bad) * 10 + digit(s[6], &bad);
+    int d = digit(s[8], &bad) * 10 + digit(s[9], &bad);
+
+    *ok = !bad && QDate::isValid(y, m, d);
+    return *ok ? QDate(y, m, d) : QDate();
+}
+
+template <typename Char>
+static QTime parseIsoTimeFixed(const Char* s, int size, bool* ok)
+{
+    unsigned bad = size != 8;
+    if (bad) {
+        *ok = false;
+        return QTime();
+    }
+
+    bad |= (s[2] != ':') | (s[5] != ':');
+
+    int h = digit(s[0], &bad) * 10 + digit(s[1], &bad);
+    int m = digit(s[3], &bad) * 10 + digit(s[4], &bad);
+    int sec = digit(s[6], &bad) * 10 + digit(s[7], &bad);
+
+    *ok = !bad && QTime::isValid(h, m, sec);
+    return *ok ? QTime::fromMSecsSinceStartOfDay(((h * 60 + m) * 60 + sec) * 1000) : QTime();
+}
+
+QDate parseIsoDate(const QString &str)
+{
+    bool ok;
+    auto date = parseIsoDateFixed(str.utf16(), str.size(), &ok);
+    return ok ? date : QDate::fromString(str, Qt::ISODate);
+}
+
+QDate parseIsoDate(const char *str, int size)
+{
+    bool ok;
+    auto date = parseIsoDateFixed(str, size, &ok);
+    return ok ? date : QDate::fromString(QString::fromLatin1(str, size), Qt::ISODate);
+}
+
+QTime parseIsoTime(const QString &str)
+{
+    bool ok;
+    auto time = parseIsoTimeFixed(str.utf16(), str.size(), &ok);
+    return ok ? time : QTime::fromString(str, Qt::ISODate);
+}
+
+QTime parseIsoTime(const char *str, int size)
+{
+    bool ok;
+    auto time = parseIsoTimeFixed(str, size, &ok);
+    return ok ? time : QTime::fromString(QString::fromLatin1(str, size), Qt::ISODate);
+}
@@ -3,6 +3,7 @@
 
 #include <QString>
 #include <QTime>
+#include <QDate>
 #include <QSqlQuery>
 
 struct TimeRange
@@ -72,4 +73,29 @@ struct TimeSpan
 
 bool execQueryVerbosely(QSqlQuery* q, const QString& cmd = QString());
 
+// SQL expression for the schedule id of a worktime row, use it instead of
+// worktime.Schedule column. It's resolved by one index lookup of assignments
+QString scheduleColumnSql();
+
+// Periods used to group summaries. Weeks start on Monday
+enum class SummaryPeriod
+{
+    Day,
+    Week,
+    Month
+};
+
+QDate periodBegin(const QDate& date, SummaryPeriod period);
+QDate periodEnd(const QDate& date, SummaryPeriod period);
+
+// Fast parsers for the fixed layouts stored in database: "YYYY-MM-DD" and "HH:MM:SS".
+// Any other input (e.g. "HH:MM" or "HH:MM:SS.zzz") goes through QDate::fromString()
+// and QTime::fromString() with Qt::ISODate, so the result is always the same as Qt's
+
+QDate parseIsoDate(const QString& str);
+QDate parseIsoDate(const char* str, int size);
+
+QTime parseIsoTime(const QString& str);
+QTime parseIsoTime(const char* str, int size);
+
 #endif // HELPER_H
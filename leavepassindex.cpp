@@ -0,0 +1,197 @@
+#include "leavepassindex.h"
+#include <algorithm>
+
+static inline qint32 toSeconds(const QTime& time)
+{
+    return time.msecsSinceStartOfDay() / 1000;
+}
+
+LeavePassIndex::LeavePassIndex()
+    : m_offsets({0})
+{
+
+}
+
+LeavePassIndex::LeavePassIndex(const WorktimeTracker::LeavePassMap &map)
+    : m_offsets({0})
+{
+    m_passes.reserve(map.passes.size());
+
+    for (int i = 0; i < map.size(); ++i)
+    {
+        int first = m_passes.size();
+        for (auto lp = map.begin(i); lp != map.end(i); ++lp)
+            m_passes.append(*lp);
+
+        std::stable_sort(m_passes.begin() + first, m_passes.end(),
+                         [](const WorktimeTracker::LeavePass& a, const WorktimeTracker::LeavePass& b) {
+            return a.from < b.from;
+        });
+
+        m_days.append(qint32(map.dates[i].toJulianDay()));
+        m_offsets.append(m_passes.size());
+    }
+
+    m_begins.reserve(m_passes.size());
+    m_ends.reserve(m_passes.size());
+    m_maxEnds.reserve(m_passes.size());
+
+    for (int i = 0; i < m_days.size(); ++i)
+    {
+        for (int j = m_offsets[i]; j < m_offsets[i + 1]; ++j)
+        {
+            qint32 end = toSeconds(m_passes[j].to);
+            m_begins.append(toSeconds(m_passes[j].from));
+            m_ends.append(end);
+            m_maxEnds.append(j > m_offsets[i] ? qMax(m_maxEnds.last(), end) : end);
+        }
+    }
+}
+
+int LeavePassIndex::size() const
+{
+    return m_passes.size();
+}
+
+void LeavePassIndex::insert(const WorktimeTracker::LeavePass &pass)
+{
+    if (!pass.date.isValid())
+        return;
+
+    qint32 day = qint32(pass.date.toJulianDay());
+
+    auto it = std::lower_bound(m_days.constBegin(), m_days.constEnd(), day);
+    int d = int(it - m_days.constBegin());
+
+    if (it == m_days.constEnd() || *it != day) {
+        m_days.insert(d, day);
+        m_offsets.insert(d + 1, m_offsets[d]);
+    }
+
+    // After passes with the same begin, the same as the stable sort of the constructor
+    qint32 begin = toSeconds(pass.from);
+    int i = int(std::upper_bound(m_begins.constBegin() + m_offsets[d],
+                                 m_begins.constBegin() + m_offsets[d + 1],
+                                 begin) - m_begins.constBegin());
+
+    m_passes.insert(i, pass);
+    m_begins.insert(i, begin);
+    m_ends.insert(i, toSeconds(pass.to));
+    m_maxEnds.insert(i, 0);
+
+    for (int j = d + 1; j < m_offsets.size(); ++j)
+        ++m_offsets[j];
+
+    updateMaxEnds(d, i);
+}
+
+bool LeavePassIndex::remove(const QDate &date, int id)
+{
+    int d = dayIndex(date);
+    if (d < 0)
+        return false;
+
+    for (int i = m_offsets[d]; i < m_offsets[d + 1]; ++i)
+    {
+        if (m_passes[i].id != id)
+            continue;
+
+        m_passes.removeAt(i);
+        m_begins.removeAt(i);
+        m_ends.removeAt(i);
+        m_maxEnds.removeAt(i);
+
+        for (int j = d + 1; j < m_offsets.size(); ++j)
+            --m_offsets[j];
+
+        if (m_offsets[d] == m_offsets[d + 1]) {
+            m_days.removeAt(d);
+            m_offsets.removeAt(d + 1);
+        }
+        else {
+            updateMaxEnds(d, i);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+bool LeavePassIndex::contains(const QDate &date, const QTime &begin, const QTime &end) const
+{
+    int d = dayIndex(date);
+    if (d < 0)
+        return false;
+
+    qint32 b = toSeconds(begin);
+    qint32 e = toSeconds(end);
+
+    for (int i = firstNotBefore(d, b); i < m_offsets[d + 1] && m_begins[i] == b; ++i)
+        if (m_ends[i] == e)
+            return true;
+
+    return false;
+}
+
+bool LeavePassIndex::overlaps(const QDate &date, const QTime &begin, const QTime &end) const
+{
+    int d = dayIndex(date);
+    if (d < 0)
+        return false;
+
+    // Only passes beginning before 'end' can overlap, the one with the latest end among them decides
+    int last = firstNotBefore(d, toSeconds(end)) - 1;
+    return last >= m_offsets[d] && m_maxEnds[last] > toSeconds(begin);
+}
+
+QList<WorktimeTracker::LeavePass> LeavePassIndex::overlapping(const QDate &from, const QDate &to, const QTime &begin, const QTime &end) const
+{
+    QList<WorktimeTracker::LeavePass> list;
+
+    if (!from.isValid() || !to.isValid())
+        return list;
+
+    qint32 b = toSeconds(begin);
+    qint32 e = toSeconds(end);
+
+    auto first = std::lower_bound(m_days.constBegin(), m_days.constEnd(), qint32(qMin(from, to).toJulianDay()));
+    auto last  = std::upper_bound(m_days.constBegin(), m_days.constEnd(), qint32(qMax(from, to).toJulianDay()));
+
+    for (int d = int(first - m_days.constBegin()); d < int(last - m_days.constBegin()); ++d)
+    {
+        QList<WorktimeTracker::LeavePass> day;
+
+        for (int i = firstNotBefore(d, e) - 1; i >= m_offsets[d] && m_maxEnds[i] > b; --i)
+            if (m_ends[i] > b)
+                day.prepend(m_passes[i]);
+
+        list.append(day);
+    }
+
+    return list;
+}
+
+int LeavePassIndex::dayIndex(const QDate &date) const
+{
+    if (!date.isValid())
+        return -1;
+
+    qint32 day = qint32(date.toJulianDay());
+
+    auto it = std::lower_bound(m_days.constBegin(), m_days.constEnd(), day);
+    return it != m_days.constEnd() && *it == day ? int(it - m_days.constBegin()) : -1;
+}
+
+int LeavePassIndex::firstNotBefore(int dayIndex, qint32 time) const
+{
+    return int(std::lower_bound(m_begins.constBegin() + m_offsets[dayIndex],
+                                m_begins.constBegin() + m_offsets[dayIndex + 1],
+                                time) - m_begins.constBegin());
+}
+
+void LeavePassIndex::updateMaxEnds(int dayIndex, int first)
+{
+    for (int i = first; i < m_offsets[dayIndex + 1]; ++i)
+        m_maxEnds[i] = i > m_offsets[dayIndex] ? qMax(m_maxEnds[i - 1], m_ends[i]) : m_ends[i];
+}
@@ -0,0 +1,42 @@
+#ifndef LEAVEPASSINDEX_H
+#define LEAVEPASSINDEX_H
+
+#include "worktimetracker.h"
+
+// Interval index over leave passes of a date range. Passes of each day
+// are sorted by begin and keep the running maximum of their ends, so a pass
+// overlapping [begin, end) is found by a binary search over begins and the
+// search stops as soon as the running maximum is not after 'begin'.
+// Overlap is strict: touching passes don't overlap. Inserting or removing
+// a pass recomputes the running maximum of its day only
+
+class LeavePassIndex
+{
+public:
+    LeavePassIndex();
+    explicit LeavePassIndex(const WorktimeTracker::LeavePassMap& map);
+
+    int size() const;
+
+    void insert(const WorktimeTracker::LeavePass& pass);
+    bool remove(const QDate& date, int id);
+
+    bool contains(const QDate& date, const QTime& begin, const QTime& end) const;
+    bool overlaps(const QDate& date, const QTime& begin, const QTime& end) const;
+
+    // Passes of [from, to] overlapping [begin, end) sorted by date and begin
+    QList<WorktimeTracker::LeavePass> overlapping(const QDate& from, const QDate& to,
+                                                  const QTime& begin, const QTime& end) const;
+
+private:
+    QVector<qint32> m_days;
+    QVector<int>    m_offsets;
+    QVector<qint32> m_begins, m_ends, m_maxEnds;
+    QVector<WorktimeTracker::LeavePass> m_passes;
+
+    int dayIndex(const QDate& date) const;
+    int firstNotBefore(int dayIndex, qint32 time) const;
+    void updateMaxEnds(int dayIndex, int first);
+};
+
+#endif // LEAVEPASSINDEX_H
@@ -0,0 +1,155 @@
+#include "livebalance.h"
+#include <QPair>
+#include <algorithm>
+
+static inline qint32 seconds(const QTime& time)
+{
+    return time.msecsSinceStartOfDay() / 1000;
+}
+
+LiveBalance::LiveBalance(const WorktimeTracker &tracker)
+    : m_tracker(tracker),
+      m_day(0),
+      m_employee(0),
+      m_stale(true),
+      m_missing(false)
+{
+    m_listener = m_tracker.addChangeListener([this](int employee, const QDate& from, const QDate& to) {
+        if (!from.isValid() || (employee == m_employee && from.toJulianDay() <= m_day &&
+                                (m_missing || m_day <= to.toJulianDay())))
+            m_stale = true;
+    });
+}
+
+LiveBalance::~LiveBalance()
+{
+    m_tracker.removeChangeListener(m_listener);
+}
+
+TimeSpan LiveBalance::balance(const QDateTime &time, bool *valid)
+{
+    auto date = time.date();
+
+    if (m_stale || m_day != date.toJulianDay() || m_employee != m_tracker.employee())
+    {
+        // Key of the day is published before reading, so a write during
+        // the read marks it stale again
+        m_day      = date.toJulianDay();
+        m_employee = m_tracker.employee();
+        m_stale    = false;
+
+        if (!load(date))
+            m_stale = true;
+    }
+
+    if (valid)
+        *valid = m_valid;
+
+    if (!m_valid)
+        return TimeSpan();
+
+    qint32 t = seconds(time.time());
+    int i = int(std::upper_bound(m_points.constBegin(), m_points.constEnd(), t) - m_points.constBegin()) - 1;
+
+    return TimeSpan(m_values[i] + qint64(m_slopes[i]) * (t - m_points[i]));
+}
+
+int LiveBalance::loads() const
+{
+    return m_loads;
+}
+
+bool LiveBalance::load(const QDate &date)
+{
+    ++m_loads;
+
+    m_valid  = false;
+    m_points = QVector<qint32>({0});
+    m_values = QVector<qint64>({0});
+    m_slopes = QVector<qint32>({0});
+
+    if (!date.isValid())
+        return false;
+
+    QVector<QPair<qint32, qint32>> debt, overtime;
+
+    // Set before reading, so earlier writes during the read mark the day stale
+    m_missing = true;
+
+    auto record   = m_tracker.getRecord(date);
+    auto calendar = m_tracker.workingCalendar();
+    m_missing = !record.date.isValid() && calendar;
+
+    if (record.date.isValid())
+    {
+
+        if (!record.isValid())
+            return false;
+
+        qint32 checkIn  = seconds(record.checkIn);
+        qint32 checkOut = seconds(record.checkOut);
+        qint32 begin    = seconds(record.schedule->begin);
+        qint32 end      = seconds(record.schedule->end);
+
+        if (checkIn > begin)
+            debt.append(qMakePair(begin, checkIn));
+        else
+            overtime.append(qMakePair(checkIn, begin));
+
+        if (end > checkOut)
+            debt.append(qMakePair(checkOut, end));
+        else
+            overtime.append(qMakePair(end, checkOut));
+
+        for (const auto& pass : m_tracker.getLeavePassList(date))
+            debt.append(qMakePair(seconds(pass.from), seconds(pass.to)));
+    }
+    else if (calendar && calendar->isWorkingDay(date))
+    {
+        // Missing working day is a debt of its whole schedule
+        auto schedule = m_tracker.getScheduleForDate(date);
+
+        qint32 begin = seconds(schedule.begin);
+        debt.append(qMakePair(begin, begin + qint32(m_tracker.getExpectedTime(date).seconds)));
+    }
+
+    // Slope of the balance changes by +1/-1 at bounds of overtime and
+    // merged debt ranges
+    QVector<QPair<qint32, qint32>> events;
+
+    for (const auto& range : overtime) {
+        events.append(qMakePair(range.first, 1));
+        events.append(qMakePair(range.second, -1));
+    }
+
+    std::sort(debt.begin(), debt.end());
+
+    for (int i = 0; i < debt.size(); )
+    {
+        qint32 begin = debt[i].first;
+        qint32 end   = debt[i].second;
+
+        for (++i; i < debt.size() && debt[i].first <= end; ++i)
+            end = qMax(end, debt[i].second);
+
+        if (begin < end) {
+            events.append(qMakePair(begin, -1));
+            events.append(qMakePair(end, 1));
+        }
+    }
+
+    std::sort(events.begin(), events.end());
+
+    for (const auto& event : events)
+    {
+        if (event.first != m_points.last()) {
+            m_values.append(m_values.last() + qint64(m_slopes.last()) * (event.first - m_points.last()));
+            m_slopes.append(m_slopes.last());
+            m_points.append(event.first);
+        }
+        m_slopes.last() += event.second;
+    }
+
+    m_valid = true;
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef LIVEBALANCE_H
+#define LIVEBALANCE_H
+
+#include <QDateTime>
+#include <QVector>
+#include <atomic>
+#include "worktimetracker.h"
+
+// Running balance of a day of the current employee of a tracker, like the balance
+// so far today shown on a kiosk screen. The record, schedule and leave passes of the
+// day are read once and turned into a piecewise linear function of time, so balance()
+// is a binary search without queries. The day is read again only when the tracker
+// reports a write of it (or of an earlier day if it's a missing working day, which takes
+// the schedule of the record before it), the employee of the tracker changes or another
+// day is asked. The tracker must outlive the balance
+
+class LiveBalance
+{
+public:
+    explicit LiveBalance(const WorktimeTracker& tracker);
+    ~LiveBalance();
+
+    // Balance of the day of 'time' up to 'time': debt and overtime are counted until
+    // 'time' only. At the end of the day it's getSummary() of the day. The balance is
+    // zero and 'valid' is false if schedule of the day is unknown or the day can't be read
+    TimeSpan balance(const QDateTime& time = QDateTime::currentDateTime(), bool* valid = nullptr);
+
+    // Number of times the day was read from the tracker
+    int loads() const;
+
+private:
+    Q_DISABLE_COPY(LiveBalance)
+
+    const WorktimeTracker& m_tracker;
+    int                    m_listener;
+
+    // Set by the change listener which may run on another thread
+    std::atomic<qint64> m_day;
+    std::atomic<int>    m_employee;
+    std::atomic<bool>   m_stale;
+    std::atomic<bool>   m_missing;
+
+    bool m_valid    = false;
+    int  m_loads    = 0;
+
+    // For points[i] <= t < points[i + 1] balance is values[i] + slopes[i] * (t - points[i]),
+    // t is seconds since midnight
+    QVector<qint32> m_points;
+    QVector<qint64> m_values;
+    QVector<qint32> m_slopes;
+
+    bool load(const QDate& date);
+};
+
+#endif // LIVEBALANCE_H
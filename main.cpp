@@ -1,6 +1,19 @@
 #include "mainwindow.h"
 #include "testworktimetracker.h"
 #include "testhelper.h"
+#include "testworktimeimporter.h"
+#include "testworktimesnapshot.h"
+#include "testbalancekernel.h"
+#include "testrollupengine.h"
+#include "testsummarycache.h"
+#include "testworkingcalendar.h"
+#include "testleavepassindex.h"
+#include "testpresenceheatmap.h"
+#include "testlivebalance.h"
+#include "testworktimewriter.h"
+#include "testpunchaggregator.h"
+#include "testworktimestate.h"
+#include "testworktimestorage.h"
 
 #include <QApplication>
 
@@ -15,6 +28,45 @@ void test()
 
     TestWorktimeTracker testWorktimeTracker;
     QTest::qExec(&testWorktimeTracker, args);
+
+    TestWorktimeImporter testWorktimeImporter;
+    QTest::qExec(&testWorktimeImporter, args);
+
+    TestWorktimeSnapshot testWorktimeSnapshot;
+    QTest::qExec(&testWorktimeSnapshot, args);
+
+    TestBalanceKernel testBalanceKernel;
+    QTest::qExec(&testBalanceKernel, args);
+
+    TestRollupEngine testRollupEngine;
+    QTest::qExec(&testRollupEngine, args);
+
+    TestSummaryCache testSummaryCache;
+    QTest::qExec(&testSummaryCache, args);
+
+    TestWorkingCalendar testWorkingCalendar;
+    QTest::qExec(&testWorkingCalendar, args);
+
+    TestLeavePassIndex testLeavePassIndex;
+    QTest::qExec(&testLeavePassIndex, args);
+
+    TestPresenceHeatmap testPresenceHeatmap;
+    QTest::qExec(&testPresenceHeatmap, args);
+
+    TestLiveBalance testLiveBalance;
+    QTest::qExec(&testLiveBalance, args);
+
+    TestWorktimeWriter testWorktimeWriter;
+    QTest::qExec(&testWorktimeWriter, args);
+
+    TestPunchAggregator testPunchAggregator;
+    QTest::qExec(&testPunchAggregator, args);
+
+    TestWorktimeState testWorktimeState;
+    QTest::qExec(&testWorktimeState, args);
+
+    TestWorktimeStorage testWorktimeStorage;
+    QTest::qExec(&testWorktimeStorage, args);
 }
 
 int main(int argc, char *argv[])
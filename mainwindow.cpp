@@ -4,6 +4,7 @@
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlTableModel>
+#include <QSqlRelationalTableModel>
 #include <QSqlError>
 #include <QDateTime>
 #include "worktimetracker.h"
@@ -22,8 +23,10 @@ MainWindow::MainWindow(QWidget *parent)
 
     WorktimeTracker wt = TestWorktimeTracker::example(db);
 
-    auto model = new QSqlTableModel(this);
+    // Show schedule names instead of their ids
+    auto model = new QSqlRelationalTableModel(this);
     model->setTable("worktime");
+    model->setRelation(model->fieldIndex("Schedule"), QSqlRelation("schedule", "Id", "Name"));
     model->select();
 
     ui->tableView->setModel(model);
@@ -37,8 +40,10 @@ MainWindow::~MainWindow()
 
 void MainWindow::on_worktimeBtn_clicked()
 {
-    auto model = new QSqlTableModel(this);
+    // Show schedule names instead of their ids
+    auto model = new QSqlRelationalTableModel(this);
     model->setTable("worktime");
+    model->setRelation(model->fieldIndex("Schedule"), QSqlRelation("schedule", "Id", "Name"));
     model->select();
 
     ui->tableView->setModel(model);
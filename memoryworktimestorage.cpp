@@ -0,0 +1,422 @@
+#include "memoryworktimestorage.h"
+#include <algorithm>
+#include <limits>
+
+static inline qint32 toDay(const QDate& date)
+{
+    return qint32(date.toJulianDay());
+}
+
+MemoryWorktimeStorage::MemoryWorktimeStorage(WorktimeStorage *backing)
+    : m_backing(backing),
+      m_schedulesLoaded(false)
+{
+
+}
+
+bool MemoryWorktimeStorage::insertRecord(int employee, const Record &record)
+{
+    if (!record.isValid())
+        return false;
+
+    auto e = this->employee(employee);
+    if (!e)
+        return false;
+
+    int i = recordIndex(*e, record.day);
+    if (i < e->records.size() && e->records[i].day == record.day)
+        return false;
+
+    if (m_backing && !m_backing->insertRecord(employee, record))
+        return false;
+
+    e->records.insert(i, record);
+    return true;
+}
+
+bool MemoryWorktimeStorage::updateRecord(int employee, const Record &record)
+{
+    if (!record.isValid())
+        return false;
+
+    auto e = this->employee(employee);
+    if (!e)
+        return false;
+
+    int i = recordIndex(*e, record.day);
+    if (i == e->records.size() || e->records[i].day != record.day)
+        return false;
+
+    if (m_backing && !m_backing->updateRecord(employee, record))
+        return false;
+
+    e->records[i] = record;
+    return true;
+}
+
+bool MemoryWorktimeStorage::removeRecord(int employee, const QDate &date)
+{
+    auto e = this->employee(employee);
+    if (!e || !date.isValid())
+        return false;
+
+    int i = recordIndex(*e, toDay(date));
+    if (i == e->records.size() || e->records[i].day != toDay(date))
+        return false;
+
+    if (m_backing && !m_backing->removeRecord(employee, date))
+        return false;
+
+    e->records.remove(i);
+    return true;
+}
+
+bool MemoryWorktimeStorage::getRecord(int employee, const QDate &date, Record *record) const
+{
+    auto e = this->employee(employee);
+    if (!e || !date.isValid())
+        return false;
+
+    int i = recordIndex(*e, toDay(date));
+    if (i == e->records.size() || e->records[i].day != toDay(date))
+        return false;
+
+    *record = e->records[i];
+    return true;
+}
+
+bool MemoryWorktimeStorage::getRecords(int employee, const QDate &from, const QDate &to, QVector<Record> *records) const
+{
+    auto e = this->employee(employee);
+    if (!e)
+        return false;
+
+    qint32 first, last;
+    range(from, to, &first, &last);
+
+    int begin = recordIndex(*e, first);
+    int end   = last < std::numeric_limits<qint32>::max() ? recordIndex(*e, last + 1) : e->records.size();
+
+    *records = e->records.mid(begin, end - begin);
+    return true;
+}
+
+bool MemoryWorktimeStorage::setCheckIns(int employee, const QDate &from, const QDate &to, const QTime &time)
+{
+    return setTimes(employee, from, to, time, true);
+}
+
+bool MemoryWorktimeStorage::setCheckOuts(int employee, const QDate &from, const QDate &to, const QTime &time)
+{
+    return setTimes(employee, from, to, time, false);
+}
+
+bool MemoryWorktimeStorage::assignSchedule(int employee, int id, const QDate &from, const QDate &to)
+{
+    auto e = this->employee(employee);
+    if (!e || id <= 0 || !from.isValid())
+        return false;
+
+    if (m_backing && !m_backing->assignSchedule(employee, id, from, to))
+        return false;
+
+    qint32 first, last;
+    range(from, to, &first, &last);
+
+    for (int i = recordIndex(*e, first); i < e->records.size() && e->records[i].day <= last; ++i)
+        e->records[i].setScheduleId(id);
+
+    return true;
+}
+
+bool MemoryWorktimeStorage::insertSchedule(Schedule *schedule)
+{
+    if (!schedule->isValid() || !loadSchedules())
+        return false;
+
+    for (const auto& s : m_schedules)
+        if (s.name == schedule->name)
+            return false;
+
+    if (m_backing) {
+        if (!m_backing->insertSchedule(schedule))
+            return false;
+    }
+    else {
+        schedule->id = m_schedules.isEmpty() ? 1 : m_schedules.last().id + 1;
+    }
+
+    m_schedules.append(*schedule);
+    return true;
+}
+
+bool MemoryWorktimeStorage::getSchedule(int id, Schedule *schedule) const
+{
+    if (!loadSchedules())
+        return false;
+
+    // Schedules are sorted by id
+    auto it = std::lower_bound(m_schedules.constBegin(), m_schedules.constEnd(), id,
+                               [](const Schedule& s, int id) { return s.id < id; });
+    if (it == m_schedules.constEnd() || it->id != id)
+        return false;
+
+    *schedule = *it;
+    return true;
+}
+
+bool MemoryWorktimeStorage::getSchedule(const QString &name, Schedule *schedule) const
+{
+    if (!loadSchedules())
+        return false;
+
+    for (const auto& s : m_schedules)
+    {
+        if (s.name == name) {
+            *schedule = s;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MemoryWorktimeStorage::getSchedules(QVector<Schedule> *schedules) const
+{
+    if (!loadSchedules())
+        return false;
+
+    *schedules = m_schedules;
+    return true;
+}
+
+bool MemoryWorktimeStorage::insertLeavePass(int employee, LeavePass *pass)
+{
+    if (!pass->date.isValid() || !pass->from.isValid() || !pass->to.isValid())
+        return false;
+
+    auto e = this->employee(employee);
+    if (!e)
+        return false;
+
+    qint32 day = toDay(pass->date);
+    int    i   = dayIndex(*e, day);
+    bool   found = i < e->leavePassDays.size() && e->leavePassDays[i] == day;
+
+    if (m_backing) {
+        if (!m_backing->insertLeavePass(employee, pass))
+            return false;
+    }
+    else {
+        // Passes of a day are sorted by id
+        pass->id = found && e->leavePasses[i].size() > 0 ? e->leavePasses[i][e->leavePasses[i].size() - 1].id + 1 : 0;
+    }
+
+    if (!found) {
+        e->leavePassDays.insert(i, day);
+        e->leavePasses.insert(i, DayLeavePasses());
+    }
+
+    e->leavePasses[i].append(*pass);
+    return true;
+}
+
+bool MemoryWorktimeStorage::updateLeavePass(int employee, const LeavePass &pass)
+{
+    if (!pass.date.isValid() || !pass.from.isValid() || !pass.to.isValid())
+        return false;
+
+    auto e = this->employee(employee);
+    if (!e)
+        return false;
+
+    int i = dayIndex(*e, toDay(pass.date));
+    if (i == e->leavePassDays.size() || e->leavePassDays[i] != toDay(pass.date))
+        return false;
+
+    int j = leavePassIndex(e->leavePasses[i], pass.id);
+    if (j < 0)
+        return false;
+
+    if (m_backing && !m_backing->updateLeavePass(employee, pass))
+        return false;
+
+    e->leavePasses[i][j] = pass;
+    return true;
+}
+
+bool MemoryWorktimeStorage::removeLeavePass(int employee, const QDate &date, int id)
+{
+    auto e = this->employee(employee);
+    if (!e || !date.isValid())
+        return false;
+
+    int i = dayIndex(*e, toDay(date));
+    if (i == e->leavePassDays.size() || e->leavePassDays[i] != toDay(date))
+        return false;
+
+    int j = leavePassIndex(e->leavePasses[i], id);
+    if (j < 0)
+        return false;
+
+    if (m_backing && !m_backing->removeLeavePass(employee, date, id))
+        return false;
+
+    e->leavePasses[i].remove(j);
+
+    if (e->leavePasses[i].size() == 0) {
+        e->leavePassDays.remove(i);
+        e->leavePasses.remove(i);
+    }
+
+    return true;
+}
+
+bool MemoryWorktimeStorage::getLeavePasses(int employee, const QDate &from, const QDate &to, QVector<LeavePass> *passes) const
+{
+    auto e = this->employee(employee);
+    if (!e)
+        return false;
+
+    qint32 first, last;
+    range(from, to, &first, &last);
+
+    int begin = dayIndex(*e, first);
+    int end   = last < std::numeric_limits<qint32>::max() ? dayIndex(*e, last + 1) : e->leavePassDays.size();
+
+    passes->clear();
+    for (int i = begin; i < end; ++i)
+        for (const auto& pass : e->leavePasses[i])
+            passes->append(pass);
+
+    return true;
+}
+
+void MemoryWorktimeStorage::clear()
+{
+    m_employees.clear();
+    m_schedules.clear();
+    m_schedulesLoaded = false;
+}
+
+void MemoryWorktimeStorage::invalidate()
+{
+    // Data of the storage alone has nowhere to be read from again
+    if (m_backing)
+        clear();
+}
+
+QSqlDatabase MemoryWorktimeStorage::database() const
+{
+    return m_backing ? m_backing->database() : QSqlDatabase();
+}
+
+MemoryWorktimeStorage::Employee *MemoryWorktimeStorage::employee(int id) const
+{
+    if (m_employees.contains(id))
+        return &m_employees[id];
+
+    Employee e;
+
+    if (m_backing) {
+        QVector<LeavePass> passes;
+        if (!m_backing->getRecords(id, QDate(), QDate(), &e.records) ||
+            !m_backing->getLeavePasses(id, QDate(), QDate(), &passes))
+            return nullptr;
+
+        // Passes are sorted by date and id, so each day is one run
+        for (const auto& pass : passes)
+        {
+            qint32 day = toDay(pass.date);
+            if (e.leavePassDays.isEmpty() || e.leavePassDays.last() != day) {
+                e.leavePassDays.append(day);
+                e.leavePasses.append(DayLeavePasses());
+            }
+            e.leavePasses.last().append(pass);
+        }
+    }
+
+    m_employees.insert(id, e);
+    return &m_employees[id];
+}
+
+bool MemoryWorktimeStorage::setTimes(int employee, const QDate &from, const QDate &to, const QTime &time, bool checkIn)
+{
+    auto e = this->employee(employee);
+    if (!e || !time.isValid())
+        return false;
+
+    if (m_backing && !(checkIn ? m_backing->setCheckIns(employee, from, to, time)
+                               : m_backing->setCheckOuts(employee, from, to, time)))
+        return false;
+
+    qint32 first, last;
+    range(from, to, &first, &last);
+
+    auto seconds = quint32(time.msecsSinceStartOfDay() / 1000);
+    bool changed = false;
+
+    // The same conditions as in SqlWorktimeStorage, missing times never match
+    for (int i = recordIndex(*e, first); i < e->records.size() && e->records[i].day <= last; ++i)
+    {
+        auto& r = e->records[i];
+
+        if (checkIn && r.checkOut != Record::NO_TIME && r.checkOut >= seconds) {
+            r.checkIn = seconds;
+            changed = true;
+        }
+        else if (!checkIn && r.checkIn != Record::NO_TIME && r.checkIn <= seconds) {
+            r.checkOut = seconds;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+bool MemoryWorktimeStorage::loadSchedules() const
+{
+    if (m_schedulesLoaded)
+        return true;
+
+    if (m_backing && !m_backing->getSchedules(&m_schedules))
+        return false;
+
+    m_schedulesLoaded = true;
+    return true;
+}
+
+int MemoryWorktimeStorage::recordIndex(const Employee &e, qint32 day)
+{
+    auto it = std::lower_bound(e.records.constBegin(), e.records.constEnd(), day,
+                               [](const Record& r, qint32 d) { return r.day < d; });
+    return int(it - e.records.constBegin());
+}
+
+int MemoryWorktimeStorage::dayIndex(const Employee &e, qint32 day)
+{
+    return int(std::lower_bound(e.leavePassDays.constBegin(), e.leavePassDays.constEnd(), day) - e.leavePassDays.constBegin());
+}
+
+int MemoryWorktimeStorage::leavePassIndex(const DayLeavePasses &passes, int id)
+{
+    for (int i = 0; i < passes.size(); ++i)
+        if (passes[i].id == id)
+            return i;
+
+    return -1;
+}
+
+void MemoryWorktimeStorage::range(const QDate &from, const QDate &to, qint32 *first, qint32 *last)
+{
+    // Invalid 'from' means all dates
+    if (!from.isValid()) {
+        *first = std::numeric_limits<qint32>::min();
+        *last  = std::numeric_limits<qint32>::max();
+        return;
+    }
+
+    auto _to = to.isValid() ? to : from;
+    *first = toDay(qMin(from, _to));
+    *last  = toDay(qMax(from, _to));
+}
@@ -0,0 +1,77 @@
+#ifndef MEMORYWORKTIMESTORAGE_H
+#define MEMORYWORKTIMESTORAGE_H
+
+#include <QHash>
+#include <QVarLengthArray>
+#include "worktimestorage.h"
+
+// Storage in memory. Records of an employee are a flat array sorted by Julian day and
+// leave passes are small per-day arrays indexed by a sorted array of their days, so
+// lookups are binary searches and range scans read contiguous memory.
+//
+// With a backing storage it's a write-through cache: data of an employee is read from
+// the backing storage on the first access, writes go to the backing storage first and
+// are applied in memory only if they succeed, reads never reach it. The backing storage
+// must outlive the cache and mustn't be written by anyone else. It isn't thread-safe
+
+class MemoryWorktimeStorage : public WorktimeStorage
+{
+public:
+    explicit MemoryWorktimeStorage(WorktimeStorage* backing = nullptr);
+
+    bool insertRecord(int employee, const Record& record) override;
+    bool updateRecord(int employee, const Record& record) override;
+    bool removeRecord(int employee, const QDate& date) override;
+    bool getRecord(int employee, const QDate& date, Record* record) const override;
+    bool getRecords(int employee, const QDate& from, const QDate& to, QVector<Record>* records) const override;
+
+    // Assigned schedule is written into the records of the range, memory doesn't keep assignments
+    bool setCheckIns(int employee, const QDate& from, const QDate& to, const QTime& time) override;
+    bool setCheckOuts(int employee, const QDate& from, const QDate& to, const QTime& time) override;
+    bool assignSchedule(int employee, int id, const QDate& from, const QDate& to) override;
+
+    bool insertSchedule(Schedule* schedule) override;
+    bool getSchedule(int id, Schedule* schedule) const override;
+    bool getSchedule(const QString& name, Schedule* schedule) const override;
+    bool getSchedules(QVector<Schedule>* schedules) const override;
+
+    bool insertLeavePass(int employee, LeavePass* pass) override;
+    bool updateLeavePass(int employee, const LeavePass& pass) override;
+    bool removeLeavePass(int employee, const QDate& date, int id) override;
+    bool getLeavePasses(int employee, const QDate& from, const QDate& to, QVector<LeavePass>* passes) const override;
+
+    // Drops all data, with backing storage it's read again on the next access
+    void clear();
+    // clear() if there is a backing storage
+    void invalidate() override;
+    // The one of the backing storage
+    QSqlDatabase database() const override;
+
+private:
+    typedef QVarLengthArray<LeavePass, 2> DayLeavePasses;
+
+    struct Employee
+    {
+        QVector<Record>         records;
+        QVector<qint32>         leavePassDays;
+        QVector<DayLeavePasses> leavePasses;
+    };
+
+    WorktimeStorage* m_backing;
+
+    // Filled by reads too when data is taken from the backing storage
+    mutable QHash<int, Employee> m_employees;
+    mutable QVector<Schedule>    m_schedules;
+    mutable bool                 m_schedulesLoaded;
+
+    Employee* employee(int id) const;
+    bool setTimes(int employee, const QDate& from, const QDate& to, const QTime& time, bool checkIn);
+    bool loadSchedules() const;
+
+    static int recordIndex(const Employee& e, qint32 day);
+    static int dayIndex(const Employee& e, qint32 day);
+    static int leavePassIndex(const DayLeavePasses& passes, int id);
+    static void range(const QDate& from, const QDate& to, qint32* first, qint32* last);
+};
+
+#endif // MEMORYWORKTIMESTORAGE_H
@@ -0,0 +1,116 @@
+#include "presenceheatmap.h"
+#include <QVarLengthArray>
+#include <QPair>
+#include <algorithm>
+
+constexpr int PresenceHeatmap::SLOTS;
+
+static inline qint32 toSeconds(const QTime& time)
+{
+    return time.msecsSinceStartOfDay() / 1000;
+}
+
+PresenceHeatmap::PresenceHeatmap()
+    : m_diff(SLOTS + 1, 0), m_days(0)
+{
+
+}
+
+void PresenceHeatmap::addDay(qint32 checkIn, qint32 checkOut, const qint32 *leavePassBegins, const qint32 *leavePassEnds, int leavePassCount)
+{
+    int in  = qBound(0, checkIn / 60, SLOTS);
+    int out = qBound(0, checkOut / 60, SLOTS);
+
+    if (in >= out)
+        return;
+
+    QVarLengthArray<QPair<int, int>, 8> leave;
+    for (int i = 0; i < leavePassCount; ++i)
+    {
+        int begin = qMax(in, leavePassBegins[i] / 60);
+        int end   = qMin(out, leavePassEnds[i] / 60);
+        if (begin < end)
+            leave.append(qMakePair(begin, end));
+    }
+
+    std::sort(leave.begin(), leave.end());
+
+    ++m_diff[in];
+    --m_diff[out];
+
+    for (int i = 0; i < leave.size(); )
+    {
+        int begin = leave[i].first;
+        int end   = leave[i].second;
+
+        for (++i; i < leave.size() && leave[i].first <= end; ++i)
+            end = qMax(end, leave[i].second);
+
+        --m_diff[begin];
+        ++m_diff[end];
+    }
+
+    ++m_days;
+}
+
+bool PresenceHeatmap::addRecords(const WorktimeTracker &tracker, const QDate &from, const QDate &to)
+{
+    if (!from.isValid() || !to.isValid())
+        return false;
+
+    auto records     = tracker.getCompactRecords(from, to);
+    auto leavePasses = tracker.getLeavePasses(from, to);
+
+    QVarLengthArray<qint32, 8> begins, ends;
+    int lp = 0;
+
+    for (const auto& r : records)
+    {
+        if (!r.isValid() || r.checkIn == WorktimeTracker::CompactRecord::NO_TIME ||
+            r.checkOut == WorktimeTracker::CompactRecord::NO_TIME)
+            continue;
+
+        // Both are sorted by date
+        while (lp < leavePasses.size() && leavePasses.dates[lp].toJulianDay() < r.day)
+            ++lp;
+
+        begins.clear();
+        ends.clear();
+
+        if (lp < leavePasses.size() && leavePasses.dates[lp].toJulianDay() == r.day) {
+            for (auto it = leavePasses.begin(lp); it != leavePasses.end(lp); ++it) {
+                begins.append(toSeconds(it->from));
+                ends.append(toSeconds(it->to));
+            }
+        }
+
+        addDay(r.checkIn, r.checkOut, begins.constData(), ends.constData(), begins.size());
+    }
+
+    return true;
+}
+
+void PresenceHeatmap::clear()
+{
+    m_diff.fill(0);
+    m_days = 0;
+}
+
+int PresenceHeatmap::days() const
+{
+    return m_days;
+}
+
+QVector<int> PresenceHeatmap::minutes() const
+{
+    QVector<int> minutes(SLOTS);
+
+    int count = 0;
+    for (int i = 0; i < SLOTS; ++i)
+    {
+        count += m_diff[i];
+        minutes[i] = count;
+    }
+
+    return minutes;
+}
@@ -0,0 +1,39 @@
+#ifndef PRESENCEHEATMAP_H
+#define PRESENCEHEATMAP_H
+
+#include <QVector>
+#include "worktimetracker.h"
+
+// Occupancy of each minute of a day accumulated over days and employees.
+// Every day adds +1 at check in and -1 at check out minute of a difference
+// array, its leave passes do the opposite, so minutes() is a single prefix sum.
+// Leave passes of a day are merged and clipped to check in/out first, so
+// overlapping passes aren't subtracted twice. Times are rounded down to minutes
+
+class PresenceHeatmap
+{
+public:
+    static constexpr int SLOTS = 24 * 60;
+
+    PresenceHeatmap();
+
+    // Times are seconds since midnight
+    void addDay(qint32 checkIn, qint32 checkOut,
+                const qint32* leavePassBegins, const qint32* leavePassEnds,
+                int leavePassCount);
+
+    // Adds days of the current employee of the tracker
+    bool addRecords(const WorktimeTracker& tracker, const QDate& from, const QDate& to);
+
+    void clear();
+    int  days() const;
+
+    // Number of days covering each minute of a day
+    QVector<int> minutes() const;
+
+private:
+    QVector<int> m_diff;
+    int          m_days;
+};
+
+#endif // PRESENCEHEATMAP_H
@@ -0,0 +1,99 @@
+#include "punchaggregator.h"
+#include <QSqlError>
+#include <QDebug>
+#include <memory>
+
+PunchAggregator::PunchAggregator(const WorktimeTracker &tracker, int interval)
+    : m_tracker(tracker),
+      m_interval(qMax(1, interval))
+{
+    m_thread = std::thread(&PunchAggregator::run, this);
+}
+
+PunchAggregator::~PunchAggregator()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stop = true;
+        m_wake.wakeOne();
+    }
+    m_thread.join();
+}
+
+bool PunchAggregator::flush()
+{
+    QMutexLocker locker(&m_mutex);
+
+    int request = ++m_requested;
+    m_wake.wakeOne();
+
+    while (m_done < request)
+        m_finished.wait(&m_mutex);
+
+    return m_ok;
+}
+
+int PunchAggregator::aggregatedCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_count;
+}
+
+void PunchAggregator::run()
+{
+    struct Change
+    {
+        int   employee;
+        QDate from, to;
+    };
+    QVector<Change> changes;
+
+    auto connection = QString("punch-aggregator-%1").arg(qulonglong(quintptr(this)));
+    {
+        auto db = QSqlDatabase::cloneDatabase(m_tracker.database().connectionName(), connection);
+
+        std::unique_ptr<WorktimeTracker> tracker;
+        if (db.open()) {
+            auto schedule = m_tracker.defaultSchedule();
+            tracker.reset(new WorktimeTracker(db, schedule.begin, schedule.end, schedule.lunchTimeBegin, schedule.lunchTimeEnd));
+
+            tracker->addChangeListener([&changes](int employee, const QDate& from, const QDate& to) {
+                changes.append({employee, from, to});
+            });
+        }
+        else {
+            qDebug() << "Can't open connection of punch aggregator:" << db.lastError().text();
+        }
+
+        m_mutex.lock();
+        while (!m_stop)
+        {
+            // Aggregates on timeout or on request
+            if (m_requested == m_done && m_wake.wait(&m_mutex, m_interval))
+                continue;
+
+            int request = m_requested;
+            m_mutex.unlock();
+
+            int count = tracker ? tracker->aggregatePunches() : -1;
+
+            // Days are reported after the commit of the aggregation
+            if (count >= 0) {
+                for (const auto& change : changes)
+                    m_tracker.notifyDataChanged(change.employee, change.from, change.to, db);
+            }
+            changes.clear();
+
+            m_mutex.lock();
+            m_done  = request;
+            m_ok    = count >= 0;
+            m_count += qMax(0, count);
+            m_finished.wakeAll();
+        }
+        m_mutex.unlock();
+
+        tracker.reset();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connection);
+}
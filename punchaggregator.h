@@ -0,0 +1,50 @@
+#ifndef PUNCHAGGREGATOR_H
+#define PUNCHAGGREGATOR_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <thread>
+#include "worktimetracker.h"
+
+// Folds punches into worktime and leavepass rows in background, so adding a punch
+// costs the same however much work the aggregation is. The aggregator thread calls
+// WorktimeTracker::aggregatePunches() on its own connection every 'interval'
+// milliseconds and whenever flush() is called. Aggregated days are reported to the
+// tracker by WorktimeTracker::notifyDataChanged(). The database must be a file,
+// not :memory:
+
+class PunchAggregator
+{
+public:
+    static constexpr int DEFAULT_INTERVAL = 1000;
+
+    explicit PunchAggregator(const WorktimeTracker& tracker, int interval = DEFAULT_INTERVAL);
+    ~PunchAggregator();
+
+    // Waits until punches added before the call are aggregated
+    bool flush();
+
+    // Number of punches aggregated by this aggregator
+    int aggregatedCount() const;
+
+private:
+    Q_DISABLE_COPY(PunchAggregator)
+
+    WorktimeTracker m_tracker;
+    int             m_interval;
+
+    mutable QMutex  m_mutex;
+    QWaitCondition  m_wake;
+    QWaitCondition  m_finished;
+    int             m_requested = 0;
+    int             m_done      = 0;
+    int             m_count     = 0;
+    bool            m_ok        = true;
+    bool            m_stop      = false;
+
+    std::thread m_thread;
+
+    void run();
+};
+
+#endif // PUNCHAGGREGATOR_H
@@ -0,0 +1,151 @@
+#include "rollupengine.h"
+#include <QtConcurrent/QtConcurrent>
+
+constexpr int RollupEngine::COMPANY;
+
+RollupEngine::RollupEngine(const WorktimeTracker &tracker)
+    : m_tracker(tracker)
+{
+    m_units.insert(COMPANY, {"company", -1});
+}
+
+bool RollupEngine::addUnit(int unit, const QString &name, int parent)
+{
+    if (m_units.contains(unit) || !m_units.contains(parent))
+        return false;
+
+    m_units.insert(unit, {name, parent});
+    return true;
+}
+
+bool RollupEngine::assignEmployee(int employee, int unit)
+{
+    if (!m_units.contains(unit))
+        return false;
+
+    m_employeeUnits.insert(employee, unit);
+    return true;
+}
+
+QList<int> RollupEngine::units() const
+{
+    auto units = m_units.keys();
+    std::sort(units.begin(), units.end());
+    return units;
+}
+
+QString RollupEngine::unitName(int unit) const
+{
+    return m_units.value(unit).name;
+}
+
+int RollupEngine::parentUnit(int unit) const
+{
+    return m_units.contains(unit) ? m_units.value(unit).parent : -1;
+}
+
+int RollupEngine::employeeUnit(int employee) const
+{
+    return m_employeeUnits.value(employee, -1);
+}
+
+QHash<int, RollupEngine::Series> RollupEngine::rollup(const QDate &from, const QDate &to, SummaryPeriod period) const
+{
+    QHash<int, Series> result;
+    for (auto it = m_units.constBegin(); it != m_units.constEnd(); ++it)
+        result.insert(it.key(), Series());
+
+    if (!from.isValid() || m_employeeUnits.isEmpty())
+        return result;
+
+    // Days are sorted by employee, so every employee is a contiguous range of them
+    auto days = m_tracker.getDayBalances(m_employeeUnits.keys(), from, to, period);
+
+    QHash<int, Work> works;
+    for (int begin = 0; begin < days.size(); )
+    {
+        int employee = days[begin].employee;
+        int end = begin + 1;
+        while (end < days.size() && days[end].employee == employee)
+            ++end;
+
+        int unit = m_employeeUnits.value(employee);
+        auto& work = works[unit];
+        work.unit   = unit;
+        work.period = period;
+        work.days   = &days;
+        work.employees.append(qMakePair(begin, end));
+
+        begin = end;
+    }
+
+    auto partials = QtConcurrent::blockingMapped(works.values(), &RollupEngine::aggregate);
+
+    // Own totals of each unit are added to the unit and all its ancestors
+    for (const auto& partial : partials)
+    {
+        for (int unit = partial.unit; unit >= 0 && m_units.contains(unit); unit = m_units.value(unit).parent)
+        {
+            auto& series = result[unit];
+            for (auto it = partial.series.constBegin(); it != partial.series.constEnd(); ++it)
+                series[it.key()] += it.value();
+        }
+    }
+
+    return result;
+}
+
+RollupEngine::Result RollupEngine::aggregate(const Work &work)
+{
+    Result result;
+    result.unit = work.unit;
+
+    const auto& days = *work.days;
+
+    for (const auto& employee : work.employees)
+    {
+        QDate  period;
+        Totals totals;
+        bool   valid = true;
+
+        auto flush = [&]() {
+            if (period.isValid() && valid)
+                result.series[period] += totals;
+        };
+
+        for (int i = employee.first; i < employee.second; ++i)
+        {
+            auto begin = periodBegin(days[i].date, work.period);
+            if (begin != period) {
+                flush();
+                period = begin;
+                totals = Totals();
+                valid  = true;
+            }
+
+            if (!days[i].valid) {
+                valid = false;
+                continue;
+            }
+
+            totals.debt     += days[i].debt;
+            totals.overtime += days[i].overtime;
+        }
+
+        flush();
+    }
+
+    return result;
+}
+
+TimeSpan RollupEngine::Totals::balance() const
+{
+    return TimeSpan(overtime - debt);
+}
+
+RollupEngine::Totals &RollupEngine::Totals::operator+=(const Totals &totals)
+{
+    debt     += totals.debt;
+    overtime += totals.overtime;
+    return *this;
+}
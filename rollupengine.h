@@ -0,0 +1,75 @@
+#ifndef ROLLUPENGINE_H
+#define ROLLUPENGINE_H
+
+#include <QHash>
+#include <QMap>
+#include "worktimetracker.h"
+
+// Aggregates debt and overtime of employees up an organization hierarchy
+// (teams, departments, company or any other tree of units). COMPANY unit
+// is the root and always exists, other units are added with their parent.
+//
+// rollup() reads day balances of all assigned employees in one scan, sums
+// them by unit and period in parallel and then adds totals of every unit
+// to all its ancestors. Periods are clipped to the requested range.
+// Totals of an employee for a period follow WorktimeTracker::getSummary(): if any
+// day of the period has unknown schedule, the employee adds nothing to that period.
+// Closed months of monthly series add their frozen balance as debt or overtime.
+
+class RollupEngine
+{
+public:
+    struct Totals
+    {
+        qint64   debt     = 0;
+        qint64   overtime = 0;
+        TimeSpan balance() const;
+        Totals&  operator+=(const Totals& totals);
+    };
+
+    // Totals by period begin
+    typedef QMap<QDate, Totals> Series;
+
+    static constexpr int COMPANY = 0;
+
+    explicit RollupEngine(const WorktimeTracker& tracker);
+
+    bool addUnit(int unit, const QString& name, int parent = COMPANY);
+    bool assignEmployee(int employee, int unit);
+
+    QList<int> units() const;
+    QString    unitName(int unit) const;
+    int        parentUnit(int unit) const;
+    int        employeeUnit(int employee) const;
+
+    QHash<int, Series> rollup(const QDate& from, const QDate& to, SummaryPeriod period) const;
+
+private:
+    struct Unit
+    {
+        QString name;
+        int     parent;
+    };
+
+    // Days of one unit's employees are [begin, end) ranges of the scanned days
+    struct Work
+    {
+        int                   unit;
+        SummaryPeriod         period;
+        const QVector<WorktimeTracker::DayBalance>* days;
+        QList<QPair<int,int>> employees;
+    };
+    struct Result
+    {
+        int    unit;
+        Series series;
+    };
+
+    WorktimeTracker  m_tracker;
+    QHash<int, Unit> m_units;
+    QHash<int, int>  m_employeeUnits;
+
+    static Result aggregate(const Work& work);
+};
+
+#endif // ROLLUPENGINE_H
@@ -0,0 +1,116 @@
+#include "summarycache.h"
+#include <limits>
+
+constexpr int SummaryCache::DEFAULT_CAPACITY;
+
+SummaryCache::SummaryCache(int capacity)
+    : m_capacity(qMax(0, capacity))
+{
+
+}
+
+bool SummaryCache::find(int employee, const QDate &from, const QDate &to, TimeSpan *summary)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_index.find({employee, from.toJulianDay(), to.toJulianDay()});
+    if (it == m_index.end())
+        return false;
+
+    // Move to front
+    m_entries.splice(m_entries.begin(), m_entries, it.value());
+    *summary = m_entries.front().summary;
+    return true;
+}
+
+void SummaryCache::insert(int employee, const QDate &from, const QDate &to, const TimeSpan &summary)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_capacity == 0)
+        return;
+
+    Key key = {employee, from.toJulianDay(), to.toJulianDay()};
+
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        it.value()->summary = summary;
+        m_entries.splice(m_entries.begin(), m_entries, it.value());
+        return;
+    }
+
+    Entry entry = {key, summary};
+    m_entries.push_front(entry);
+    m_index.insert(key, m_entries.begin());
+
+    shrink();
+}
+
+void SummaryCache::invalidate(int employee, const QDate &from, const QDate &to)
+{
+    QMutexLocker locker(&m_mutex);
+
+    qint64 _from = to.isValid() ? qMin(from, to).toJulianDay() : from.toJulianDay();
+    qint64 _to   = to.isValid() ? qMax(from, to).toJulianDay() : std::numeric_limits<qint64>::max();
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); )
+    {
+        const auto& key = it->key;
+
+        if (key.employee == employee && key.from <= _to && key.to >= _from) {
+            m_index.remove(key);
+            it = m_entries.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void SummaryCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_entries.clear();
+    m_index.clear();
+}
+
+int SummaryCache::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_index.size();
+}
+
+int SummaryCache::capacity() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_capacity;
+}
+
+void SummaryCache::setCapacity(int capacity)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_capacity = qMax(0, capacity);
+    shrink();
+}
+
+void SummaryCache::shrink()
+{
+    // Least recently used entries are dropped
+    while (m_index.size() > m_capacity)
+    {
+        m_index.remove(m_entries.back().key);
+        m_entries.pop_back();
+    }
+}
+
+bool SummaryCache::Key::operator==(const Key &key) const
+{
+    return employee == key.employee && from == key.from && to == key.to;
+}
+
+uint qHash(const SummaryCache::Key &key, uint seed)
+{
+    return qHash(key.employee, seed) ^ qHash(key.from, seed) ^ (qHash(key.to, seed) << 1);
+}
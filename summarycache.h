@@ -0,0 +1,56 @@
+#ifndef SUMMARYCACHE_H
+#define SUMMARYCACHE_H
+
+#include <QDate>
+#include <QHash>
+#include <QMutex>
+#include <list>
+#include "helper.h"
+
+// LRU cache of summaries keyed by employee and normalized date range.
+// Writes invalidate every cached range intersecting the dates they touched,
+// invalid 'to' of invalidate() means all dates from 'from' on.
+// The cache is thread safe since it's used from const methods of WorktimeTracker
+
+class SummaryCache
+{
+public:
+    explicit SummaryCache(int capacity = DEFAULT_CAPACITY);
+
+    bool find(int employee, const QDate& from, const QDate& to, TimeSpan* summary);
+    void insert(int employee, const QDate& from, const QDate& to, const TimeSpan& summary);
+    void invalidate(int employee, const QDate& from, const QDate& to);
+    void clear();
+
+    int  size() const;
+    int  capacity() const;
+    void setCapacity(int capacity);
+
+    static constexpr int DEFAULT_CAPACITY = 256;
+
+private:
+    struct Key
+    {
+        int    employee;
+        qint64 from, to;    // Julian days
+        bool operator==(const Key& key) const;
+    };
+    struct Entry
+    {
+        Key      key;
+        TimeSpan summary;
+    };
+
+    friend uint qHash(const Key& key, uint seed);
+
+    mutable QMutex m_mutex;
+    int m_capacity;
+
+    // Most recently used entries are in front
+    std::list<Entry> m_entries;
+    QHash<Key, std::list<Entry>::iterator> m_index;
+
+    void shrink();
+};
+
+#endif // SUMMARYCACHE_H
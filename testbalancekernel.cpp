@@ -0,0 +1,78 @@
+#include "testbalancekernel.h"
+#include "worktimesnapshot.h"
+#include <QVector>
+#include <random>
+
+void TestBalanceKernel::sumDebtOvertime()
+{
+    constexpr int h = 3600;
+
+    QVector<qint32> checkIns  = {8 * h, 9 * h,  7 * h,  9 * h,      10 * h};
+    QVector<qint32> checkOuts = {17 * h, 18 * h, 16 * h, 9 * h,     12 * h};
+    QVector<qint32> begins    = {8 * h, 8 * h,  8 * h,  8 * h,      -1};
+    QVector<qint32> ends      = {17 * h, 17 * h, 17 * h, 17 * h,    -1};
+
+    // On time
+    auto sum = ::sumDebtOvertime(checkIns.constData(), checkOuts.constData(), begins.constData(), ends.constData(), 1);
+    QCOMPARE(sum.debt, 0);
+    QCOMPARE(sum.overtime, 0);
+    QCOMPARE(sum.invalid, 0);
+
+    // Late arrival, overtime in the evening, early arrival and early leaving,
+    // check-in equal to check-out (debt ranges touch each other)
+    sum = ::sumDebtOvertime(checkIns.constData(), checkOuts.constData(), begins.constData(), ends.constData(), 4);
+    QCOMPARE(sum.debt, qint64(h + h + 9 * h));
+    QCOMPARE(sum.overtime, qint64(h + h));
+    QCOMPARE(sum.invalid, 0);
+
+    // Unknown schedule
+    sum = ::sumDebtOvertime(checkIns.constData(), checkOuts.constData(), begins.constData(), ends.constData(), 5);
+    QCOMPARE(sum.invalid, 1);
+
+    sum = ::sumDebtOvertime(nullptr, nullptr, nullptr, nullptr, 0);
+    QCOMPARE(sum.debt, 0);
+    QCOMPARE(sum.overtime, 0);
+}
+
+void TestBalanceKernel::sumDebtOvertime_kernels()
+{
+    std::mt19937 random(1996);
+    std::uniform_int_distribution<qint32> time(0, 24 * 3600 - 1);
+
+    // Enough days to flush 32-bit lanes several times
+    constexpr int count = 100000;
+
+    QVector<qint32> checkIns(count), checkOuts(count), begins(count), ends(count);
+    for (int i = 0; i < count; ++i)
+    {
+        auto t1 = time(random), t2 = time(random), t3 = time(random), t4 = time(random);
+        checkIns[i]  = qMin(t1, t2);
+        checkOuts[i] = qMax(t1, t2);
+        begins[i]    = qMin(t3, t4);
+        ends[i]      = qMax(t3, t4) + 1;
+    }
+
+    // Every kernel and every tail size have to give the same result as the per-day code
+    for (int size : {0, 1, 3, 4, 7, 8, 9, 15, 17, 1000, count})
+    {
+        qint64 expected = 0;
+        for (int i = 0; i < size; ++i)
+            expected += WorktimeSnapshot::dayBalance(checkIns[i], checkOuts[i], begins[i], ends[i], nullptr, nullptr, 0);
+
+        for (auto kernel : {BalanceKernel::Auto, BalanceKernel::Scalar, BalanceKernel::Sse41, BalanceKernel::Avx2})
+        {
+            auto sum = ::sumDebtOvertime(checkIns.constData(), checkOuts.constData(),
+                                         begins.constData(), ends.constData(), size, kernel);
+            QCOMPARE(sum.overtime - sum.debt, expected);
+            QCOMPARE(sum.invalid, 0);
+        }
+    }
+
+    // Invalid days are counted by all kernels
+    for (int i = 5; i < count; i += 1000)
+        begins[i] = -1;
+
+    for (auto kernel : {BalanceKernel::Scalar, BalanceKernel::Sse41, BalanceKernel::Avx2})
+        QCOMPARE(::sumDebtOvertime(checkIns.constData(), checkOuts.constData(),
+                                   begins.constData(), ends.constData(), count, kernel).invalid, 100);
+}
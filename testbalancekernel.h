@@ -0,0 +1,17 @@
+#ifndef TESTBALANCEKERNEL_H
+#define TESTBALANCEKERNEL_H
+
+#include <QObject>
+#include <QtTest/QTest>
+#include "balancekernel.h"
+
+class TestBalanceKernel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sumDebtOvertime();
+    void sumDebtOvertime_kernels();
+};
+
+#endif // TESTBALANCEKERNEL_H
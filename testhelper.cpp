@@ -202,3 +202,60 @@ void TestHelper::timeSpan_hoursMinutes()
     QCOMPARE(t2.hours(), -1);
     QCOMPARE(t2.minutes(), -30);
 }
+
+void TestHelper::parseIsoDate()
+{
+    QCOMPARE(::parseIsoDate(QString("1996-11-26")), QDate(1996, 11, 26));
+    QCOMPARE(::parseIsoDate(QString("2024-02-29")), QDate(2024, 2, 29));
+    QCOMPARE(::parseIsoDate("0001-01-01", 10), QDate(1, 1, 1));
+    // Error: Invalid date
+    QVERIFY(!::parseIsoDate(QString("2023-02-29")).isValid());
+    QVERIFY(!::parseIsoDate(QString("1996-13-01")).isValid());
+    QVERIFY(!::parseIsoDate(QString("1996-1a-01")).isValid());
+    QVERIFY(!::parseIsoDate(QString("1996/11/26")).isValid());
+    QVERIFY(!::parseIsoDate(QString()).isValid());
+    QVERIFY(!::parseIsoDate("abc", 3).isValid());
+
+    // Other layouts fall back to Qt and give the same result
+    for (auto str : {"1996-11-26T08:00:00", "96-11-26", "1996-11-2"})
+        QCOMPARE(::parseIsoDate(QString(str)), QDate::fromString(str, Qt::ISODate));
+}
+
+void TestHelper::parseIsoTime()
+{
+    QCOMPARE(::parseIsoTime(QString("08:30:15")), QTime(8, 30, 15));
+    QCOMPARE(::parseIsoTime(QString("00:00:00")), QTime(0, 0));
+    QCOMPARE(::parseIsoTime("23:59:59", 8), QTime(23, 59, 59));
+    // Error: Invalid time
+    QVERIFY(!::parseIsoTime(QString("24:00:01")).isValid());
+    QVERIFY(!::parseIsoTime(QString("12:60:00")).isValid());
+    QVERIFY(!::parseIsoTime(QString("1a:00:00")).isValid());
+    QVERIFY(!::parseIsoTime(QString("12-00-00")).isValid());
+    QVERIFY(!::parseIsoTime(QString()).isValid());
+    QVERIFY(!::parseIsoTime("abc", 3).isValid());
+
+    // Other layouts fall back to Qt and give the same result
+    for (auto str : {"08:30", "08:30:15.250", "8:30:15"})
+        QCOMPARE(::parseIsoTime(QString(str)), QTime::fromString(str, Qt::ISODate));
+}
+
+void TestHelper::periodBegin()
+{
+    auto d = QDate(2022, 03, 16); // Wednesday
+
+    QCOMPARE(::periodBegin(d, SummaryPeriod::Day), d);
+    QCOMPARE(::periodBegin(d, SummaryPeriod::Week), QDate(2022, 03, 14));
+    QCOMPARE(::periodBegin(d, SummaryPeriod::Month), QDate(2022, 03, 01));
+    QCOMPARE(::periodEnd(d, SummaryPeriod::Day), d);
+    QCOMPARE(::periodEnd(d, SummaryPeriod::Week), QDate(2022, 03, 20));
+    QCOMPARE(::periodEnd(d, SummaryPeriod::Month), QDate(2022, 03, 31));
+
+    // Week crosses months and years
+    QCOMPARE(::periodBegin(QDate(2022, 01, 01), SummaryPeriod::Week), QDate(2021, 12, 27));
+    QCOMPARE(::periodEnd(QDate(2021, 12, 27), SummaryPeriod::Week), QDate(2022, 01, 02));
+    QCOMPARE(::periodBegin(QDate(2022, 03, 14), SummaryPeriod::Week), QDate(2022, 03, 14));
+    QCOMPARE(::periodEnd(QDate(2024, 02, 10), SummaryPeriod::Month), QDate(2024, 02, 29));
+
+    QVERIFY(!::periodBegin(QDate(), SummaryPeriod::Week).isValid());
+    QVERIFY(!::periodEnd(QDate(), SummaryPeriod::Month).isValid());
+}
@@ -20,6 +20,9 @@ private slots:
     void timeRange_subtract_list();
     void timeRange_equalOperator();
     void timeSpan_hoursMinutes();
+    void parseIsoDate();
+    void parseIsoTime();
+    void periodBegin();
 };
 
 #endif // TESTHELPER_H
@@ -0,0 +1,121 @@
+#include "testleavepassindex.h"
+
+static WorktimeTracker::LeavePassMap leavePassMap(const QList<WorktimeTracker::LeavePass>& passes)
+{
+    WorktimeTracker::LeavePassMap map;
+
+    for (const auto& lp : passes)
+    {
+        if (map.dates.isEmpty() || map.dates.last() != lp.date) {
+            map.dates.append(lp.date);
+            map.offsets.append(map.passes.size());
+        }
+
+        map.passes.append(lp);
+        map.offsets.last() = map.passes.size();
+    }
+
+    return map;
+}
+
+void TestLeavePassIndex::overlaps()
+{
+    auto d = QDate(2022, 01, 10);
+
+    LeavePassIndex index(leavePassMap({{d, 0, QTime(13, 0), QTime(14, 0), "", false},
+                                       {d, 1, QTime(8, 0), QTime(12, 0), "", false},
+                                       {d, 2, QTime(9, 0), QTime(9, 30), "", false},
+                                       {d.addDays(1), 0, QTime(10, 0), QTime(11, 0), "", false}}));
+    QCOMPARE(index.size(), 4);
+
+    QVERIFY(index.contains(d, QTime(9, 0), QTime(9, 30)));
+    QVERIFY(!index.contains(d, QTime(9, 0), QTime(9, 31)));
+    QVERIFY(!index.contains(d.addDays(2), QTime(10, 0), QTime(11, 0)));
+
+    QVERIFY(index.overlaps(d, QTime(11, 0), QTime(12, 30)));        // Inside the long pass
+    QVERIFY(index.overlaps(d, QTime(13, 30), QTime(15, 0)));
+    QVERIFY(index.overlaps(d, QTime(7, 0), QTime(18, 0)));
+    QVERIFY(!index.overlaps(d, QTime(12, 0), QTime(13, 0)));        // Touching passes don't overlap
+    QVERIFY(!index.overlaps(d, QTime(14, 0), QTime(15, 0)));
+    QVERIFY(!index.overlaps(d.addDays(1), QTime(11, 0), QTime(12, 0)));
+    QVERIFY(!index.overlaps(QDate(), QTime(11, 0), QTime(12, 0)));
+
+    LeavePassIndex empty;
+    QCOMPARE(empty.size(), 0);
+    QVERIFY(!empty.overlaps(d, QTime(0, 0), QTime(23, 0)));
+}
+
+void TestLeavePassIndex::overlapping()
+{
+    auto d = QDate(2022, 01, 10);
+
+    QList<WorktimeTracker::LeavePass> passes;
+    for (int day = 0; day < 30; day += 3)
+        for (int i = 0; i < 8; ++i)
+            passes.append({d.addDays(day), i, QTime(8 + i, 0), QTime(8 + i, 0).addSecs(60 * (15 + day * 4 + i * 7)), "", false});
+
+    LeavePassIndex index(leavePassMap(passes));
+
+    // The same as checking every pass
+    for (auto begin : {QTime(7, 0), QTime(9, 10), QTime(12, 0), QTime(15, 59)})
+    {
+        for (auto end : {QTime(9, 0), QTime(12, 30), QTime(18, 0)})
+        {
+            QList<int> expected, actual;
+            for (int i = 0; i < passes.size(); ++i)
+                if (passes[i].date <= d.addDays(20) && passes[i].from < end && passes[i].to > begin)
+                    expected.append(passes[i].date.day() * 100 + passes[i].id);
+
+            for (const auto& lp : index.overlapping(d.addDays(20), d, begin, end))
+                actual.append(lp.date.day() * 100 + lp.id);
+
+            QCOMPARE(actual, expected);
+        }
+    }
+
+    QVERIFY(index.overlapping(QDate(), d, QTime(7, 0), QTime(18, 0)).isEmpty());
+}
+
+void TestLeavePassIndex::insertRemove()
+{
+    auto d = QDate(2022, 01, 10);
+
+    QList<WorktimeTracker::LeavePass> passes;
+    for (int day = 0; day < 4; ++day)
+        for (int i = 0; i < 5; ++i)
+            passes.append({d.addDays(day), i, QTime(8 + (i * 5) % 7, 0), QTime(9 + (i * 5) % 7, 0).addSecs(60 * day * i), "", false});
+
+    // Passes inserted one by one give the same index as the ones built at once
+    LeavePassIndex index;
+    for (int i = passes.size() - 1; i >= 0; --i)
+        index.insert(passes[i]);
+
+    LeavePassIndex built(leavePassMap(passes));
+    QCOMPARE(index.size(), built.size());
+
+    auto ids = [&d](const LeavePassIndex& index, const QTime& begin, const QTime& end) {
+        QList<int> list;
+        for (const auto& lp : index.overlapping(d, d.addDays(3), begin, end))
+            list.append(lp.date.day() * 100 + lp.id);
+        return list;
+    };
+
+    QCOMPARE(ids(index, QTime(8, 30), QTime(10, 30)), ids(built, QTime(8, 30), QTime(10, 30)));
+    QCOMPARE(ids(index, QTime(0, 0), QTime(23, 0)), ids(built, QTime(0, 0), QTime(23, 0)));
+
+    // The running maximum of the day is recomputed without the removed pass
+    LeavePassIndex day;
+    day.insert({d, 0, QTime(8, 0), QTime(12, 0), "", false});
+    day.insert({d, 1, QTime(9, 0), QTime(9, 30), "", false});
+    QVERIFY(day.overlaps(d, QTime(11, 0), QTime(11, 30)));
+
+    QVERIFY(day.remove(d, 0));
+    QVERIFY(!day.remove(d, 0));                             // Error: Already removed
+    QVERIFY(!day.remove(d.addDays(1), 1));                  // Error: Another day
+    QVERIFY(!day.overlaps(d, QTime(11, 0), QTime(11, 30)));
+    QVERIFY(day.overlaps(d, QTime(9, 15), QTime(11, 30)));
+
+    QVERIFY(day.remove(d, 1));
+    QCOMPARE(day.size(), 0);
+    QVERIFY(!day.overlaps(d, QTime(0, 0), QTime(23, 0)));
+}
@@ -0,0 +1,18 @@
+#ifndef TESTLEAVEPASSINDEX_H
+#define TESTLEAVEPASSINDEX_H
+
+#include <QObject>
+#include <QtTest/QTest>
+#include "leavepassindex.h"
+
+class TestLeavePassIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void overlaps();
+    void overlapping();
+    void insertRemove();
+};
+
+#endif // TESTLEAVEPASSINDEX_H
@@ -0,0 +1,153 @@
+#include "testlivebalance.h"
+
+void TestLiveBalance::balance()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    // Monday, default schedule is 8:00 - 17:00
+    auto d = QDate(2022, 1, 10);
+    wt.insertRecord(d, QTime(9, 0), QTime(18, 0));
+    wt.insertLeavePass(QTime(12, 0), QTime(12, 30), d);
+
+    // Overlapping leave passes are rejected by the tracker, but ones written
+    // before are merged
+    QVERIFY(!wt.insertLeavePass(QTime(12, 15), QTime(13, 0), d));
+    QSqlQuery q(db);
+    QVERIFY(q.exec("INSERT INTO leavepass (Date, Id, Begin, End, Comment, Employee, Generated) "
+                   "VALUES ('2022-01-10', 1, '12:15:00', '13:00:00', '', 0, 0)"));
+
+    LiveBalance live(wt);
+    bool valid = false;
+
+    QCOMPARE(live.balance(QDateTime(d, QTime(7, 0)), &valid).seconds, qint64(0));
+    QVERIFY(valid);
+    QCOMPARE(live.balance(QDateTime(d, QTime(8, 30))).seconds, qint64(-30 * 60));
+    QCOMPARE(live.balance(QDateTime(d, QTime(10, 0))).seconds, qint64(-60 * 60));
+    QCOMPARE(live.balance(QDateTime(d, QTime(12, 20))).seconds, qint64(-80 * 60));
+    QCOMPARE(live.balance(QDateTime(d, QTime(15, 0))).seconds, qint64(-120 * 60));
+    QCOMPARE(live.balance(QDateTime(d, QTime(17, 30))).seconds, qint64(-90 * 60));
+    QCOMPARE(live.balance(QDateTime(d, QTime(23, 59, 59))).seconds, wt.getSummary(d).seconds);
+    QCOMPARE(live.loads(), 1);
+
+    // Day without record
+    QCOMPARE(live.balance(QDateTime(d.addDays(1), QTime(12, 0)), &valid).seconds, qint64(0));
+    QVERIFY(valid);
+    QCOMPARE(live.loads(), 2);
+
+    clear(&db);
+}
+
+void TestLiveBalance::changes()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    auto d = QDate(2022, 1, 10);
+    wt.insertRecord(d, QTime(8, 0), QTime(17, 0));
+
+    LiveBalance live(wt);
+    auto evening = QDateTime(d, QTime(20, 0));
+
+    QCOMPARE(live.balance(evening).seconds, qint64(0));
+    QCOMPARE(live.loads(), 1);
+
+    // Writes of other days and employees are ignored
+    wt.insertRecord(d.addDays(1), QTime(8, 0), QTime(17, 0));
+    WorktimeTracker other = wt;
+    other.setEmployee(1);
+    other.insertRecord(d, QTime(10, 0), QTime(17, 0));
+    live.balance(evening);
+    QCOMPARE(live.loads(), 1);
+
+    // Writes of the day reload it, also ones made by a copy of the tracker
+    wt.setCheckOut(QTime(18, 0), d);
+    QCOMPARE(live.balance(evening).seconds, qint64(60 * 60));
+    QCOMPARE(live.loads(), 2);
+
+    other.setEmployee(0);
+    other.insertLeavePass(QTime(9, 0), QTime(11, 0), d);
+    QCOMPARE(live.balance(evening).seconds, qint64(-60 * 60));
+    QCOMPARE(live.loads(), 3);
+    QCOMPARE(live.balance(evening).seconds, wt.getSummary(d).seconds);
+    QCOMPARE(live.loads(), 3);
+
+    // Employee of the tracker is changed
+    wt.setEmployee(1);
+    QCOMPARE(live.balance(evening).seconds, qint64(-2 * 60 * 60));
+    QCOMPARE(live.loads(), 4);
+
+    // External modification
+    wt.clearSummaryCache();
+    live.balance(evening);
+    QCOMPARE(live.loads(), 5);
+
+    // Listener writing through the tracker and removing itself
+    wt.setEmployee(0);
+    int listener = -1;
+    listener = wt.addChangeListener([&](int employee, const QDate& from, const QDate&) {
+        if (employee == 0 && from == d) {
+            wt.removeChangeListener(listener);
+            QVERIFY(wt.insertLeavePass(QTime(15, 0), QTime(16, 0), d));
+        }
+    });
+    QVERIFY(wt.setCheckOut(QTime(17, 0), d));
+    QCOMPARE(wt.getLeavePassList(d).size(), 2);
+    QCOMPARE(live.balance(evening).seconds, qint64(-3 * 60 * 60));
+
+    clear(&db);
+}
+
+void TestLiveBalance::workingCalendar()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    auto d = QDate(2022, 1, 10);
+    wt.insertRecord(d, QTime(8, 0), QTime(17, 0));
+
+    LiveBalance live(wt);
+    auto tuesday = d.addDays(1);
+
+    QCOMPARE(live.balance(QDateTime(tuesday, QTime(12, 0))).seconds, qint64(0));
+
+    // Missing working day is a debt of the whole schedule
+    wt.setWorkingCalendar(WorkingCalendar());
+    QCOMPARE(live.balance(QDateTime(tuesday, QTime(7, 0))).seconds, qint64(0));
+    QCOMPARE(live.balance(QDateTime(tuesday, QTime(12, 0))).seconds, qint64(-4 * 60 * 60));
+    QCOMPARE(live.balance(QDateTime(tuesday, QTime(20, 0))).seconds, wt.getSummary(tuesday).seconds);
+    QCOMPARE(live.loads(), 2);
+
+    // Weekend
+    QCOMPARE(live.balance(QDateTime(d.addDays(5), QTime(12, 0))).seconds, qint64(0));
+
+    // Missing day takes the assigned schedule, not the one of the previous record
+    wt.insertSchedule("custom", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0));
+    wt.insertRecord(d.addDays(3), QTime(10, 0), QTime(12, 0), "custom");
+    QVERIFY(wt.setSchedule("custom", d.addDays(2), d.addDays(3)));
+    QCOMPARE(live.balance(QDateTime(d.addDays(2), QTime(11, 0))).seconds, qint64(-60 * 60));
+    QCOMPARE(live.balance(QDateTime(d.addDays(2), QTime(20, 0))).seconds, wt.getSummary(d.addDays(2)).seconds);
+
+    // Missing day after the last record is planned with its schedule, so a write
+    // of an earlier day reloads it
+    auto friday = d.addDays(4);
+    QCOMPARE(live.balance(QDateTime(friday, QTime(20, 0))).seconds, qint64(-2 * 60 * 60));
+    QVERIFY(wt.setSchedule("default", d.addDays(3), d.addDays(3)));
+    QCOMPARE(live.balance(QDateTime(friday, QTime(20, 0))).seconds, qint64(-9 * 60 * 60));
+    QCOMPARE(live.balance(QDateTime(friday, QTime(20, 0))).seconds, wt.getSummary(friday).seconds);
+
+    clear(&db);
+}
+
+QSqlDatabase TestLiveBalance::createDb() const
+{
+    auto db = QSqlDatabase::addDatabase("QSQLITE", ":memory:");
+    db.open();
+    return db;
+}
+
+void TestLiveBalance::clear(QSqlDatabase *db)
+{
+    db->close();
+    QSqlDatabase::removeDatabase(":memory:");
+}
@@ -0,0 +1,24 @@
+#ifndef TESTLIVEBALANCE_H
+#define TESTLIVEBALANCE_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QtTest/QTest>
+#include "livebalance.h"
+
+class TestLiveBalance : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void balance();
+    void changes();
+    void workingCalendar();
+
+private:
+    QSqlDatabase createDb() const;
+    void clear(QSqlDatabase* db);
+};
+
+#endif // TESTLIVEBALANCE_H
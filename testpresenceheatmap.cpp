@@ -0,0 +1,102 @@
+#include "testpresenceheatmap.h"
+
+void TestPresenceHeatmap::addDay()
+{
+    PresenceHeatmap heatmap;
+
+    constexpr int h = 60 * 60;
+
+    // 8:00 - 17:00 without 12:00 - 13:30 (overlapping passes) and 16:00 - 17:00 (clipped)
+    qint32 begins[] = {12 * h, 12 * h + 1800, 16 * h, 6 * h};
+    qint32 ends[]   = {13 * h, 13 * h + 1800, 18 * h, 7 * h};
+    heatmap.addDay(8 * h, 17 * h, begins, ends, 4);
+
+    // 10:00:59 - 12:30:30
+    heatmap.addDay(10 * h + 59, 12 * h + 1830, nullptr, nullptr, 0);
+
+    // Inverted day is ignored
+    heatmap.addDay(12 * h, 11 * h, nullptr, nullptr, 0);
+
+    QCOMPARE(heatmap.days(), 2);
+
+    auto minutes = heatmap.minutes();
+    QCOMPARE(minutes.size(), int(PresenceHeatmap::SLOTS));
+    QCOMPARE(minutes[8 * 60 - 1], 0);
+    QCOMPARE(minutes[8 * 60], 1);
+    QCOMPARE(minutes[10 * 60], 2);
+    QCOMPARE(minutes[12 * 60], 1);
+    QCOMPARE(minutes[12 * 60 + 29], 1);
+    QCOMPARE(minutes[12 * 60 + 30], 0);
+    QCOMPARE(minutes[13 * 60 + 29], 0);
+    QCOMPARE(minutes[13 * 60 + 30], 1);
+    QCOMPARE(minutes[16 * 60 - 1], 1);
+    QCOMPARE(minutes[16 * 60], 0);
+
+    heatmap.clear();
+    QCOMPARE(heatmap.days(), 0);
+    QCOMPARE(heatmap.minutes()[10 * 60], 0);
+}
+
+void TestPresenceHeatmap::addRecords()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    auto d = QDate(2022, 01, 10);
+    for (int i = 0; i < 40; ++i)
+    {
+        wt.insertRecord(d.addDays(i), QTime(7, 0).addSecs(i * 300), QTime(16, 0).addSecs(i * 170));
+        if (i % 3 == 0)
+            wt.insertLeavePass(QTime(9, 0).addSecs(i * 200), QTime(10, 0).addSecs(i * 100), d.addDays(i));
+        if (i % 6 == 0)
+            wt.insertLeavePass(QTime(9, 30), QTime(11, 0), d.addDays(i));
+    }
+
+    PresenceHeatmap heatmap;
+    QVERIFY(heatmap.addRecords(wt, d, d.addDays(29)));
+    QCOMPARE(heatmap.days(), 30);
+
+    // The same as checking every minute of every day
+    QVector<int> expected(PresenceHeatmap::SLOTS, 0);
+    for (int i = 0; i < 30; ++i)
+    {
+        auto r  = wt.getRecord(d.addDays(i));
+        auto lp = wt.getLeavePassList(d.addDays(i));
+
+        for (int m = 0; m < PresenceHeatmap::SLOTS; ++m)
+        {
+            auto t = QTime(0, 0).addSecs(m * 60);
+            bool present = t >= QTime(r.checkIn.hour(), r.checkIn.minute()) && t < QTime(r.checkOut.hour(), r.checkOut.minute());
+            for (const auto& pass : lp)
+                present = present && !(t >= QTime(pass.from.hour(), pass.from.minute()) && t < QTime(pass.to.hour(), pass.to.minute()));
+            expected[m] += present;
+        }
+    }
+
+    QCOMPARE(heatmap.minutes(), expected);
+
+    // Several employees are accumulated
+    wt.setEmployee(1);
+    wt.insertRecord(d, QTime(0, 0), QTime(23, 59));
+    QVERIFY(heatmap.addRecords(wt, d, d.addDays(29)));
+    QCOMPARE(heatmap.days(), 31);
+    QCOMPARE(heatmap.minutes()[0], 1);
+    QCOMPARE(heatmap.minutes()[12 * 60], expected[12 * 60] + 1);
+
+    QVERIFY(!heatmap.addRecords(wt, QDate(), d));
+
+    clear(&db);
+}
+
+QSqlDatabase TestPresenceHeatmap::createDb() const
+{
+    auto db = QSqlDatabase::addDatabase("QSQLITE", ":memory:");
+    db.open();
+    return db;
+}
+
+void TestPresenceHeatmap::clear(QSqlDatabase *db)
+{
+    db->close();
+    QSqlDatabase::removeDatabase(":memory:");
+}
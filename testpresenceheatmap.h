@@ -0,0 +1,22 @@
+#ifndef TESTPRESENCEHEATMAP_H
+#define TESTPRESENCEHEATMAP_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QtTest/QTest>
+#include "presenceheatmap.h"
+
+class TestPresenceHeatmap : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void addDay();
+    void addRecords();
+
+private:
+    QSqlDatabase createDb() const;
+    void clear(QSqlDatabase* db);
+};
+
+#endif // TESTPRESENCEHEATMAP_H
@@ -0,0 +1,80 @@
+#include "testpunchaggregator.h"
+#include <QThread>
+
+void TestPunchAggregator::flush()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QSqlDatabase db = createDb(dir);
+    WorktimeTracker wt(db);
+
+    auto d = QDate(2022, 1, 10);
+    wt.insertRecord(d, QTime(8, 0), QTime(17, 0));
+    QCOMPARE(wt.getSummary(d).seconds, qint64(0));
+
+    QList<QDate> changed;
+    wt.addChangeListener([&changed](int, const QDate& from, const QDate&) {
+        changed.append(from);
+    });
+
+    {
+        // Long interval, so only flush() aggregates
+        PunchAggregator aggregator(wt, 60 * 60 * 1000);
+
+        QVERIFY(wt.addPunch(QDateTime(d, QTime(9, 0)), WorktimeTracker::PunchKind::In));
+        QVERIFY(wt.addPunch(QDateTime(d, QTime(17, 0)), WorktimeTracker::PunchKind::Out));
+        QVERIFY(aggregator.flush());
+        QCOMPARE(aggregator.aggregatedCount(), 2);
+
+        QCOMPARE(wt.getRecord(d).checkIn, QTime(9, 0));
+        QVERIFY(changed.contains(d));
+
+        // Cached summary is invalidated
+        QCOMPARE(wt.getSummary(d).seconds, qint64(-60 * 60));
+
+        QVERIFY(aggregator.flush());
+        QCOMPARE(aggregator.aggregatedCount(), 2);
+    }
+
+    QCOMPARE(wt.punchHighWaterMark(), qint64(2));
+
+    clear(&db);
+}
+
+void TestPunchAggregator::interval()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QSqlDatabase db = createDb(dir);
+    WorktimeTracker wt(db);
+
+    auto d = QDate(2022, 1, 10);
+    PunchAggregator aggregator(wt, 10);
+
+    QVERIFY(wt.addPunch(QDateTime(d, QTime(8, 30)), WorktimeTracker::PunchKind::In));
+
+    for (int i = 0; i < 500 && aggregator.aggregatedCount() == 0; ++i)
+        QThread::msleep(10);
+
+    QCOMPARE(aggregator.aggregatedCount(), 1);
+    QCOMPARE(wt.getRecord(d).checkIn, QTime(8, 30));
+
+    clear(&db);
+}
+
+QSqlDatabase TestPunchAggregator::createDb(const QTemporaryDir &dir) const
+{
+    // Aggregator needs a database shared by connections
+    auto db = QSqlDatabase::addDatabase("QSQLITE", "aggregator");
+    db.setDatabaseName(dir.filePath("worktime.db"));
+    db.open();
+    return db;
+}
+
+void TestPunchAggregator::clear(QSqlDatabase *db)
+{
+    db->close();
+    QSqlDatabase::removeDatabase("aggregator");
+}
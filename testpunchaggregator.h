@@ -0,0 +1,23 @@
+#ifndef TESTPUNCHAGGREGATOR_H
+#define TESTPUNCHAGGREGATOR_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QTemporaryDir>
+#include <QtTest/QTest>
+#include "punchaggregator.h"
+
+class TestPunchAggregator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void flush();
+    void interval();
+
+private:
+    QSqlDatabase createDb(const QTemporaryDir& dir) const;
+    void clear(QSqlDatabase* db);
+};
+
+#endif // TESTPUNCHAGGREGATOR_H
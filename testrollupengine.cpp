@@ -0,0 +1,233 @@
+#include "testrollupengine.h"
+
+void TestRollupEngine::addUnit()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+    RollupEngine engine(wt);
+
+    QVERIFY(engine.addUnit(1, "department"));
+    QVERIFY(engine.addUnit(2, "team", 1));
+    QVERIFY(!engine.addUnit(2, "team2", 1));                // Error: Already exists
+    QVERIFY(!engine.addUnit(3, "team3", 10));               // Error: Unknown parent
+    QVERIFY(!engine.addUnit(RollupEngine::COMPANY, "c"));   // Error: Company always exists
+
+    QCOMPARE(engine.units(), QList<int>({0, 1, 2}));
+    QCOMPARE(engine.unitName(2), QString("team"));
+    QCOMPARE(engine.parentUnit(2), 1);
+    QCOMPARE(engine.parentUnit(1), int(RollupEngine::COMPANY));
+    QCOMPARE(engine.parentUnit(RollupEngine::COMPANY), -1);
+
+    QVERIFY(engine.assignEmployee(5, 2));
+    QVERIFY(engine.assignEmployee(6, RollupEngine::COMPANY));
+    QVERIFY(!engine.assignEmployee(7, 3));                  // Error: Unknown unit
+    QCOMPARE(engine.employeeUnit(5), 2);
+    QCOMPARE(engine.employeeUnit(7), -1);
+
+    clear(&db);
+}
+
+void TestRollupEngine::rollup()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    // company
+    //   1 department: 11 team (employees 1, 2), 12 team (employee 3)
+    //   2 department: employee 4 directly, 21 team (employee 5)
+    RollupEngine engine(wt);
+    engine.addUnit(1, "department1");
+    engine.addUnit(2, "department2");
+    engine.addUnit(11, "team11", 1);
+    engine.addUnit(12, "team12", 1);
+    engine.addUnit(21, "team21", 2);
+
+    QHash<int, int> units = {{1, 11}, {2, 11}, {3, 12}, {4, 2}, {5, 21}};
+    for (auto it = units.constBegin(); it != units.constEnd(); ++it)
+        engine.assignEmployee(it.key(), it.value());
+
+    wt.insertSchedule("custom", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0));
+
+    auto d = QDate(2022, 01, 25);
+    for (int employee = 1; employee <= 6; ++employee)
+    {
+        wt.setEmployee(employee);
+        for (int i = 0; i < 45; ++i)
+            wt.insertRecord(d.addDays(i), QTime(8, 0).addSecs(60 * employee * (i % 3)), QTime(17, 0).addSecs(-60 * i));
+
+        wt.setSchedule("custom", d.addDays(employee * 3), d.addDays(employee * 3 + 1));
+        wt.insertLeavePass(QTime(13, 0), QTime(14, 0), d.addDays(employee));
+    }
+
+    auto from = QDate(2022, 01, 28);
+    auto to   = QDate(2022, 03, 05);
+
+    for (auto period : {SummaryPeriod::Day, SummaryPeriod::Week, SummaryPeriod::Month})
+    {
+        auto result = engine.rollup(from, to, period);
+        QCOMPARE(result.size(), 6);
+
+        // Every unit has to reconcile with getSummary() of its employees
+        QHash<int, QMap<QDate, qint64>> expected;
+        for (auto it = units.constBegin(); it != units.constEnd(); ++it)
+        {
+            wt.setEmployee(it.key());
+
+            for (auto p = periodBegin(from, period); p <= to; p = periodEnd(p, period).addDays(1))
+            {
+                auto summary = wt.getSummary(qMax(p, from), qMin(periodEnd(p, period), to));
+                for (int unit = it.value(); unit >= 0; unit = engine.parentUnit(unit))
+                    expected[unit][p] += summary.seconds;
+            }
+        }
+
+        for (int unit : engine.units())
+        {
+            auto series = result.value(unit);
+            QCOMPARE(series.keys(), expected.value(unit).keys());
+
+            for (auto it = series.constBegin(); it != series.constEnd(); ++it)
+            {
+                QCOMPARE(it.value().balance().seconds, expected[unit][it.key()]);
+                QVERIFY(it.value().debt >= 0 && it.value().overtime >= 0);
+            }
+        }
+    }
+
+    // Employee 6 isn't assigned to any unit
+    auto result = engine.rollup(from, to, SummaryPeriod::Month);
+    qint64 company = 0;
+    for (const auto& totals : result.value(RollupEngine::COMPANY))
+        company += totals.balance().seconds;
+
+    qint64 expected = 0;
+    for (auto summary : wt.getSummaries({1, 2, 3, 4, 5}, from, to))
+        expected += summary.seconds;
+
+    QCOMPARE(company, expected);
+
+    QVERIFY(engine.rollup(QDate(), to, SummaryPeriod::Day).value(1).isEmpty());
+
+    clear(&db);
+}
+
+void TestRollupEngine::rollup_invalidSchedule()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    RollupEngine engine(wt);
+    engine.addUnit(1, "team");
+    engine.assignEmployee(1, 1);
+    engine.assignEmployee(2, 1);
+
+    auto d = QDate(2022, 02, 07); // Monday
+    for (int employee = 1; employee <= 2; ++employee)
+    {
+        wt.setEmployee(employee);
+        for (int i = 0; i < 14; ++i)
+            wt.insertRecord(d.addDays(i), QTime(9, 0), QTime(17, 0));
+    }
+
+    // Unknown schedule in the first week of employee 2
+    QSqlQuery query(db);
+    query.exec("UPDATE worktime SET Schedule = 99 WHERE Employee = 2 AND Date = '2022-02-09'");
+
+    auto series = engine.rollup(d, d.addDays(13), SummaryPeriod::Week).value(1);
+    QCOMPARE(series.size(), 2);
+    QCOMPARE(series[d].debt, qint64(7 * 60 * 60));
+    QCOMPARE(series[d.addDays(7)].debt, qint64(2 * 7 * 60 * 60));
+
+    clear(&db);
+}
+
+void TestRollupEngine::rollup_calendar()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    RollupEngine engine(wt);
+    engine.addUnit(1, "team");
+    engine.assignEmployee(1, 1);
+    engine.assignEmployee(2, 1);
+
+    auto d = QDate(2022, 02, 07); // Monday
+    wt.setEmployee(1);
+    wt.insertRecord(d, QTime(9, 0), QTime(17, 0));
+    wt.insertRecord(d.addDays(3), QTime(8, 0), QTime(18, 0));
+
+    // Calendar set after the engine is created applies to it too
+    QVERIFY(wt.setWorkingCalendar(WorkingCalendar()));
+
+    // Employee 1 misses 3 working days, employee 2 misses all 5 of them
+    auto series = engine.rollup(d, d.addDays(6), SummaryPeriod::Week).value(1);
+    QCOMPARE(series.size(), 1);
+    QCOMPARE(series[d].debt, qint64((1 + 8 * 9) * 60 * 60));
+    QCOMPARE(series[d].overtime, qint64(60 * 60));
+
+    qint64 expected = 0;
+    for (auto summary : wt.getSummaries({1, 2}, d, d.addDays(6)))
+        expected += summary.seconds;
+    QCOMPARE(series[d].balance().seconds, expected);
+
+    clear(&db);
+}
+
+void TestRollupEngine::rollup_closedMonth()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    RollupEngine engine(wt);
+    engine.addUnit(1, "team");
+    engine.assignEmployee(1, 1);
+    engine.assignEmployee(2, 1);
+
+    auto d = QDate(2022, 02, 07); // Monday
+    for (int employee = 1; employee <= 2; ++employee)
+    {
+        wt.setEmployee(employee);
+        wt.insertRecord(d, QTime(9, 0), QTime(17, 0));
+        wt.insertRecord(d.addDays(3), QTime(8, 0), QTime(18, 0));
+        wt.insertRecord(QDate(2022, 03, 01), QTime(8, 0), QTime(19, 0));
+    }
+
+    wt.setEmployee(1);
+    QVERIFY(wt.closeMonth(2, 2022));
+    auto february = wt.getSummary(2, 2022).seconds;
+
+    // Missing days of the calendar don't change the frozen balance of employee 1
+    QVERIFY(wt.setWorkingCalendar(WorkingCalendar()));
+    QCOMPARE(wt.getSummary(2, 2022).seconds, february);
+
+    wt.setEmployee(2);
+    auto expected = february + wt.getSummary(2, 2022).seconds;
+
+    auto from = QDate(2022, 02, 01);
+    auto to   = QDate(2022, 03, 31);
+
+    auto series = engine.rollup(from, to, SummaryPeriod::Month).value(1);
+    QCOMPARE(series.size(), 2);
+    QCOMPARE(series[from].balance().seconds, expected);
+
+    // The same as the batched summaries
+    qint64 total = 0;
+    for (auto summary : wt.getSummaries({1, 2}, from, to))
+        total += summary.seconds;
+    QCOMPARE(series[from].balance().seconds + series[QDate(2022, 03, 01)].balance().seconds, total);
+
+    clear(&db);
+}
+
+QSqlDatabase TestRollupEngine::createDb() const
+{
+    auto db = QSqlDatabase::addDatabase("QSQLITE", ":memory:");
+    db.open();
+    return db;
+}
+
+void TestRollupEngine::clear(QSqlDatabase *db)
+{
+    db->close();
+    QSqlDatabase::removeDatabase(":memory:");
+}
@@ -0,0 +1,25 @@
+#ifndef TESTROLLUPENGINE_H
+#define TESTROLLUPENGINE_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QtTest/QTest>
+#include "rollupengine.h"
+
+class TestRollupEngine : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void addUnit();
+    void rollup();
+    void rollup_invalidSchedule();
+    void rollup_calendar();
+    void rollup_closedMonth();
+
+private:
+    QSqlDatabase createDb() const;
+    void clear(QSqlDatabase* db);
+};
+
+#endif // TESTROLLUPENGINE_H
@@ -0,0 +1,83 @@
+#include "testsummarycache.h"
+
+void TestSummaryCache::find()
+{
+    SummaryCache cache;
+    TimeSpan ts;
+
+    auto d = QDate(2022, 01, 25);
+    QVERIFY(!cache.find(0, d, d.addDays(5), &ts));
+
+    cache.insert(0, d, d.addDays(5), TimeSpan(100));
+    cache.insert(1, d, d.addDays(5), TimeSpan(200));
+    QCOMPARE(cache.size(), 2);
+
+    QVERIFY(cache.find(0, d, d.addDays(5), &ts));
+    QCOMPARE(ts.seconds, qint64(100));
+    QVERIFY(cache.find(1, d, d.addDays(5), &ts));
+    QCOMPARE(ts.seconds, qint64(200));
+    QVERIFY(!cache.find(0, d, d.addDays(4), &ts));
+
+    // Insert of existing key replaces the value
+    cache.insert(0, d, d.addDays(5), TimeSpan(-50));
+    QVERIFY(cache.find(0, d, d.addDays(5), &ts));
+    QCOMPARE(ts.seconds, qint64(-50));
+    QCOMPARE(cache.size(), 2);
+
+    cache.clear();
+    QCOMPARE(cache.size(), 0);
+    QVERIFY(!cache.find(0, d, d.addDays(5), &ts));
+}
+
+void TestSummaryCache::capacity()
+{
+    SummaryCache cache(3);
+    TimeSpan ts;
+
+    auto d = QDate(2022, 01, 25);
+    for (int i = 0; i < 3; ++i)
+        cache.insert(0, d, d.addDays(i), TimeSpan(i));
+
+    // Use the oldest entry, so the second one becomes least recently used
+    QVERIFY(cache.find(0, d, d, &ts));
+
+    cache.insert(0, d, d.addDays(3), TimeSpan(3));
+    QCOMPARE(cache.size(), 3);
+    QVERIFY(cache.find(0, d, d, &ts));
+    QVERIFY(!cache.find(0, d, d.addDays(1), &ts));
+    QVERIFY(cache.find(0, d, d.addDays(2), &ts));
+    QVERIFY(cache.find(0, d, d.addDays(3), &ts));
+
+    cache.setCapacity(1);
+    QCOMPARE(cache.size(), 1);
+    QVERIFY(cache.find(0, d, d.addDays(3), &ts));
+
+    // Disabled cache doesn't keep anything
+    cache.setCapacity(0);
+    QCOMPARE(cache.capacity(), 0);
+    cache.insert(0, d, d, TimeSpan(1));
+    QCOMPARE(cache.size(), 0);
+}
+
+void TestSummaryCache::invalidate()
+{
+    SummaryCache cache;
+    TimeSpan ts;
+
+    auto d = QDate(2022, 01, 25);
+    cache.insert(0, d, d.addDays(9), TimeSpan(1));
+    cache.insert(0, d.addDays(10), d.addDays(19), TimeSpan(2));
+    cache.insert(0, d.addDays(20), d.addDays(29), TimeSpan(3));
+    cache.insert(1, d, d.addDays(29), TimeSpan(4));
+
+    // Only ranges of the employee intersecting [9, 10] are removed
+    cache.invalidate(0, d.addDays(10), d.addDays(9));
+    QVERIFY(!cache.find(0, d, d.addDays(9), &ts));
+    QVERIFY(!cache.find(0, d.addDays(10), d.addDays(19), &ts));
+    QVERIFY(cache.find(0, d.addDays(20), d.addDays(29), &ts));
+    QVERIFY(cache.find(1, d, d.addDays(29), &ts));
+
+    cache.invalidate(1, d.addDays(29), d.addDays(29));
+    QVERIFY(!cache.find(1, d, d.addDays(29), &ts));
+    QCOMPARE(cache.size(), 1);
+}
@@ -0,0 +1,18 @@
+#ifndef TESTSUMMARYCACHE_H
+#define TESTSUMMARYCACHE_H
+
+#include <QObject>
+#include <QtTest/QTest>
+#include "summarycache.h"
+
+class TestSummaryCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void find();
+    void capacity();
+    void invalidate();
+};
+
+#endif // TESTSUMMARYCACHE_H
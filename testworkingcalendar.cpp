@@ -0,0 +1,90 @@
+#include "testworkingcalendar.h"
+
+void TestWorkingCalendar::isWorkingDay()
+{
+    WorkingCalendar calendar;
+
+    auto monday = QDate(2022, 01, 10);
+    for (int i = 0; i < 7; ++i)
+        QCOMPARE(calendar.isWorkingDay(monday.addDays(i)), i < 5);
+
+    calendar.setHoliday(monday);
+    calendar.setWorkingDay(monday.addDays(5));
+    QVERIFY(!calendar.isWorkingDay(monday));
+    QVERIFY(calendar.isWorkingDay(monday.addDays(5)));
+
+    // Other days of the year aren't changed
+    QVERIFY(calendar.isWorkingDay(monday.addDays(7)));
+    QVERIFY(!calendar.isWorkingDay(monday.addDays(12)));
+    QVERIFY(calendar.isWorkingDay(QDate(2022, 12, 30)));
+    QVERIFY(!calendar.isWorkingDay(QDate(2022, 12, 31)));
+    QVERIFY(!calendar.isWorkingDay(QDate()));
+
+    WorkingCalendar everyDay(WorkingCalendar::ALL_DAYS);
+    QVERIFY(everyDay.isWorkingDay(monday.addDays(6)));
+    everyDay.setHoliday(QDate(2020, 12, 31));               // Day 366
+    QVERIFY(!everyDay.isWorkingDay(QDate(2020, 12, 31)));
+    QVERIFY(everyDay.isWorkingDay(QDate(2020, 12, 30)));
+}
+
+void TestWorkingCalendar::workingDays()
+{
+    WorkingCalendar calendar;
+
+    auto monday = QDate(2022, 01, 10);
+    QCOMPARE(calendar.workingDays(monday, monday.addDays(6)), 5);
+    QCOMPARE(calendar.workingDays(monday.addDays(6), monday), 5);
+    QCOMPARE(calendar.workingDays(monday.addDays(5), monday.addDays(6)), 0);
+    QCOMPARE(calendar.workingDays(monday, QDate()), 0);
+
+    // The same as checking every day
+    auto check = [&calendar](const QDate& from, const QDate& to) {
+        int count = 0;
+        for (auto d = from; d <= to; d = d.addDays(1))
+            count += calendar.isWorkingDay(d);
+        return count;
+    };
+
+    calendar.setHoliday(QDate(2022, 01, 03));
+    calendar.setHoliday(QDate(2022, 03, 8));
+    calendar.setWorkingDay(QDate(2023, 03, 04));
+    calendar.setHoliday(QDate(2024, 12, 31));
+
+    for (auto range : {qMakePair(QDate(2022, 01, 01), QDate(2022, 12, 31)),
+                       qMakePair(QDate(2021, 12, 15), QDate(2025, 02, 10)),
+                       qMakePair(QDate(2022, 03, 05), QDate(2022, 03, 8)),
+                       qMakePair(QDate(2022, 03, 05), QDate(2022, 03, 05)),
+                       qMakePair(QDate(2024, 03, 01), QDate(2024, 12, 31))})
+        QCOMPARE(calendar.workingDays(range.first, range.second), check(range.first, range.second));
+
+    QCOMPARE(calendar.workingDays(QDate(2022, 01, 01), QDate(2022, 12, 31)), 258);
+}
+
+void TestWorkingCalendar::toString()
+{
+    WorkingCalendar calendar(WorkingCalendar::WEEKDAYS | 0x20);
+    QCOMPARE(calendar.toString(), QString("63"));
+
+    calendar.setHoliday(QDate(2022, 01, 03));
+    calendar.setWorkingDay(QDate(2020, 12, 31));
+
+    bool ok;
+    auto copy = WorkingCalendar::fromString(calendar.toString(), &ok);
+    QVERIFY(ok);
+    QCOMPARE(copy.toString(), calendar.toString());
+    QCOMPARE(copy.workingWeekDays(), calendar.workingWeekDays());
+    QVERIFY(!copy.isWorkingDay(QDate(2022, 01, 03)));
+    QVERIFY(copy.isWorkingDay(QDate(2022, 01, 04)));
+    QVERIFY(copy.isWorkingDay(QDate(2022, 01, 8)));
+    QVERIFY(!copy.isWorkingDay(QDate(2022, 01, 9)));
+    QCOMPARE(copy.workingDays(QDate(2020, 01, 01), QDate(2023, 12, 31)),
+             calendar.workingDays(QDate(2020, 01, 01), QDate(2023, 12, 31)));
+
+    // Errors
+    WorkingCalendar::fromString("abc", &ok);
+    QVERIFY(!ok);
+    WorkingCalendar::fromString("31;2022:0101", &ok);
+    QVERIFY(!ok);
+    WorkingCalendar::fromString("128", &ok);
+    QVERIFY(!ok);
+}
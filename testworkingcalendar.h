@@ -0,0 +1,18 @@
+#ifndef TESTWORKINGCALENDAR_H
+#define TESTWORKINGCALENDAR_H
+
+#include <QObject>
+#include <QtTest/QTest>
+#include "workingcalendar.h"
+
+class TestWorkingCalendar : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void isWorkingDay();
+    void workingDays();
+    void toString();
+};
+
+#endif // TESTWORKINGCALENDAR_H
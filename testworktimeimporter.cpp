@@ -0,0 +1,152 @@
+#include "testworktimeimporter.h"
+#include <QTemporaryDir>
+#include <QFile>
+
+void TestWorktimeImporter::importData()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+    WorktimeImporter importer(&wt);
+
+    wt.insertSchedule("test", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0));
+
+    QByteArray data = "Date,CheckIn,CheckOut,Schedule\n"
+                      "1996-11-26,08:55:00,17:10:00\n"
+                      "1996-11-27,09:00:00,17:00:00,default\r\n"
+                      "\n"
+                      "1996-11-28, 10:05:00,\t12:00:00 ,\ttest\t";
+
+    QVERIFY(importer.importData(data));
+    QCOMPARE(importer.importedCount(), 3);
+    QVERIFY(importer.errors().isEmpty());
+
+    auto r1 = wt.getRecord(QDate(1996, 11, 26));
+    QVERIFY(r1.isValid());
+    QCOMPARE(r1.schedule->name, wt.defaultSchedule().name);
+    QCOMPARE(r1.checkIn, QTime(8, 55));
+    QCOMPARE(r1.checkOut, QTime(17, 10));
+
+    auto r2 = wt.getRecord(QDate(1996, 11, 27));
+    QVERIFY(r2.isValid());
+    QCOMPARE(r2.checkIn, QTime(9, 0));
+
+    auto r3 = wt.getRecord(QDate(1996, 11, 28));
+    QVERIFY(r3.isValid());
+    QCOMPARE(r3.schedule->name, QString("test"));
+    QCOMPARE(r3.checkIn, QTime(10, 5));
+    QCOMPARE(r3.checkOut, QTime(12, 0));
+
+    // Empty input
+    QVERIFY(importer.importData(QByteArray()));
+    QCOMPARE(importer.importedCount(), 0);
+
+    clear(&db);
+}
+
+void TestWorktimeImporter::importData_errors()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+    WorktimeImporter importer(&wt);
+
+    wt.insertRecord(QDate(1996, 11, 30));
+
+    QByteArray data = "1996-11-26,08:55:00,17:10:00\n"
+                      "1996-11-27,08:55:00\n"               // Error: Missing field
+                      "1996-13-27,08:55:00,17:10:00\n"      // Error: Invalid date
+                      "1996-11-28,25:00:00,17:10:00\n"      // Error: Invalid check-in
+                      "1996-11-28,08:00:00,abc\n"           // Error: Invalid check-out
+                      "1996-11-28,18:00:00,17:00:00\n"      // Error: check-in > check-out
+                      "1996-11-28,08:00:00,17:00:00,tt\n"   // Error: Unknown schedule
+                      "1996-11-26,09:00:00,17:00:00\n"      // Error: Duplicate of line 1
+                      "1996-11-30,09:00:00,17:00:00\n"      // Error: Already in table
+                      "1996-11-29,09:00:00,17:00:00\n";
+
+    QVERIFY(importer.importData(data));
+    QCOMPARE(importer.importedCount(), 2);
+
+    auto errors = importer.errors();
+    QCOMPARE(errors.size(), 8);
+    for (int i = 0; i < errors.size(); ++i)
+        QCOMPARE(errors[i].line, i + 2);
+
+    QVERIFY(wt.getRecord(QDate(1996, 11, 26)).isValid());
+    QCOMPARE(wt.getRecord(QDate(1996, 11, 26)).checkIn, QTime(8, 55));
+    QVERIFY(wt.getRecord(QDate(1996, 11, 29)).isValid());
+    QVERIFY(!wt.getRecord(QDate(1996, 11, 28)).isValid());
+
+    QVERIFY(importer.importData("1996-11-21,08:00:00,17:00:00,default,x,y\n"));
+    QCOMPARE(importer.errors().size(), 1);
+    QCOMPARE(importer.errors()[0].message, QString("expected 3 or 4 fields, got 6"));
+
+    clear(&db);
+}
+
+void TestWorktimeImporter::importData_chunks()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+    WorktimeImporter importer(&wt);
+    importer.setThreadCount(4);
+
+    // Big enough to be split into several chunks
+    constexpr int rowCount = 20000;
+    auto d = QDate(1970, 1, 1);
+
+    QByteArray data;
+    for (int i = 0; i < rowCount; ++i)
+    {
+        if (i % 1000 == 999)
+            data += "broken line\n";
+        else
+            data += QString("%1,08:00:00,17:00:00\n").arg(d.addDays(i).toString(Qt::ISODate)).toLatin1();
+    }
+
+    QVERIFY(importer.importData(data));
+    QCOMPARE(importer.importedCount(), rowCount - rowCount / 1000);
+    QCOMPARE(importer.errors().size(), rowCount / 1000);
+    QCOMPARE(importer.errors().first().line, 1000);
+    QCOMPARE(importer.errors().last().line, rowCount);
+
+    QCOMPARE(wt.getRecords(d, d.addDays(rowCount - 1)).size(), rowCount - rowCount / 1000);
+
+    clear(&db);
+}
+
+void TestWorktimeImporter::importFile()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+    WorktimeImporter importer(&wt);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QFile file(dir.filePath("log.csv"));
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write("1996-11-26,08:55:00,17:10:00\n"
+               "1996-11-27,09:00:00,17:00:00\n");
+    file.close();
+
+    QVERIFY(importer.importFile(dir.filePath("log.csv")));
+    QCOMPARE(importer.importedCount(), 2);
+    QCOMPARE(wt.getRecord(QDate(1996, 11, 27)).checkIn, QTime(9, 0));
+
+    // Error: File doesn't exist
+    QVERIFY(!importer.importFile(dir.filePath("abc.csv")));
+
+    clear(&db);
+}
+
+QSqlDatabase TestWorktimeImporter::createDb() const
+{
+    auto db = QSqlDatabase::addDatabase("QSQLITE", ":memory:");
+    db.open();
+    return db;
+}
+
+void TestWorktimeImporter::clear(QSqlDatabase *db)
+{
+    db->close();
+    QSqlDatabase::removeDatabase(":memory:");
+}
@@ -0,0 +1,24 @@
+#ifndef TESTWORKTIMEIMPORTER_H
+#define TESTWORKTIMEIMPORTER_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QtTest/QTest>
+#include "worktimeimporter.h"
+
+class TestWorktimeImporter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void importData();
+    void importData_errors();
+    void importData_chunks();
+    void importFile();
+
+private:
+    QSqlDatabase createDb() const;
+    void clear(QSqlDatabase* db);
+};
+
+#endif // TESTWORKTIMEIMPORTER_H
@@ -0,0 +1,197 @@
+#include "testworktimesnapshot.h"
+#include "testworktimetracker.h"
+
+void TestWorktimeSnapshot::load()
+{
+    QSqlDatabase db = createDb();
+    auto wt = TestWorktimeTracker::example(db);
+
+    WorktimeSnapshot snapshot;
+    QVERIFY(snapshot.load(db));
+
+    QCOMPARE(snapshot.size(), 61);
+    QCOMPARE(snapshot.leavePassOffsets().size(), 62);
+    QCOMPARE(snapshot.leavePassBegins().size(), 5);
+
+    // Records are sorted by day
+    auto d = QDate(2022, 01, 18);
+    for (int i = 0; i < snapshot.size(); ++i)
+        QCOMPARE(qint64(snapshot.days()[i]), d.addDays(i).toJulianDay());
+
+    QCOMPARE(snapshot.checkIns()[0], 9 * 3600);
+    QCOMPARE(snapshot.checkOuts()[60], 18 * 3600);
+    QCOMPARE(snapshot.scheduleIds()[0], wt.defaultSchedule().id);
+
+    // 2022/01/19 has three leave passes, 2022/02/20 has one
+    int i = snapshot.lowerBound(qint32(QDate(2022, 01, 19).toJulianDay()));
+    QCOMPARE(i, 1);
+    QCOMPARE(snapshot.leavePassOffsets()[i + 1] - snapshot.leavePassOffsets()[i], 3);
+    QCOMPARE(snapshot.leavePassBegins()[snapshot.leavePassOffsets()[i]], 10 * 3600);
+
+    i = snapshot.lowerBound(qint32(QDate(2022, 02, 20).toJulianDay()));
+    QCOMPARE(snapshot.leavePassOffsets()[i + 1] - snapshot.leavePassOffsets()[i], 1);
+    QCOMPARE(snapshot.leavePassEnds()[snapshot.leavePassOffsets()[i]], 9 * 3600 + 35 * 60);
+
+    int id = wt.getSchedule("testschedule1").id;
+    QCOMPARE(snapshot.scheduleBegins()[id], 5 * 3600 + 25 * 60);
+    QCOMPARE(snapshot.scheduleEnds()[id], 9 * 3600 + 49 * 60);
+    QCOMPARE(snapshot.scheduleBegins()[0], -1);
+
+    clear(&db);
+}
+
+void TestWorktimeSnapshot::reload()
+{
+    QSqlDatabase db = createDb();
+    auto wt = TestWorktimeTracker::example(db);
+
+    WorktimeSnapshot snapshot;
+    QVERIFY(snapshot.load(db));
+
+    // Modify database behind the snapshot
+    wt.insertRecord(QDate(2022, 01, 10));
+    wt.insertLeavePass(QTime(9, 0), QTime(9, 30), QDate(2022, 01, 10));
+    wt.insertLeavePass(QTime(11, 0), QTime(11, 30), QDate(2022, 01, 20));
+    wt.setCheckIn(QTime(7, 0), QDate(2022, 01, 21));
+
+    QVERIFY(snapshot.reload(db, QDate(2022, 01, 21), QDate(2022, 01, 10)));
+
+    WorktimeSnapshot expected;
+    QVERIFY(expected.load(db));
+
+    QCOMPARE(snapshot.days(), expected.days());
+    QCOMPARE(snapshot.scheduleIds(), expected.scheduleIds());
+    QCOMPARE(snapshot.checkIns(), expected.checkIns());
+    QCOMPARE(snapshot.checkOuts(), expected.checkOuts());
+    QCOMPARE(snapshot.leavePassOffsets(), expected.leavePassOffsets());
+    QCOMPARE(snapshot.leavePassBegins(), expected.leavePassBegins());
+    QCOMPARE(snapshot.leavePassEnds(), expected.leavePassEnds());
+
+    QVERIFY(!snapshot.reload(db, QDate(), QDate(2022, 01, 10)));
+
+    clear(&db);
+}
+
+void TestWorktimeSnapshot::dayBalance()
+{
+    constexpr int h = 3600;
+
+    QVector<qint32> begins = {10 * h, 10 * h + 600, 16 * h, 8 * h};
+    QVector<qint32> ends   = {10 * h + 900, 11 * h, 17 * h, 17 * h};
+
+    // On time
+    QCOMPARE(WorktimeSnapshot::dayBalance(8 * h, 17 * h, 8 * h, 17 * h, nullptr, nullptr, 0), 0);
+    // Late arrival and overtime in the evening
+    QCOMPARE(WorktimeSnapshot::dayBalance(9 * h, 18 * h, 8 * h, 17 * h, nullptr, nullptr, 0), 0);
+    // Early arrival and early leaving
+    QCOMPARE(WorktimeSnapshot::dayBalance(7 * h, 16 * h, 8 * h, 17 * h, nullptr, nullptr, 0), 0);
+    // Overlapped leave passes are counted once
+    QCOMPARE(WorktimeSnapshot::dayBalance(8 * h, 17 * h, 8 * h, 17 * h, begins.constData(), ends.constData(), 2),
+             -qint64(h));
+    // Leave pass overlapped with early leaving
+    QCOMPARE(WorktimeSnapshot::dayBalance(8 * h, 16 * h + 1800, 8 * h, 17 * h, begins.constData() + 2, ends.constData() + 2, 1),
+             -qint64(h));
+    // Leave pass for the whole day
+    QCOMPARE(WorktimeSnapshot::dayBalance(9 * h, 18 * h, 8 * h, 17 * h, begins.constData() + 3, ends.constData() + 3, 1),
+             -8 * qint64(h));
+}
+
+void TestWorktimeSnapshot::getSummary()
+{
+    QSqlDatabase db = createDb();
+    auto wt = TestWorktimeTracker::example(db);
+
+    wt.setSchedule("testschedule1", QDate(2022, 02, 01), QDate(2022, 02, 03));
+    wt.insertLeavePass(QTime(10, 0), QTime(10, 0), QDate(2022, 03, 01));
+    wt.insertLeavePass(QTime(11, 0), QTime(10, 30), QDate(2022, 03, 02));
+
+    WorktimeSnapshot snapshot;
+    QVERIFY(snapshot.load(db));
+
+    // Every range must give the same result as SQL-based summary
+    auto first = QDate(2022, 01, 15);
+    for (int i = 0; i < 70; i += 3)
+        for (int j = i; j < 70; j += 5)
+            QCOMPARE(snapshot.getSummary(first.addDays(i), first.addDays(j)).seconds,
+                     wt.getSummary(first.addDays(i), first.addDays(j)).seconds);
+
+    QCOMPARE(snapshot.getSummary(QDate(2022, 01, 19)).seconds, wt.getSummary(QDate(2022, 01, 19)).seconds);
+    QCOMPARE(snapshot.getSummary(QDate(2022, 03, 02)).seconds, wt.getSummary(QDate(2022, 03, 02)).seconds);
+    QCOMPARE(snapshot.getSummary(QDate(2023, 01, 01), QDate(2022, 01, 01)).seconds,
+             wt.getSummary(QDate(2022, 01, 01), QDate(2023, 01, 01)).seconds);
+    QCOMPARE(snapshot.getSummary(QDate()).seconds, 0);
+
+    // Unknown schedule makes summary invalid as well as in WorktimeTracker
+    QSqlQuery query(db);
+    query.exec("UPDATE worktime SET Schedule = 99 WHERE Date = '2022-02-10'");
+    QVERIFY(snapshot.reload(db, QDate(2022, 02, 10), QDate(2022, 02, 10)));
+    QCOMPARE(snapshot.getSummary(QDate(2022, 02, 01), QDate(2022, 02, 28)).seconds, 0);
+    QCOMPARE(snapshot.getSummary(QDate(2022, 02, 11), QDate(2022, 02, 28)).seconds,
+             wt.getSummary(QDate(2022, 02, 11), QDate(2022, 02, 28)).seconds);
+
+    clear(&db);
+}
+
+void TestWorktimeSnapshot::getSummary_sync()
+{
+    QSqlDatabase db = createDb();
+    auto wt = TestWorktimeTracker::example(db);
+
+    QVERIFY(wt.setSnapshotEnabled(true));
+    QVERIFY(wt.isSnapshotEnabled());
+    QVERIFY(wt.snapshot());
+
+    // Copy without snapshot computes summaries with SQL
+    auto sql = wt;
+    sql.setSnapshotEnabled(false);
+    QVERIFY(!sql.snapshot());
+
+    auto from = QDate(2022, 01, 01);
+    auto to   = QDate(2022, 04, 30);
+    QCOMPARE(wt.getSummary(from, to).seconds, sql.getSummary(from, to).seconds);
+
+    // All write methods have to keep the snapshot in sync
+    wt.insertSchedule("custom", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0));
+    wt.insertRecord(QDate(2022, 01, 10), QTime(7, 30), QTime(17, 0));
+    wt.insertRecord(QDate(2022, 01, 11), QTime(7, 30), QTime(11, 0), "custom");
+    wt.insertRecords({ { QDate(2022, 01, 12), wt.scheduleRef("custom"), QTime(10, 0), QTime(12, 30) },
+                       { QDate(2022, 01, 14), wt.scheduleRef("default"), QTime(9, 0), QTime(17, 0) } });
+    QCOMPARE(wt.getSummary(from, to).seconds, sql.getSummary(from, to).seconds);
+
+    wt.setSchedule("custom", QDate(2022, 02, 01), QDate(2022, 02, 05));
+    wt.setCheckIn(QTime(10, 15), QDate(2022, 02, 02));
+    wt.setCheckOut(QTime(11, 45), QDate(2022, 02, 03), QDate(2022, 02, 04));
+    QCOMPARE(wt.getSummary(from, to).seconds, sql.getSummary(from, to).seconds);
+
+    wt.insertLeavePass(QTime(13, 0), QTime(14, 0), QDate(2022, 01, 10));
+    wt.insertLeavePass(QTime(15, 0), QTime(15, 10), QDate(2022, 01, 20));
+    wt.setLeavePassBegin(QTime(12, 30), QDate(2022, 01, 10), 0);
+    wt.setLeavePassEnd(QTime(11, 0), QDate(2022, 01, 19), 1);
+    QCOMPARE(wt.getSummary(from, to).seconds, sql.getSummary(from, to).seconds);
+    QCOMPARE(wt.getSummary(QDate(2022, 01, 19)).seconds, sql.getSummary(QDate(2022, 01, 19)).seconds);
+
+    // Changes made behind the tracker are picked up by refreshSnapshot()
+    QSqlQuery query(db);
+    query.exec("UPDATE worktime SET CheckIn = '06:00:00' WHERE Date = '2022-03-01'");
+    QVERIFY(wt.refreshSnapshot());
+    QCOMPARE(wt.getSummary(3, 2022).seconds, sql.getSummary(3, 2022).seconds);
+
+    QVERIFY(wt.setSnapshotEnabled(false));
+    QVERIFY(!wt.isSnapshotEnabled());
+    QVERIFY(!wt.refreshSnapshot());
+
+    clear(&db);
+}
+
+QSqlDatabase TestWorktimeSnapshot::createDb() const
+{
+    auto db = QSqlDatabase::addDatabase("QSQLITE", ":memory:");
+    db.open();
+    return db;
+}
+
+void TestWorktimeSnapshot::clear(QSqlDatabase *db)
+{
+    db->close();
+    QSqlDatabase::removeDatabase(":memory:");
+}
@@ -0,0 +1,25 @@
+#ifndef TESTWORKTIMESNAPSHOT_H
+#define TESTWORKTIMESNAPSHOT_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QtTest/QTest>
+#include "worktimetracker.h"
+
+class TestWorktimeSnapshot : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void load();
+    void reload();
+    void dayBalance();
+    void getSummary();
+    void getSummary_sync();
+
+private:
+    QSqlDatabase createDb() const;
+    void clear(QSqlDatabase* db);
+};
+
+#endif // TESTWORKTIMESNAPSHOT_H
@@ -0,0 +1,176 @@
+#include "testworktimestate.h"
+#include <atomic>
+#include <thread>
+
+void TestWorktimeState::publish()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    auto d = QDate(2022, 1, 10);
+    wt.insertRecord(d, QTime(9, 0), QTime(17, 0));
+    wt.insertRecord(d.addDays(1), QTime(8, 0), QTime(18, 0));
+    wt.insertLeavePass(QTime(12, 0), QTime(13, 0), d.addDays(1));
+
+    // State is published only with snapshot
+    QVERIFY(!wt.state());
+    QVERIFY(wt.setSnapshotEnabled(true));
+
+    auto first = wt.state();
+    QVERIFY(first);
+    QCOMPARE(first->employee(), 0);
+    QCOMPARE(first->getSummary(d, d.addDays(1)).seconds, wt.getSummary(d, d.addDays(1)).seconds);
+    QCOMPARE(first->getSummary(d.addDays(1), d).seconds, qint64(-3600));
+
+    auto r = first->getRecord(d);
+    QVERIFY(r.isValid());
+    QCOMPARE(r.checkIn, QTime(9, 0));
+    QCOMPARE(r.checkOut, QTime(17, 0));
+    QCOMPARE(r.schedule->name, wt.defaultSchedule().name);
+    QVERIFY(!first->getRecord(d.addDays(2)).isValid());
+    QCOMPARE(first->getSchedule(wt.defaultSchedule().name).begin, QTime(8, 0));
+
+    // Published version never changes, writes publish a new one
+    QVERIFY(wt.setCheckIn(QTime(8, 0), d));
+    auto second = wt.state();
+    QVERIFY(second->version() > first->version());
+    QCOMPARE(first->getRecord(d).checkIn, QTime(9, 0));
+    QCOMPARE(second->getRecord(d).checkIn, QTime(8, 0));
+    QCOMPARE(second->getSummary(d).seconds, qint64(0));
+
+    // Writes of a transaction are published when it's committed
+    {
+        WorktimeTracker::Transaction transaction(&wt);
+        QVERIFY(wt.insertRecord(d.addDays(2), QTime(8, 0), QTime(17, 0)));
+        QVERIFY(wt.insertSchedule("custom", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0)));
+        QCOMPARE(wt.state(), second);
+        QVERIFY(transaction.commit());
+    }
+    QVERIFY(wt.state()->getRecord(d.addDays(2)).isValid());
+    QVERIFY(wt.state()->getSchedule("custom").isValid());
+
+    {
+        WorktimeTracker::Transaction transaction(&wt);
+        QVERIFY(wt.insertRecord(d.addDays(3), QTime(8, 0), QTime(17, 0)));
+    }
+    QVERIFY(!wt.state()->getRecord(d.addDays(3)).isValid());
+
+    // Pending group isn't published until it's flushed
+    auto third = wt.state();
+    wt.setGroupCommit(10);
+    QVERIFY(wt.setCheckOut(QTime(16, 0), d));
+    QCOMPARE(wt.state(), third);
+    QVERIFY(wt.flushGroupCommit());
+    QCOMPARE(wt.state()->getSummary(d).seconds, qint64(-3600));
+    wt.setGroupCommit(0);
+
+    // Another employee gets own state, the old one stays valid
+    wt.setEmployee(1);
+    QCOMPARE(wt.state()->employee(), 1);
+    QVERIFY(!wt.state()->getRecord(d).isValid());
+    QCOMPARE(third->getRecord(d).checkOut, QTime(17, 0));
+
+    QVERIFY(wt.setSnapshotEnabled(false));
+    QVERIFY(!wt.state());
+
+    clear(&db);
+}
+
+void TestWorktimeState::closedMonths()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+    QVERIFY(wt.setSnapshotEnabled(true));
+
+    for (auto d = QDate(2022, 1, 3); d <= QDate(2022, 2, 25); d = d.addDays(1))
+        wt.insertRecord(d, QTime(9, 0), QTime(17, 0));
+
+    QVERIFY(wt.closeMonth(1, 2022));
+
+    auto state = wt.state();
+    auto from  = QDate(2021, 12, 20);
+    auto to    = QDate(2022, 2, 10);
+
+    QCOMPARE(state->getSummary(from, to).seconds, wt.getSummary(from, to).seconds);
+    QCOMPARE(state->getSummary(QDate(2022, 1, 1), QDate(2022, 1, 31)).seconds, wt.getSummary(1, 2022).seconds);
+    QCOMPARE(state->getSummary(QDate(2022, 1, 15), QDate(2022, 2, 5)).seconds, wt.getSummary(QDate(2022, 1, 15), QDate(2022, 2, 5)).seconds);
+
+    QCOMPARE(state->getSummary(QDate(), to).seconds, qint64(0));
+
+    // Reopened month is computed from its days again
+    QVERIFY(wt.reopenMonth(1, 2022));
+    QVERIFY(wt.setCheckIn(QTime(10, 0), QDate(2022, 1, 3)));
+    QCOMPARE(wt.state()->getSummary(QDate(2022, 1, 1), QDate(2022, 1, 31)).seconds, wt.getSummary(1, 2022).seconds);
+    QCOMPARE(wt.state()->getSummary(QDate(2022, 1, 1), QDate(2022, 1, 31)).seconds,
+             state->getSummary(QDate(2022, 1, 1), QDate(2022, 1, 31)).seconds - 3600);
+
+    clear(&db);
+}
+
+void TestWorktimeState::readers()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+    QVERIFY(wt.setSnapshotEnabled(true));
+
+    constexpr int readerCount = 4;
+    constexpr int dayCount    = 200;
+
+    auto from = QDate(2022, 1, 1);
+    auto to   = from.addDays(dayCount);
+
+    std::atomic<bool> stop(false);
+    std::atomic<int>  inconsistent(0);
+    std::atomic<int>  reads(0);
+
+    // Every record is one hour of debt, so a consistent state has
+    // the summary of minus one hour for each of its records
+    auto read = [&]() {
+        quint64 version = 0;
+        while (!stop)
+        {
+            auto state = wt.state();
+            if (state->version() < version ||
+                state->getSummary(from, to).seconds != -3600 * qint64(state->snapshot().size()))
+                ++inconsistent;
+
+            version = state->version();
+            ++reads;
+        }
+    };
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < readerCount; ++i)
+        readers.emplace_back(read);
+
+    for (int i = 0; i < dayCount; ++i)
+        QVERIFY(wt.insertRecord(from.addDays(i), QTime(9, 0), QTime(17, 0)));
+
+    // Readers see at least one version before they're stopped
+    while (reads.load() == 0)
+        std::this_thread::yield();
+
+    stop = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    QCOMPARE(inconsistent.load(), 0);
+    QVERIFY(reads.load() > 0);
+    QCOMPARE(wt.state()->snapshot().size(), dayCount);
+    QCOMPARE(wt.state()->getSummary(from, to).seconds, qint64(-3600) * dayCount);
+
+    clear(&db);
+}
+
+QSqlDatabase TestWorktimeState::createDb() const
+{
+    auto db = QSqlDatabase::addDatabase("QSQLITE", ":memory:");
+    db.open();
+    return db;
+}
+
+void TestWorktimeState::clear(QSqlDatabase *db)
+{
+    db->close();
+    QSqlDatabase::removeDatabase(":memory:");
+}
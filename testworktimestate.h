@@ -0,0 +1,23 @@
+#ifndef TESTWORKTIMESTATE_H
+#define TESTWORKTIMESTATE_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QtTest/QTest>
+#include "worktimestate.h"
+
+class TestWorktimeState : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void publish();
+    void closedMonths();
+    void readers();
+
+private:
+    QSqlDatabase createDb() const;
+    void clear(QSqlDatabase* db);
+};
+
+#endif // TESTWORKTIMESTATE_H
@@ -0,0 +1,396 @@
+#include "testworktimestorage.h"
+
+// Counts writes of single records
+class CountingStorage : public SqlWorktimeStorage
+{
+public:
+    using SqlWorktimeStorage::SqlWorktimeStorage;
+
+    bool updateRecord(int employee, const Record& record) override
+    {
+        ++updates;
+        return SqlWorktimeStorage::updateRecord(employee, record);
+    }
+
+    int updates = 0;
+};
+
+void TestWorktimeStorage::sql()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    SqlWorktimeStorage storage(db);
+    checkStorage(&storage);
+
+    // Records written by the storage are seen by the tracker
+    wt.setEmployee(1);
+    QCOMPARE(wt.getRecord(QDate(2022, 1, 10)).checkOut, QTime(18, 0));
+    QCOMPARE(wt.getLeavePassList(QDate(2022, 1, 10)).size(), 2);
+
+    clear(&db);
+}
+
+void TestWorktimeStorage::memory()
+{
+    MemoryWorktimeStorage storage;
+    checkStorage(&storage);
+
+    storage.clear();
+    QVector<WorktimeStorage::Record> records;
+    QVERIFY(storage.getRecords(1, QDate(), QDate(), &records));
+    QVERIFY(records.isEmpty());
+}
+
+void TestWorktimeStorage::writeThrough()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    auto d = QDate(2022, 1, 10);
+    wt.insertRecord(d, QTime(9, 0), QTime(17, 0));
+    wt.insertRecord(d.addDays(1), QTime(8, 0), QTime(18, 0));
+    wt.insertLeavePass(QTime(12, 0), QTime(13, 0), d.addDays(1), "lunch");
+
+    SqlWorktimeStorage sql(db);
+    MemoryWorktimeStorage cache(&sql);
+
+    // Data is read from the backing storage on the first access
+    QVector<WorktimeStorage::Record> records;
+    QVERIFY(cache.getRecords(0, QDate(), QDate(), &records));
+    QCOMPARE(records.size(), 2);
+    QCOMPARE(records[0].checkInTime(), QTime(9, 0));
+
+    QVector<WorktimeStorage::Schedule> schedules;
+    QVERIFY(cache.getSchedules(&schedules));
+    QCOMPARE(schedules.size(), 1);
+    QCOMPARE(schedules[0].name, wt.defaultSchedule().name);
+
+    QVector<WorktimeStorage::LeavePass> passes;
+    QVERIFY(cache.getLeavePasses(0, d, d.addDays(1), &passes));
+    QCOMPARE(passes.size(), 1);
+    QCOMPARE(passes[0].comment, QString("lunch"));
+
+    // Writes go through to the backing storage
+    auto id = wt.defaultSchedule().id;
+    QVERIFY(cache.insertRecord(0, record(d.addDays(2), id, QTime(8, 30), QTime(17, 0))));
+    QVERIFY(cache.updateRecord(0, record(d, id, QTime(8, 0), QTime(17, 0))));
+    QVERIFY(!cache.insertRecord(0, record(d, id, QTime(8, 0), QTime(17, 0))));
+
+    WorktimeStorage::LeavePass pass = {};
+    pass.date = d.addDays(1);
+    pass.from = QTime(15, 0);
+    pass.to   = QTime(15, 30);
+    QVERIFY(cache.insertLeavePass(0, &pass));
+    QCOMPARE(pass.id, 1);
+
+    QCOMPARE(wt.getRecord(d.addDays(2)).checkIn, QTime(8, 30));
+    QCOMPARE(wt.getRecord(d).checkIn, QTime(8, 0));
+    QCOMPARE(wt.getLeavePassList(d.addDays(1)).size(), 2);
+
+    // Rejected writes aren't applied in memory, reads don't need the backing storage
+    db.close();
+    QVERIFY(!cache.insertRecord(0, record(d.addDays(3), id, QTime(8, 0), QTime(17, 0))));
+    QVERIFY(!cache.removeRecord(0, d));
+
+    WorktimeStorage::Record r;
+    QVERIFY(!cache.getRecord(0, d.addDays(3), &r));
+    QVERIFY(cache.getRecord(0, d, &r));
+    QVERIFY(cache.getRecords(0, QDate(), QDate(), &records));
+    QCOMPARE(records.size(), 3);
+
+    clear(&db);
+}
+
+void TestWorktimeStorage::snapshot()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    wt.insertSchedule("short", QTime(10, 0), QTime(14, 0), QTime(12, 0), QTime(12, 30));
+
+    auto d = QDate(2022, 1, 10);
+    for (int i = 0; i < 40; ++i)
+    {
+        auto date = d.addDays(i);
+        wt.insertRecord(date, QTime(8, i % 30), QTime(16 + i % 3, 0), i % 4 ? "default" : "short");
+        if (i % 5 == 0)
+            wt.insertLeavePass(QTime(11, 0), QTime(11, 20 + i % 3), date);
+    }
+
+    WorktimeSnapshot fromDb;
+    QVERIFY(fromDb.load(db));
+
+    // Snapshot of any storage gives the same summaries
+    SqlWorktimeStorage sql(db);
+    MemoryWorktimeStorage cache(&sql);
+
+    WorktimeSnapshot fromSql, fromMemory;
+    QVERIFY(sql.loadSnapshot(&fromSql));
+    QVERIFY(cache.loadSnapshot(&fromMemory));
+
+    QCOMPARE(fromMemory.size(), fromDb.size());
+    for (int i = 0; i < 40; i += 7)
+    {
+        auto from = d.addDays(i);
+        auto to   = d.addDays(i + 9);
+        QCOMPARE(fromSql.getSummary(from, to).seconds, fromDb.getSummary(from, to).seconds);
+        QCOMPARE(fromMemory.getSummary(from, to).seconds, fromDb.getSummary(from, to).seconds);
+        QCOMPARE(fromMemory.getSummary(from, to).seconds, wt.getSummary(from, to).seconds);
+    }
+
+    // Storage without database
+    MemoryWorktimeStorage memory;
+    WorktimeStorage::Schedule schedule = wt.defaultSchedule();
+    QVERIFY(memory.insertSchedule(&schedule));
+    QVERIFY(memory.insertRecord(0, record(d, schedule.id, QTime(9, 0), QTime(17, 30))));
+
+    WorktimeStorage::LeavePass pass = {};
+    pass.date = d;
+    pass.from = QTime(13, 0);
+    pass.to   = QTime(14, 0);
+    QVERIFY(memory.insertLeavePass(0, &pass));
+
+    WorktimeSnapshot fromScratch;
+    QVERIFY(memory.loadSnapshot(&fromScratch));
+    QCOMPARE(fromScratch.getSummary(d).seconds, qint64(-90 * 60));
+
+    clear(&db);
+}
+
+void TestWorktimeStorage::tracker()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+    QVERIFY(std::dynamic_pointer_cast<SqlWorktimeStorage>(wt.storage()));
+
+    SqlWorktimeStorage sql(db);
+    auto cache = std::make_shared<MemoryWorktimeStorage>(&sql);
+
+    WorktimeTracker cached(db);
+    QVERIFY(cached.setStorage(cache));
+    QCOMPARE(cached.storage(), std::static_pointer_cast<WorktimeStorage>(cache));
+
+    // Error: Summaries wouldn't see data kept apart from the tables
+    QVERIFY(!wt.setStorage(std::make_shared<MemoryWorktimeStorage>()));
+    QVERIFY(!wt.setStorage(nullptr));
+    QVERIFY(std::dynamic_pointer_cast<SqlWorktimeStorage>(wt.storage()));
+
+    // Writes of the tracker go through the cache, the tables see them
+    auto d = QDate(2022, 1, 10);
+    QVERIFY(cached.insertRecord(d, QTime(9, 0), QTime(17, 0)));
+    QVERIFY(cached.insertRecord(d.addDays(1), QTime(8, 0), QTime(18, 0)));
+    QVERIFY(cached.setCheckIn(QTime(8, 30), d));
+    QVERIFY(!cached.setCheckOut(QTime(8, 0), d));
+    QVERIFY(cached.insertLeavePass(QTime(12, 0), QTime(13, 0), d, "lunch"));
+    QVERIFY(!cached.insertLeavePass(QTime(12, 0), QTime(13, 0), d));
+    QVERIFY(cached.setLeavePassEnd(QTime(12, 30), d, 0));
+    QVERIFY(!cached.setLeavePassBegin(QTime(12, 45), d, 0));
+
+    WorktimeStorage::Record r;
+    QVERIFY(cache->getRecord(0, d, &r));
+    QCOMPARE(r.checkInTime(), QTime(8, 30));
+
+    QCOMPARE(wt.getRecord(d).checkIn, QTime(8, 30));
+    QCOMPARE(wt.getLeavePassList(d).size(), 1);
+    QCOMPARE(wt.getLeavePassList(d)[0].to, QTime(12, 30));
+    QCOMPARE(cached.getSummary(d, d.addDays(1)).seconds, wt.getSummary(d, d.addDays(1)).seconds);
+
+    // Assigned schedule is read by both storages and by the tracker
+    QVERIFY(cached.insertSchedule("short", QTime(10, 0), QTime(14, 0), QTime(12, 0), QTime(12, 30)));
+    QVERIFY(cached.setSchedule("short", d, d.addDays(1)));
+
+    auto id = cached.getSchedule("short").id;
+    QVERIFY(cache->getRecord(0, d, &r));
+    QCOMPARE(r.scheduleId(), id);
+    QVERIFY(sql.getRecord(0, d.addDays(1), &r));
+    QCOMPARE(r.scheduleId(), id);
+    QCOMPARE(wt.getRecord(d).schedule->name, QString("short"));
+    QCOMPARE(cached.getRecord(d.addDays(1)).schedule->name, QString("short"));
+
+    // Rolled back writes are dropped from the cache
+    {
+        WorktimeTracker::Transaction transaction(&cached);
+        QVERIFY(cached.insertRecord(d.addDays(2), QTime(8, 0), QTime(17, 0)));
+        QVERIFY(cached.getRecord(d.addDays(2)).isValid());
+    }
+    QVERIFY(!cache->getRecord(0, d.addDays(2), &r));
+    QVERIFY(!cached.getRecord(d.addDays(2)).isValid());
+    QCOMPARE(cached.getRecords(d, d.addDays(2)).size(), 2);
+
+    // Range writes aren't split into writes of single records
+    auto counting = std::make_shared<CountingStorage>(db);
+    WorktimeTracker counted(db);
+    counted.setEmployee(2);
+    QVERIFY(counted.setStorage(counting));
+
+    for (int i = 0; i < 10; ++i)
+        QVERIFY(counted.insertRecord(d.addDays(i), QTime(8, 0), QTime(17, 0)));
+
+    QVERIFY(counted.setCheckIn(QTime(9, 0), d, d.addDays(9)));
+    QVERIFY(counted.setCheckOut(QTime(16, 0), d, d.addDays(9)));
+    QVERIFY(counted.setSchedule("short", d.addDays(2), d.addDays(7)));
+    QCOMPARE(counting->updates, 0);
+    QCOMPARE(counted.getRecord(d.addDays(9)).checkIn, QTime(9, 0));
+    QCOMPARE(counted.getRecord(d.addDays(7)).schedule->name, QString("short"));
+    QCOMPARE(counted.getRecord(d.addDays(8)).schedule->name, counted.defaultSchedule().name);
+
+    clear(&db);
+}
+
+void TestWorktimeStorage::checkStorage(WorktimeStorage *storage)
+{
+    WorktimeStorage::Schedule s;
+    s.name           = "custom";
+    s.begin          = QTime(8, 0);
+    s.end            = QTime(17, 0);
+    s.lunchTimeBegin = QTime(12, 0);
+    s.lunchTimeEnd   = QTime(13, 0);
+
+    QVERIFY(storage->insertSchedule(&s));
+    QVERIFY(s.id > 0);
+
+    auto duplicate = s;
+    QVERIFY(!storage->insertSchedule(&duplicate));
+
+    QVector<WorktimeStorage::Schedule> schedules;
+    QVERIFY(storage->getSchedules(&schedules));
+    QCOMPARE(schedules.last().id, s.id);
+    QCOMPARE(schedules.last().name, s.name);
+    QCOMPARE(schedules.last().lunchTimeEnd, s.lunchTimeEnd);
+
+    // Records
+    auto d = QDate(2022, 1, 10);
+    QVERIFY(storage->insertRecord(1, record(d.addDays(2), s.id, QTime(8, 0), QTime(17, 0))));
+    QVERIFY(storage->insertRecord(1, record(d, s.id, QTime(9, 0), QTime(17, 0))));
+    QVERIFY(storage->insertRecord(1, record(d.addDays(1), s.id, QTime(8, 30), QTime(17, 0))));
+    QVERIFY(!storage->insertRecord(1, record(d, s.id, QTime(8, 0), QTime(17, 0))));
+    QVERIFY(!storage->insertRecord(1, record(QDate(), s.id, QTime(8, 0), QTime(17, 0))));
+
+    QVector<WorktimeStorage::Record> records;
+    QVERIFY(storage->getRecords(1, d.addDays(1), d, &records));
+    QCOMPARE(records.size(), 2);
+    QCOMPARE(records[0].date(), d);
+    QCOMPARE(records[1].date(), d.addDays(1));
+
+    QVERIFY(storage->getRecords(1, QDate(), QDate(), &records));
+    QCOMPARE(records.size(), 3);
+    QCOMPARE(records[2].date(), d.addDays(2));
+
+    QVERIFY(storage->getRecords(2, QDate(), QDate(), &records));
+    QVERIFY(records.isEmpty());
+
+    WorktimeStorage::Record r;
+    QVERIFY(storage->getRecord(1, d, &r));
+    QCOMPARE(r.checkInTime(), QTime(9, 0));
+    QCOMPARE(r.scheduleId(), s.id);
+    QVERIFY(!storage->getRecord(1, d.addDays(3), &r));
+    QVERIFY(!storage->getRecord(2, d, &r));
+
+    QVERIFY(storage->updateRecord(1, record(d, s.id, QTime(9, 0), QTime(18, 0))));
+    QVERIFY(storage->getRecord(1, d, &r));
+    QCOMPARE(r.checkOutTime(), QTime(18, 0));
+    QVERIFY(!storage->updateRecord(1, record(d.addDays(5), s.id, QTime(9, 0), QTime(18, 0))));
+
+    QVERIFY(storage->removeRecord(1, d.addDays(1)));
+    QVERIFY(!storage->removeRecord(1, d.addDays(1)));
+    QVERIFY(storage->getRecords(1, QDate(), QDate(), &records));
+    QCOMPARE(records.size(), 2);
+
+    // Range writes skip records where check in would be after check out and vice versa
+    QVERIFY(storage->insertRecord(1, record(d.addDays(3), s.id, QTime(8, 0), QTime(10, 0))));
+    QVERIFY(storage->setCheckIns(1, d.addDays(3), d, QTime(9, 30)));
+    QVERIFY(storage->getRecord(1, d, &r));
+    QCOMPARE(r.checkInTime(), QTime(9, 30));
+    QVERIFY(storage->getRecord(1, d.addDays(3), &r));
+    QCOMPARE(r.checkInTime(), QTime(9, 30));
+    QVERIFY(!storage->setCheckIns(1, d, d.addDays(3), QTime(19, 0)));
+    QVERIFY(!storage->setCheckIns(2, d, d.addDays(3), QTime(9, 0)));
+
+    QVERIFY(storage->setCheckOuts(1, d.addDays(2), d.addDays(3), QTime(17, 30)));
+    QVERIFY(storage->getRecord(1, d.addDays(3), &r));
+    QCOMPARE(r.checkOutTime(), QTime(17, 30));
+    QVERIFY(storage->getRecord(1, d, &r));
+    QCOMPARE(r.checkOutTime(), QTime(18, 0));
+    QVERIFY(!storage->setCheckOuts(1, d.addDays(5), d.addDays(6), QTime(17, 0)));
+    QVERIFY(storage->removeRecord(1, d.addDays(3)));
+
+    // Records of the range are read with the assigned schedule
+    auto other = s;
+    other.name = "other";
+    QVERIFY(storage->insertSchedule(&other));
+    QVERIFY(storage->assignSchedule(1, other.id, d, d.addDays(1)));
+    QVERIFY(!storage->assignSchedule(1, other.id, QDate(), d));
+    QVERIFY(storage->getRecord(1, d, &r));
+    QCOMPARE(r.scheduleId(), other.id);
+    QVERIFY(storage->getRecord(1, d.addDays(2), &r));
+    QCOMPARE(r.scheduleId(), s.id);
+
+    // Leave passes
+    auto insertPass = [storage](const QDate& date, const QTime& from, const QTime& to) {
+        WorktimeStorage::LeavePass pass = {};
+        pass.date = date;
+        pass.from = from;
+        pass.to   = to;
+        return storage->insertLeavePass(1, &pass) ? pass.id : -1;
+    };
+
+    QCOMPARE(insertPass(d, QTime(10, 0), QTime(11, 0)), 0);
+    QCOMPARE(insertPass(d, QTime(14, 0), QTime(15, 0)), 1);
+    QCOMPARE(insertPass(d.addDays(2), QTime(10, 0), QTime(11, 0)), 0);
+    QCOMPARE(insertPass(QDate(), QTime(10, 0), QTime(11, 0)), -1);
+
+    QVERIFY(storage->removeLeavePass(1, d, 0));
+    QVERIFY(!storage->removeLeavePass(1, d, 0));
+    QCOMPARE(insertPass(d, QTime(16, 0), QTime(16, 30)), 2);
+
+    WorktimeStorage::LeavePass pass = {};
+    pass.date    = d;
+    pass.id      = 1;
+    pass.from    = QTime(14, 0);
+    pass.to      = QTime(14, 30);
+    pass.comment = "doctor";
+    QVERIFY(storage->updateLeavePass(1, pass));
+    pass.id = 5;
+    QVERIFY(!storage->updateLeavePass(1, pass));
+
+    QVector<WorktimeStorage::LeavePass> passes;
+    QVERIFY(storage->getLeavePasses(1, d, d, &passes));
+    QCOMPARE(passes.size(), 2);
+    QCOMPARE(passes[0].id, 1);
+    QCOMPARE(passes[0].to, QTime(14, 30));
+    QCOMPARE(passes[0].comment, QString("doctor"));
+    QCOMPARE(passes[1].id, 2);
+
+    QVERIFY(storage->getLeavePasses(1, QDate(), QDate(), &passes));
+    QCOMPARE(passes.size(), 3);
+    QCOMPARE(passes[2].date, d.addDays(2));
+
+    QVERIFY(storage->getLeavePasses(2, QDate(), QDate(), &passes));
+    QVERIFY(passes.isEmpty());
+}
+
+WorktimeStorage::Record TestWorktimeStorage::record(const QDate &date, int scheduleId, const QTime &checkIn, const QTime &checkOut)
+{
+    WorktimeTracker::Record r;
+    r.date     = date;
+    r.checkIn  = checkIn;
+    r.checkOut = checkOut;
+
+    auto c = WorktimeStorage::Record::fromRecord(r);
+    c.setScheduleId(scheduleId);
+    return c;
+}
+
+QSqlDatabase TestWorktimeStorage::createDb() const
+{
+    auto db = QSqlDatabase::addDatabase("QSQLITE", ":memory:");
+    db.open();
+    return db;
+}
+
+void TestWorktimeStorage::clear(QSqlDatabase *db)
+{
+    db->close();
+    QSqlDatabase::removeDatabase(":memory:");
+}
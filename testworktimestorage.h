@@ -0,0 +1,27 @@
+#ifndef TESTWORKTIMESTORAGE_H
+#define TESTWORKTIMESTORAGE_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QtTest/QTest>
+#include "memoryworktimestorage.h"
+
+class TestWorktimeStorage : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sql();
+    void memory();
+    void writeThrough();
+    void snapshot();
+    void tracker();
+
+private:
+    QSqlDatabase createDb() const;
+    void clear(QSqlDatabase* db);
+    void checkStorage(WorktimeStorage* storage);
+    static WorktimeStorage::Record record(const QDate& date, int scheduleId, const QTime& checkIn, const QTime& checkOut);
+};
+
+#endif // TESTWORKTIMESTORAGE_H
@@ -1,4 +1,5 @@
 #include "testworktimetracker.h"
+#include <QTemporaryDir>
 
 WorktimeTracker TestWorktimeTracker::example(const QSqlDatabase &db)
 {
@@ -51,25 +52,203 @@ void TestWorktimeTracker::insertSchedule()
 
     q.next();
 
-    QCOMPARE(q.value(0).toString(), wt.defaultSchedule().name);
-    QCOMPARE(q.value(1).toTime(), wt.defaultSchedule().begin);
-    QCOMPARE(q.value(2).toTime(), wt.defaultSchedule().end);
-    QCOMPARE(q.value(3).toTime(), wt.defaultSchedule().lunchTimeBegin);
-    QCOMPARE(q.value(4).toTime(), wt.defaultSchedule().lunchTimeEnd);
+    QCOMPARE(q.value(0).toInt(), wt.defaultSchedule().id);
+    QCOMPARE(q.value(1).toString(), wt.defaultSchedule().name);
+    QCOMPARE(q.value(2).toTime(), wt.defaultSchedule().begin);
+    QCOMPARE(q.value(3).toTime(), wt.defaultSchedule().end);
+    QCOMPARE(q.value(4).toTime(), wt.defaultSchedule().lunchTimeBegin);
+    QCOMPARE(q.value(5).toTime(), wt.defaultSchedule().lunchTimeEnd);
 
     q.next();
-    QCOMPARE(q.value(0).toString(), QString("test1"));
-    QCOMPARE(q.value(1).toTime(), QTime(9, 0));
-    QCOMPARE(q.value(2).toTime(), QTime(11, 0));
-    QCOMPARE(q.value(3).toTime(), QTime(10, 0));
-    QCOMPARE(q.value(4).toTime(), QTime(10, 30));
+    QCOMPARE(q.value(0).toInt(), wt.getSchedule("test1").id);
+    QCOMPARE(q.value(1).toString(), QString("test1"));
+    QCOMPARE(q.value(2).toTime(), QTime(9, 0));
+    QCOMPARE(q.value(3).toTime(), QTime(11, 0));
+    QCOMPARE(q.value(4).toTime(), QTime(10, 0));
+    QCOMPARE(q.value(5).toTime(), QTime(10, 30));
 
     q.next();
-    QCOMPARE(q.value(0).toString(), QString("test1_1"));
-    QCOMPARE(q.value(1).toTime(), QTime(9, 30));
-    QCOMPARE(q.value(2).toTime(), QTime(11, 30));
-    QCOMPARE(q.value(3).toTime(), QTime(10, 30));
-    QCOMPARE(q.value(4).toTime(), QTime(11, 0));
+    QCOMPARE(q.value(0).toInt(), wt.getSchedule("test1_1").id);
+    QCOMPARE(q.value(1).toString(), QString("test1_1"));
+    QCOMPARE(q.value(2).toTime(), QTime(9, 30));
+    QCOMPARE(q.value(3).toTime(), QTime(11, 30));
+    QCOMPARE(q.value(4).toTime(), QTime(10, 30));
+    QCOMPARE(q.value(5).toTime(), QTime(11, 0));
+
+    // Schedules get distinct ids
+    QVERIFY(wt.defaultSchedule().id > 0);
+    QVERIFY(wt.getSchedule("test1").id != wt.defaultSchedule().id);
+    QVERIFY(wt.getSchedule("test1").id != wt.getSchedule("test1_1").id);
+
+    clear(&db);
+}
+
+void TestWorktimeTracker::fillMissingDays()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    wt.insertSchedule("custom", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0));
+
+    auto d = QDate(2022, 01, 10);    // Monday
+    wt.insertRecord(d.addDays(2), QTime(9, 0), QTime(17, 0));
+    wt.insertRecord(d.addDays(5), QTime(9, 0), QTime(17, 0), "custom");
+
+    QVERIFY(wt.fillMissingDays(d.addDays(13), d));
+    QCOMPARE(wt.getRecords(d, d.addDays(13)).size(), 14);
+
+    // Existing records aren't changed
+    QCOMPARE(wt.getRecord(d.addDays(2)).checkIn, QTime(9, 0));
+    QCOMPARE(wt.getRecord(d.addDays(5)).checkIn, QTime(9, 0));
+
+    // Missing days get the schedule of the previous record or the default one
+    for (int i : {0, 1, 3, 4, 13})
+    {
+        auto r = wt.getRecord(d.addDays(i));
+        auto name = i < 5 ? wt.defaultSchedule().name : QString("custom");
+        QCOMPARE(r.schedule->name, name);
+        QCOMPARE(r.checkIn, r.schedule->begin);
+        QCOMPARE(r.checkOut, r.schedule->end);
+    }
+
+    // Only working days
+    auto weekdays = [](const QDate& date) { return date.dayOfWeek() <= 5; };
+    QVERIFY(wt.fillMissingDays(d.addDays(14), d.addDays(27), weekdays));
+    QCOMPARE(wt.getRecords(d.addDays(14), d.addDays(27)).size(), 10);
+    QVERIFY(!wt.getRecord(d.addDays(19)).isValid());
+
+    // Assigned schedule wins over the one of the previous record
+    QVERIFY(wt.insertRecord(d.addDays(34), QTime(8, 0), QTime(17, 0)));
+    QVERIFY(wt.setSchedule(wt.defaultSchedule().name, d.addDays(30), d.addDays(34)));
+    QVERIFY(wt.fillMissingDays(d.addDays(28), d.addDays(33)));
+    QCOMPARE(wt.getRecord(d.addDays(29)).schedule->name, QString("custom"));
+    QCOMPARE(wt.getRecord(d.addDays(30)).schedule->name, wt.defaultSchedule().name);
+    QCOMPARE(wt.getRecord(d.addDays(30)).checkIn, QTime(8, 0));
+
+    // Nothing to fill
+    QVERIFY(wt.fillMissingDays(d, d.addDays(13)));
+    QVERIFY(!wt.fillMissingDays(QDate(), d));
+
+    // Days of closed months are skipped
+    QVERIFY(wt.closeMonth(3, 2022));
+    QVERIFY(wt.fillMissingDays(QDate(2022, 02, 28), QDate(2022, 04, 01)));
+    QVERIFY(wt.getRecord(QDate(2022, 02, 28)).isValid());
+    QVERIFY(!wt.getRecord(QDate(2022, 03, 01)).isValid());
+    QVERIFY(wt.getRecord(QDate(2022, 04, 01)).isValid());
+
+    clear(&db);
+}
+
+void TestWorktimeTracker::aggregatePunches()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    auto d = QDate(2022, 1, 10);
+    auto punch = [&wt](const QDate& date, int hour, int minute, WorktimeTracker::PunchKind kind) {
+        return wt.addPunch(QDateTime(date, QTime(hour, minute)), kind, "gate");
+    };
+    using Kind = WorktimeTracker::PunchKind;
+
+    QVERIFY(punch(d, 8, 50, Kind::In));
+    QVERIFY(punch(d, 12, 0, Kind::Out));
+    QVERIFY(punch(d, 12, 45, Kind::In));
+    QVERIFY(punch(d, 17, 30, Kind::Out));
+    QVERIFY(!wt.addPunch(QDateTime(), Kind::In));
+
+    // Punches don't change records until they're aggregated
+    QVERIFY(!wt.getRecord(d).isValid());
+    QCOMPARE(wt.punchHighWaterMark(), qint64(0));
+
+    QCOMPARE(wt.aggregatePunches(), 4);
+    QCOMPARE(wt.punchHighWaterMark(), qint64(4));
+    QCOMPARE(wt.aggregatePunches(), 0);
+
+    auto r = wt.getRecord(d);
+    QCOMPARE(r.checkIn, QTime(8, 50));
+    QCOMPARE(r.checkOut, QTime(17, 30));
+
+    auto lp = wt.getLeavePassList(d);
+    QCOMPARE(lp.size(), 1);
+    QCOMPARE(lp[0].from, QTime(12, 0));
+    QCOMPARE(lp[0].to, QTime(12, 45));
+    QCOMPARE(lp[0].comment, QString(WorktimeTracker::PUNCH_COMMENT));
+
+    // 50 minutes late, 45 minutes of the leave pass and 30 minutes of overtime
+    QCOMPARE(wt.getSummary(d).seconds, qint64(-65 * 60));
+
+    // Late punches make the day to be computed again, leave passes
+    // made by hand are kept and gaps are clipped to the schedule
+    QVERIFY(wt.insertLeavePass(QTime(15, 0), QTime(15, 10), d, "doctor"));
+    QVERIFY(punch(d, 16, 30, Kind::Out));
+    QVERIFY(punch(d, 17, 10, Kind::In));
+
+    QCOMPARE(wt.aggregatePunches(), 2);
+    QCOMPARE(wt.punchHighWaterMark(), qint64(6));
+
+    lp = wt.getLeavePassList(d);
+    QCOMPARE(lp.size(), 3);
+
+    QStringList passes;
+    for (const auto& pass : lp)
+        passes.append(pass.from.toString("hh:mm") + "-" + pass.to.toString("hh:mm") + " " + pass.comment);
+    passes.sort();
+    QCOMPARE(passes, QStringList({"12:00-12:45 punch", "15:00-15:10 doctor", "16:30-17:00 punch"}));
+    QCOMPARE(wt.getRecord(d).checkOut, QTime(17, 30));
+    QCOMPARE(wt.getSummary(d).seconds, qint64(-105 * 60));
+
+    // Still at work, check out is the end of the schedule
+    QVERIFY(punch(d.addDays(1), 9, 10, Kind::In));
+    QCOMPARE(wt.aggregatePunches(), 1);
+    QCOMPARE(wt.getRecord(d.addDays(1)).checkIn, QTime(9, 10));
+    QCOMPARE(wt.getRecord(d.addDays(1)).checkOut, QTime(17, 0));
+
+    QVERIFY(punch(d.addDays(1), 18, 0, Kind::Out));
+    QCOMPARE(wt.aggregatePunches(), 1);
+    QCOMPARE(wt.getRecord(d.addDays(1)).checkIn, QTime(9, 10));
+    QCOMPARE(wt.getRecord(d.addDays(1)).checkOut, QTime(18, 0));
+
+    // Back at work after an aggregated check out
+    QVERIFY(punch(d.addDays(3), 8, 0, Kind::In));
+    QVERIFY(punch(d.addDays(3), 12, 0, Kind::Out));
+    QCOMPARE(wt.aggregatePunches(), 2);
+    QCOMPARE(wt.getRecord(d.addDays(3)).checkOut, QTime(12, 0));
+
+    QVERIFY(punch(d.addDays(3), 13, 0, Kind::In));
+    QCOMPARE(wt.aggregatePunches(), 1);
+    QCOMPARE(wt.getRecord(d.addDays(3)).checkOut, QTime(17, 0));
+    QCOMPARE(wt.getSummary(d.addDays(3)).seconds, qint64(-60 * 60));
+
+    // Leave pass made by hand is kept whatever its comment is
+    QVERIFY(wt.insertLeavePass(QTime(14, 0), QTime(14, 30), d.addDays(3), WorktimeTracker::PUNCH_COMMENT));
+    QVERIFY(punch(d.addDays(3), 17, 0, Kind::Out));
+    QCOMPARE(wt.aggregatePunches(), 1);
+    QCOMPARE(wt.getLeavePassList(d.addDays(3)).size(), 2);
+
+    // Punches of several employees are aggregated at once
+    wt.setEmployee(1);
+    QVERIFY(punch(d, 7, 0, Kind::In));
+    wt.setEmployee(0);
+    QVERIFY(punch(d.addDays(2), 8, 0, Kind::In));
+    QCOMPARE(wt.aggregatePunches(), 2);
+    QVERIFY(wt.getRecord(d.addDays(2)).isValid());
+    wt.setEmployee(1);
+    QCOMPARE(wt.getRecord(d).checkIn, QTime(7, 0));
+    QCOMPARE(wt.getRecord(d).checkOut, QTime(17, 0));
+
+    // Days of closed months are skipped until the month is reopened
+    QVERIFY(wt.closeMonth(12, 2021));
+    QVERIFY(punch(QDate(2021, 12, 20), 8, 0, Kind::In));
+    QCOMPARE(wt.aggregatePunches(), 1);
+    QVERIFY(!wt.getRecord(QDate(2021, 12, 20)).isValid());
+    QCOMPARE(wt.aggregatePunches(), 0);
+    QVERIFY(!wt.getRecord(QDate(2021, 12, 20)).isValid());
+
+    QVERIFY(wt.reopenMonth(12, 2021));
+    QCOMPARE(wt.aggregatePunches(), 0);
+    QCOMPARE(wt.getRecord(QDate(2021, 12, 20)).checkIn, QTime(8, 0));
+    QVERIFY(wt.closeMonth(12, 2021));
+    QCOMPARE(wt.aggregatePunches(), 0);
 
     clear(&db);
 }
@@ -89,13 +268,13 @@ void TestWorktimeTracker::getRecord()
 
     QVERIFY(r1.isValid());
     QCOMPARE(r1.date, QDate(1996, 11, 26));
-    QCOMPARE(r1.schedule.name, wt.defaultSchedule().name);
+    QCOMPARE(r1.schedule->name, wt.defaultSchedule().name);
     QCOMPARE(r1.checkIn, wt.defaultSchedule().begin);
     QCOMPARE(r1.checkOut, wt.defaultSchedule().end);
 
     QVERIFY(r2.isValid());
     QCOMPARE(r2.date, QDate(1996, 11, 29));
-    QCOMPARE(r2.schedule.name, wt.defaultSchedule().name);
+    QCOMPARE(r2.schedule->name, wt.defaultSchedule().name);
     QCOMPARE(r2.checkIn, wt.defaultSchedule().begin);
     QCOMPARE(r2.checkOut, wt.defaultSchedule().end);
 
@@ -143,6 +322,139 @@ void TestWorktimeTracker::getRecords()
     QVERIFY(r7.isEmpty());
 }
 
+void TestWorktimeTracker::getRecordPage()
+{
+    QSqlDatabase db = createDb();
+    auto wt = example(db);
+
+    auto all = wt.getRecords(QDate(2022, 01, 01), QDate(2022, 12, 31));
+    QCOMPARE(all.size(), 61);
+
+    // Walk all pages in both directions
+    for (auto direction : {WorktimeTracker::PageDirection::Forward, WorktimeTracker::PageDirection::Backward})
+    {
+        QList<WorktimeTracker::Record> records;
+        QDate cursor;
+        int pages = 0;
+
+        do {
+            auto page = wt.getRecordPage(cursor, 7, direction, &cursor);
+            QVERIFY(page.size() <= 7);
+            QVERIFY(!page.isEmpty());
+
+            if (direction == WorktimeTracker::PageDirection::Forward)
+                records.append(page);
+            else
+                records = page + records;
+            ++pages;
+        } while (cursor.isValid());
+
+        QCOMPARE(pages, 9);
+        QCOMPARE(records.size(), all.size());
+        for (int i = 0; i < records.size(); ++i)
+        {
+            QCOMPARE(records[i].date, all[i].date);
+            QCOMPARE(records[i].checkIn, all[i].checkIn);
+            QCOMPARE(records[i].schedule->name, all[i].schedule->name);
+        }
+    }
+
+    // Page after a date without record
+    QDate next;
+    auto page = wt.getRecordPage(QDate(2022, 01, 01), 3, WorktimeTracker::PageDirection::Forward, &next);
+    QCOMPARE(page.first().date, QDate(2022, 01, 18));
+    QCOMPARE(next, QDate(2022, 01, 20));
+
+    page = wt.getRecordPage(QDate(2022, 01, 20), 3, WorktimeTracker::PageDirection::Backward, &next);
+    QCOMPARE(page.size(), 2);
+    QVERIFY(!next.isValid());
+
+    // Last page is exactly full
+    page = wt.getRecordPage(QDate(2022, 03, 16), 3, WorktimeTracker::PageDirection::Forward, &next);
+    QCOMPARE(page.size(), 3);
+    QVERIFY(!next.isValid());
+
+    QVERIFY(wt.getRecordPage(QDate(), 0).isEmpty());
+
+    clear(&db);
+}
+
+void TestWorktimeTracker::getCompactRecords()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    wt.insertSchedule("test", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0));
+
+    auto d = QDate(1996, 11, 26);
+
+    wt.insertRecord(d, QTime(8, 15, 30), QTime(17, 45, 59));
+    wt.insertRecord(d.addDays(1), QTime(0, 0), QTime(23, 59, 59), "test");
+    wt.insertRecord(d.addDays(3));
+
+    auto records = wt.getRecords(QDate(1996, 11, 20), QDate(1996, 12, 31));
+    auto compact = wt.getCompactRecords(QDate(1996, 12, 31), QDate(1996, 11, 20));
+
+    QCOMPARE(compact.size(), 3);
+    for (int i = 0; i < compact.size(); ++i)
+    {
+        QVERIFY(compact[i].isValid());
+
+        // Conversion must be lossless in both directions
+        auto r = wt.toRecord(compact[i]);
+        QVERIFY(r.isValid());
+        QCOMPARE(r.date, records[i].date);
+        QCOMPARE(r.schedule.id(), records[i].schedule.id());
+        QCOMPARE(r.checkIn, records[i].checkIn);
+        QCOMPARE(r.checkOut, records[i].checkOut);
+
+        auto c = WorktimeTracker::CompactRecord::fromRecord(records[i]);
+        QCOMPARE(c.day, compact[i].day);
+        QCOMPARE(c.scheduleId(), compact[i].scheduleId());
+        QCOMPARE(c.checkIn, compact[i].checkIn);
+        QCOMPARE(c.checkOut, compact[i].checkOut);
+    }
+
+    QCOMPARE(wt.toRecord(compact[1]).schedule->name, QString("test"));
+    QCOMPARE(compact[2].date(), d.addDays(3));
+
+    // Invalid record
+    auto invalid = WorktimeTracker::CompactRecord::fromRecord(WorktimeTracker::Record());
+    QVERIFY(!invalid.isValid());
+    QVERIFY(!invalid.date().isValid());
+    QVERIFY(!invalid.checkInTime().isValid());
+    QVERIFY(!wt.toRecord(invalid).isValid());
+
+    // Schedule ids take both halves of the bit fields
+    QSqlQuery q(db);
+    QVERIFY(q.exec("INSERT INTO schedule (Id, Name, Begin, End, LunchTimeBegin, LunchTimeEnd) "
+                   "VALUES(40000, 'big', '09:00:00', '17:00:00', '12:00:00', '13:00:00')"));
+    WorktimeTracker::Record big;
+    big.date     = d.addDays(10);
+    big.schedule = wt.scheduleRef(40000);
+    big.checkIn  = QTime(9, 0);
+    big.checkOut = QTime(17, 0);
+    QVERIFY(big.schedule.isValid());
+    QCOMPARE(WorktimeTracker::CompactRecord::fromRecord(big).scheduleId(), 40000);
+    QVERIFY(wt.insertRecord(big.date, big.checkIn, big.checkOut, "big"));
+    QCOMPARE(wt.getRecord(big.date).schedule->name, QString("big"));
+    QCOMPARE(wt.getCompactRecords(big.date, big.date)[0].scheduleId(), 40000);
+
+    // Schedule id which doesn't fit is stored as no schedule
+    WorktimeTracker::CompactRecord c = {};
+    c.setScheduleId(WorktimeTracker::CompactRecord::MAX_SCHEDULE_ID);
+    QCOMPARE(c.scheduleId(), WorktimeTracker::CompactRecord::MAX_SCHEDULE_ID);
+    c.setScheduleId(WorktimeTracker::CompactRecord::MAX_SCHEDULE_ID + 1);
+    QCOMPARE(c.scheduleId(), 0);
+    c.setScheduleId(-1);
+    QCOMPARE(c.scheduleId(), 0);
+
+    QVERIFY(wt.getCompactRecords(QDate(2000, 01, 01), QDate(3000, 01, 01)).isEmpty());
+    QVERIFY(wt.getCompactRecords(QDate(), QDate(3000, 01, 01)).isEmpty());
+
+    clear(&db);
+}
+
 void TestWorktimeTracker::insertRecord()
 {
     QSqlDatabase db = createDb();
@@ -165,25 +477,59 @@ void TestWorktimeTracker::insertRecord()
 
     q.next();
     QCOMPARE(q.value(0).toDate(), QDate(1996, 11, 26));
-    QCOMPARE(q.value(1).toString(), wt.defaultSchedule().name);
+    QCOMPARE(q.value(1).toInt(), wt.defaultSchedule().id);
     QCOMPARE(q.value(2).toTime(), wt.defaultSchedule().begin);
     QCOMPARE(q.value(3).toTime(), wt.defaultSchedule().end);
 
     q.next();
     QCOMPARE(q.value(0).toDate(), QDate(2222, 01, 01));
-    QCOMPARE(q.value(1).toString(), wt.defaultSchedule().name);
+    QCOMPARE(q.value(1).toInt(), wt.defaultSchedule().id);
     QCOMPARE(q.value(2).toTime(), QTime(10, 0));
     QCOMPARE(q.value(3).toTime(), QTime(15, 0));
 
     q.next();
     QCOMPARE(q.value(0).toDate(), QDate(2222, 01, 02));
-    QCOMPARE(q.value(1).toString(), "test");
+    QCOMPARE(q.value(1).toInt(), wt.getSchedule("test").id);
     QCOMPARE(q.value(2).toTime(), QTime(10, 0));
     QCOMPARE(q.value(3).toTime(), QTime(15, 0));
 
     clear(&db);
 }
 
+void TestWorktimeTracker::insertRecords()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    wt.insertSchedule("test", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0));
+    wt.insertRecord(QDate(1996, 11, 30));
+
+    auto def = wt.scheduleRef(wt.defaultSchedule().name);
+    auto test = wt.scheduleRef("test");
+    auto unknown = wt.scheduleRef("tt");
+
+    QList<WorktimeTracker::Record> records = {
+        { QDate(1996, 11, 26), def, QTime(8, 0), QTime(17, 0) },
+        { QDate(1996, 11, 27), test, QTime(10, 0), QTime(12, 0) },
+        { QDate(), def, QTime(8, 0), QTime(17, 0) },                    // Error: Invalid date
+        { QDate(1996, 11, 28), def, QTime(17, 0), QTime(8, 0) },        // Error: begin > end
+        { QDate(1996, 11, 28), unknown, QTime(8, 0), QTime(17, 0) },    // Error: Invalid schedule
+        { QDate(1996, 11, 30), def, QTime(8, 0), QTime(17, 0) },        // Error: Already in table
+        { QDate(1996, 11, 29), def, QTime(9, 0), QTime(17, 0) }
+    };
+
+    QList<int> rejected;
+    QVERIFY(wt.insertRecords(records, &rejected));
+    QCOMPARE(rejected, QList<int>({2, 3, 4, 5}));
+
+    QCOMPARE(wt.getRecords(QDate(1996, 11, 26), QDate(1996, 11, 30)).size(), 4);
+    QCOMPARE(wt.getRecord(QDate(1996, 11, 27)).schedule->name, QString("test"));
+    QCOMPARE(wt.getRecord(QDate(1996, 11, 29)).checkIn, QTime(9, 0));
+    QVERIFY(!wt.getRecord(QDate(1996, 11, 28)).isValid());
+
+    clear(&db);
+}
+
 void TestWorktimeTracker::getScheduleBeforeDate()
 {
     QSqlDatabase db = createDb();
@@ -225,6 +571,36 @@ void TestWorktimeTracker::getSchedule()
     auto sch3 = wt.getSchedule("abcdefgh");
     QVERIFY(!sch3.isValid());
 
+    // Lookup by id
+    auto sch4 = wt.getSchedule(sch1.id);
+    QCOMPARE(sch4.name, "test");
+    QCOMPARE(sch4.begin, QTime(10, 0));
+    QVERIFY(!wt.getSchedule(0).isValid());
+    QVERIFY(!wt.getSchedule(100).isValid());
+
+    // Handles into interned schedule table
+    auto ref = wt.scheduleRef("test");
+    QVERIFY(ref.isValid());
+    QCOMPARE(ref.id(), sch1.id);
+    QCOMPARE(ref->name, "test");
+    QCOMPARE((*ref).end, QTime(12, 0));
+    QVERIFY(!wt.scheduleRef("abcdefgh").isValid());
+    QVERIFY(!wt.scheduleRef("abcdefgh")->isValid());
+
+    // Schedule inserted by another tracker is read from the database
+    WorktimeTracker other(db);
+    QVERIFY(other.insertSchedule("other", QTime(7, 0), QTime(15, 0), QTime(11, 0), QTime(12, 0)));
+
+    auto sch5 = wt.getSchedule("other");
+    QVERIFY(sch5.isValid());
+    QCOMPARE(sch5.begin, QTime(7, 0));
+    QCOMPARE(wt.getSchedule(sch5.id).name, "other");
+    QCOMPARE(ref->name, "test");
+
+    QDate date(2020, 3, 2);
+    QVERIFY(wt.insertRecord(date, QTime(7, 0), QTime(15, 0), "other"));
+    QCOMPARE(wt.getRecord(date).schedule->name, "other");
+
     clear(&db);
 }
 
@@ -245,10 +621,82 @@ void TestWorktimeTracker::setSchedule()
     for (int i = 0; i < 4; ++i)
         records.append(wt.getRecord(QDate::currentDate().addDays(i)));
 
-    QCOMPARE(records[0].schedule.name, "test");
-    QCOMPARE(records[1].schedule.name, "test");
-    QCOMPARE(records[2].schedule.name, "test");
-    QCOMPARE(records[3].schedule.name, wt.defaultSchedule().name);
+    QCOMPARE(records[0].schedule->name, "test");
+    QCOMPARE(records[1].schedule->name, "test");
+    QCOMPARE(records[2].schedule->name, "test");
+    QCOMPARE(records[3].schedule->name, wt.defaultSchedule().name);
+
+    clear(&db);
+}
+
+void TestWorktimeTracker::setSchedule_ranges()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    wt.insertSchedule("a", QTime(9, 0), QTime(18, 0), QTime(12, 0), QTime(13, 0));
+    wt.insertSchedule("b", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0));
+
+    auto d = QDate(2022, 01, 10);
+    for (int i = 0; i < 10; ++i)
+        wt.insertRecord(d.addDays(i));
+
+    auto schedules = [&](int days) {
+        QStringList names;
+        for (int i = 0; i < days; ++i)
+            names.append(wt.getRecord(d.addDays(i)).schedule->name);
+        return names.join(",");
+    };
+    auto assignments = [&db]() {
+        QSqlQuery q("SELECT Begin, End FROM scheduleassignment ORDER BY Begin", db);
+        QStringList list;
+        while (q.next())
+            list.append(q.value(0).toString() + " " + q.value(1).toString());
+        return list;
+    };
+
+    // Assignment is split by the one inside it
+    QVERIFY(wt.setSchedule("a", d, d.addDays(9)));
+    QVERIFY(wt.setSchedule("b", d.addDays(5), d.addDays(3)));
+    QCOMPARE(schedules(10), QString("a,a,a,b,b,b,a,a,a,a"));
+    QCOMPARE(assignments().size(), 3);
+
+    // and merged back with adjacent ones of the same schedule
+    QVERIFY(wt.setSchedule("a", d.addDays(3), d.addDays(5)));
+    QCOMPARE(assignments(), QStringList({"2022-01-10 2022-01-19"}));
+
+    QVERIFY(wt.setSchedule("b", d.addDays(8), d.addDays(12)));
+    QCOMPARE(assignments(), QStringList({"2022-01-10 2022-01-17", "2022-01-18 2022-01-22"}));
+    QCOMPARE(wt.getScheduleBeforeDate(d.addDays(8)).name, QString("a"));
+    QCOMPARE(wt.getScheduleBeforeDate(d.addDays(9)).name, QString("b"));
+
+    // Records inserted later get the assigned schedule unless it's given explicitly
+    QVERIFY(wt.insertRecord(d.addDays(10)));
+    QVERIFY(wt.insertRecord(d.addDays(11), QTime(8, 0), QTime(17, 0)));
+    QVERIFY(wt.insertRecord(d.addDays(13), QTime(8, 0), QTime(17, 0)));
+    QCOMPARE(schedules(14), QString("a,a,a,a,a,a,a,a,b,b,b,default,,default"));
+    QCOMPARE(wt.getSummary(d.addDays(11)).seconds, qint64(0));
+    QCOMPARE(wt.getAssignedSchedule(d.addDays(12)).name, QString("b"));
+    QCOMPARE(wt.getAssignedSchedule(d.addDays(11)).name, wt.defaultSchedule().name);
+
+    // Assigned schedule wins over the one of the previous record
+    QVERIFY(wt.insertRecord(d.addDays(12)));
+    QCOMPARE(wt.getRecord(d.addDays(12)).schedule->name, QString("b"));
+    QCOMPARE(wt.getRecord(d.addDays(12)).checkIn, QTime(10, 0));
+
+    // Schedule is assigned ahead for days without records
+    QVERIFY(wt.setSchedule("a", d.addDays(20), d.addDays(25)));
+    QCOMPARE(wt.getAssignedSchedule(d.addDays(20)).name, QString("a"));
+    QVERIFY(wt.insertRecord(d.addDays(22)));
+    QCOMPARE(wt.getRecord(d.addDays(22)).schedule->name, QString("a"));
+    QCOMPARE(wt.getScheduleForDate(d.addDays(25)).name, QString("a"));
+
+    // Assignments belong to an employee
+    wt.setEmployee(1);
+    QVERIFY(wt.insertRecord(d, QTime(8, 0), QTime(17, 0)));
+    QCOMPARE(wt.getRecord(d).schedule->name, wt.defaultSchedule().name);
+
+    QVERIFY(!wt.setSchedule("unknown", d));                 // Error: Unknown schedule
 
     clear(&db);
 }
@@ -348,9 +796,12 @@ void TestWorktimeTracker::insertLeavePass()
 
     QVERIFY(wt.insertLeavePass(QTime(10, 0), QTime(12, 0)));
     // Error: Same leave passes
-//    QVERIFY(!wt.insertLeavePass(QTime(10, 0), QTime(12, 0)));
+    QVERIFY(!wt.insertLeavePass(QTime(10, 0), QTime(12, 0)));
     QVERIFY(wt.insertLeavePass(QTime(11, 0), QTime(11, 30), d));
     QVERIFY(wt.insertLeavePass(QTime(9, 0), QTime(9, 1), d, "abc"));
+    // Error: Overlapping leave passes
+    QVERIFY(!wt.insertLeavePass(QTime(11, 15), QTime(12, 0), d));
+    QVERIFY(!wt.insertLeavePass(QTime(8, 0), QTime(13, 0), d));
     // Error: Invalid time
     QVERIFY(!wt.insertLeavePass(QTime(), QTime(10, 10), d.addDays(2)));
     QVERIFY(!wt.insertLeavePass(QTime(10, 10), QTime(), d.addDays(2)));
@@ -378,6 +829,33 @@ void TestWorktimeTracker::insertLeavePass()
     QCOMPARE(q.value(3).toTime(), QTime(9, 1));
     QCOMPARE(q.value(4).toString(), QString("abc"));
 
+    // Id of a deleted leave pass doesn't produce a duplicate
+    QVERIFY(q.exec("DELETE FROM leavepass WHERE Id = 0 AND Date = '1996-11-26'"));
+    QVERIFY(wt.insertLeavePass(QTime(14, 0), QTime(14, 30), d));
+
+    auto list = wt.getLeavePassList(d);
+    QCOMPARE(list.size(), 2);
+    QCOMPARE(list[1].id, 2);
+    QCOMPARE(list[1].from, QTime(14, 0));
+
+    // Ids are allocated per employee and date
+    wt.setEmployee(1);
+    QVERIFY(wt.insertLeavePass(QTime(14, 0), QTime(14, 30), d));
+    QCOMPARE(wt.getLeavePassList(d).first().id, 0);
+
+    // Error: Leave pass is out of the schedule of the day
+    QVERIFY(wt.insertRecord(d.addDays(3)));
+    QVERIFY(!wt.insertLeavePass(QTime(7, 0), QTime(9, 0), d.addDays(3)));
+    QVERIFY(!wt.insertLeavePass(QTime(16, 0), QTime(17, 1), d.addDays(3)));
+    QVERIFY(wt.insertLeavePass(QTime(8, 0), QTime(17, 0), d.addDays(3)));
+
+    // Touching leave passes don't overlap, changed ones are checked by their new time
+    QVERIFY(wt.insertLeavePass(QTime(14, 30), QTime(15, 0), d));
+    QVERIFY(!wt.insertLeavePass(QTime(14, 45), QTime(15, 15), d));
+    QVERIFY(!wt.insertLeavePass(QTime(14, 15), QTime(14, 20), d));
+    QVERIFY(wt.setLeavePassEnd(QTime(14, 15), d, 0));
+    QVERIFY(wt.insertLeavePass(QTime(14, 15), QTime(14, 20), d));
+
     clear(&db);
 }
 
@@ -409,6 +887,47 @@ void TestWorktimeTracker::getLeavePassList()
     clear(&db);
 }
 
+void TestWorktimeTracker::getLeavePasses()
+{
+    QSqlDatabase db = createDb();
+    auto wt = example(db);
+
+    auto map = wt.getLeavePasses(QDate(2022, 03, 31), QDate(2022, 01, 01));
+
+    QCOMPARE(map.dates, QVector<QDate>({QDate(2022, 01, 19), QDate(2022, 02, 20), QDate(2022, 03, 15)}));
+    QCOMPARE(map.offsets, QVector<int>({0, 3, 4, 5}));
+    QCOMPARE(map.passes.size(), 5);
+
+    // The same as leave passes of each day
+    for (int i = 0; i < map.size(); ++i)
+    {
+        auto list = wt.getLeavePassList(map.dates[i]);
+        QCOMPARE(map.count(i), list.size());
+
+        int j = 0;
+        for (auto lp = map.begin(i); lp != map.end(i); ++lp, ++j)
+        {
+            QCOMPARE(lp->id, list[j].id);
+            QCOMPARE(lp->from, list[j].from);
+            QCOMPARE(lp->comment, list[j].comment);
+        }
+    }
+
+    QCOMPARE(map.indexOf(QDate(2022, 02, 20)), 1);
+    QCOMPARE(map.indexOf(QDate(2022, 02, 21)), -1);
+    QCOMPARE(map.count(-1), 0);
+    QVERIFY(map.begin(-1) == map.end(-1));
+    QCOMPARE(map.value(QDate(2022, 03, 15)).first().comment, QString("lp3"));
+    QVERIFY(map.value(QDate(2022, 03, 16)).isEmpty());
+
+    // Range bounds are inclusive
+    QCOMPARE(wt.getLeavePasses(QDate(2022, 02, 20), QDate(2022, 03, 14)).passes.size(), 1);
+    QCOMPARE(wt.getLeavePasses(QDate(2022, 02, 21), QDate(2022, 03, 14)).size(), 0);
+    QCOMPARE(wt.getLeavePasses(QDate(), QDate(2022, 03, 14)).size(), 0);
+
+    clear(&db);
+}
+
 void TestWorktimeTracker::setLeavePassBegin()
 {
     // TODO: test it with custom schedules
@@ -589,6 +1108,579 @@ void TestWorktimeTracker::getSummary_leavepass()
     clear(&db);
 }
 
+void TestWorktimeTracker::getSummary_cache()
+{
+    QSqlDatabase db = createDb();
+    auto wt = example(db);
+
+    // Fresh tracker without cache gives the expected summaries
+    auto expected = [&db](const QDate& from, const QDate& to) {
+        WorktimeTracker uncached(db);
+        uncached.setSummaryCacheCapacity(0);
+        return uncached.getSummary(from, to).seconds;
+    };
+
+    auto from = QDate(2022, 01, 10);
+    auto to   = QDate(2022, 03, 31);
+    auto d    = QDate(2022, 02, 15);
+
+    auto check = [&]() {
+        QCOMPARE(wt.getSummary(from, to).seconds, expected(from, to));
+        QCOMPARE(wt.getSummary(to, from).seconds, expected(from, to));
+        QCOMPARE(wt.getSummary(2, 2022).seconds, expected(QDate(2022, 02, 01), QDate(2022, 02, 28)));
+        QCOMPARE(wt.getSummary(d).seconds, expected(d, d));
+    };
+
+    for (bool snapshot : {false, true})
+    {
+        wt.setSnapshotEnabled(snapshot);
+        check();
+
+        // Every write invalidates cached ranges it touches
+        wt.setCheckIn(QTime(9, 0), d);
+        check();
+        wt.setCheckOut(QTime(15, 0), d.addDays(1), d.addDays(3));
+        check();
+        wt.insertLeavePass(QTime(13, 0), QTime(14, 0), d);
+        check();
+        wt.setLeavePassEnd(QTime(16, 0), d, 1);
+        check();
+        wt.insertSchedule(QString("custom%1").arg(snapshot), QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0));
+        wt.setSchedule(QString("custom%1").arg(snapshot), d.addDays(-2), d);
+        check();
+        wt.insertRecord(QDate(2022, 03, 31), QTime(8, 0), QTime(18, 0));
+        check();
+
+        // Cache is shared by copies of the tracker
+        auto copy = wt;
+        copy.setCheckIn(QTime(7, 0), d);
+        QCOMPARE(wt.getSummary(from, to).seconds, expected(from, to));
+    }
+
+    // Changes made by someone else need clearing the cache
+    wt.setSnapshotEnabled(false);
+    auto cached = wt.getSummary(from, to).seconds;
+    WorktimeTracker(db).setCheckIn(QTime(12, 0), d);
+    QCOMPARE(wt.getSummary(from, to).seconds, cached);
+    wt.clearSummaryCache();
+    QCOMPARE(wt.getSummary(from, to).seconds, expected(from, to));
+
+    clear(&db);
+}
+
+void TestWorktimeTracker::getSummary_calendar()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    constexpr int hourInSec = 60*60;
+
+    wt.insertSchedule("custom", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0));
+
+    auto d = QDate(2022, 01, 10);    // Monday
+    wt.insertRecord(d, QTime(8, 0), QTime(17, 0));
+    wt.insertRecord(d.addDays(2), QTime(10, 0), QTime(12, 0), "custom");
+    wt.insertRecord(d.addDays(5), QTime(8, 0), QTime(17, 0));
+    wt.insertRecord(d.addDays(20), QTime(10, 0), QTime(12, 0), "custom");
+    QVERIFY(wt.setSchedule("custom", d.addDays(9), d.addDays(20)));
+
+    auto to = d.addDays(13);
+
+    QCOMPARE(wt.getSummary(d, to).seconds, qint64(0));
+    QCOMPARE(wt.getExpectedTime(d, to).seconds, qint64(20 * hourInSec));
+
+    // Missing working days: 1 default, 3-4 custom (previous record), 7-8 default, 9-11 custom (assigned)
+    WorkingCalendar calendar;
+    WorktimeTracker copy = wt;
+    QVERIFY(wt.setWorkingCalendar(calendar));
+    QVERIFY(wt.workingCalendar());
+
+    for (bool snapshot : {false, true})
+    {
+        wt.setSnapshotEnabled(snapshot);
+
+        QCOMPARE(wt.getSummary(d, to).seconds, qint64(-37 * hourInSec));
+        QCOMPARE(wt.getSummary(d.addDays(1)).seconds, qint64(-9 * hourInSec));
+        QCOMPARE(wt.getSummary(d.addDays(5), d.addDays(6)).seconds, qint64(0));
+
+        // Saturday record isn't expected
+        QCOMPARE(wt.getExpectedTime(d, to).seconds, qint64(48 * hourInSec));
+
+        // Bulk summaries count missing working days too
+        auto series = wt.getSummarySeries(d, to, SummaryPeriod::Week);
+        QCOMPARE(series.size(), 2);
+        QCOMPARE(series.first().seconds, qint64(-13 * hourInSec));
+        QCOMPARE(series.last().seconds, qint64(-24 * hourInSec));
+        QCOMPARE(wt.getSummarySeries(d, to, SummaryPeriod::Day)[d.addDays(3)].seconds, qint64(-2 * hourInSec));
+    }
+
+    QCOMPARE(wt.getSummaries({0, 1}, d, to)[0].seconds, qint64(-37 * hourInSec));
+    QCOMPARE(wt.getSummaries({0, 1}, d, to)[1].seconds, qint64(-90 * hourInSec));
+    QCOMPARE(wt.getDayBalances({0}, d, to).size(), 11);
+
+    // Copies share the calendar, other trackers read it from database
+    QVERIFY(copy.workingCalendar());
+    QCOMPARE(copy.getSummary(d, to).seconds, qint64(-37 * hourInSec));
+    {
+        WorktimeTracker other(db);
+        QVERIFY(other.workingCalendar());
+        QCOMPARE(other.getSummary(d, to).seconds, qint64(-37 * hourInSec));
+    }
+
+    calendar.setHoliday(d.addDays(1));
+    QVERIFY(wt.setWorkingCalendar(calendar));
+    QCOMPARE(wt.getSummary(d, to).seconds, qint64(-28 * hourInSec));
+    QCOMPARE(WorktimeTracker(db).getSummary(d, to).seconds, qint64(-28 * hourInSec));
+
+    QVERIFY(wt.clearWorkingCalendar());
+    QCOMPARE(wt.getSummary(d, to).seconds, qint64(0));
+    QVERIFY(!copy.workingCalendar());
+    QVERIFY(!WorktimeTracker(db).workingCalendar());
+
+    // Missing days are planned with the schedule of the last record before them,
+    // so a write before a cached range invalidates it up to the next record
+    QVERIFY(wt.setWorkingCalendar(WorkingCalendar()));
+    QCOMPARE(wt.getSummary(d.addDays(6), d.addDays(8)).seconds, qint64(-18 * hourInSec));
+    QVERIFY(wt.setSchedule("custom", d.addDays(5), d.addDays(5)));
+    QCOMPARE(wt.getSummary(d.addDays(6), d.addDays(8)).seconds, qint64(-4 * hourInSec));
+    QCOMPARE(wt.getSummary(d.addDays(21), d.addDays(22)).seconds, qint64(-4 * hourInSec));
+    QVERIFY(wt.insertRecord(d.addDays(19), QTime(8, 0), QTime(17, 0), "default"));
+    QCOMPARE(wt.getSummary(d.addDays(21), d.addDays(22)).seconds, qint64(-4 * hourInSec));
+    QVERIFY(wt.setSchedule("default", d.addDays(20), d.addDays(20)));
+    QCOMPARE(wt.getSummary(d.addDays(21), d.addDays(22)).seconds, qint64(-18 * hourInSec));
+
+    clear(&db);
+}
+
+void TestWorktimeTracker::closeMonth()
+{
+    QSqlDatabase db = createDb();
+    auto wt = example(db);
+
+    auto from = QDate(2022, 01, 01);
+    auto to   = QDate(2022, 12, 31);
+    auto d    = QDate(2022, 02, 10);
+
+    auto february = wt.getSummary(2, 2022).seconds;
+    auto total    = wt.getSummary(from, to).seconds;
+
+    QVERIFY(wt.closeMonth(2, 2022));
+    QVERIFY(!wt.closeMonth(2, 2022));                   // Error: Already closed
+    QVERIFY(!wt.closeMonth(13, 2022));                  // Error: Invalid month
+    QVERIFY(wt.isClosed(d));
+    QVERIFY(!wt.isClosed(QDate(2022, 03, 01)));
+    QCOMPARE(wt.closedMonths(), QList<QDate>({QDate(2022, 02, 01)}));
+
+    // Writes into closed month are rejected
+    QVERIFY(!wt.setCheckIn(QTime(9, 0), d));
+    QVERIFY(!wt.setCheckOut(QTime(15, 0), QDate(2022, 01, 25), d));
+    QVERIFY(!wt.setSchedule("testschedule1", d));
+    QVERIFY(!wt.insertLeavePass(QTime(13, 0), QTime(14, 0), d));
+    QVERIFY(!wt.setLeavePassBegin(QTime(8, 30), QDate(2022, 02, 20), 0));
+    QVERIFY(!wt.setLeavePassComment("comment", QDate(2022, 02, 20), 0));
+    QCOMPARE(wt.getRecord(QDate(2022, 01, 25)).checkOut, QTime(17, 0));
+
+    QList<int> rejected;
+    QVERIFY(wt.insertRecords({{QDate(2022, 02, 28), wt.scheduleRef("default"), QTime(8, 0), QTime(17, 0)},
+                              {QDate(2022, 04, 10), wt.scheduleRef("default"), QTime(8, 0), QTime(17, 0)}},
+                             &rejected));
+    QCOMPARE(rejected, QList<int>({0}));
+    QVERIFY(wt.setCheckIn(QTime(9, 0), QDate(2022, 04, 10)));
+
+    total = wt.getSummary(from, to).seconds;
+
+    // Balance of closed month is frozen even if the table is changed by someone else
+    QSqlQuery q(db);
+    QVERIFY(q.exec("UPDATE worktime SET CheckIn = '12:00:00' WHERE Date = '2022-02-10'"));
+    wt.clearSummaryCache();
+
+    for (bool snapshot : {false, true})
+    {
+        wt.setSnapshotEnabled(snapshot);
+        wt.refreshSnapshot();
+
+        QCOMPARE(wt.getSummary(2, 2022).seconds, february);
+        QCOMPARE(wt.getSummary(from, to).seconds, total);
+        QCOMPARE(wt.getSummary(d).seconds, qint64(-4 * 60 * 60));      // Partially covered month is computed
+
+        // Series and batched summaries take the frozen balance too
+        auto series = wt.getSummarySeries(from, to, SummaryPeriod::Month);
+        QCOMPARE(series.value(QDate(2022, 02, 01)).seconds, february);
+        QCOMPARE(wt.getSummaries({0}, from, to).value(0).seconds, total);
+        QCOMPARE(wt.getSummarySeries(d, d, SummaryPeriod::Month).value(QDate(2022, 02, 01)).seconds, qint64(-4 * 60 * 60));
+    }
+
+    QVERIFY(wt.reopenMonth(2, 2022));
+    QVERIFY(!wt.reopenMonth(2, 2022));                  // Error: Not closed
+    QVERIFY(!wt.isClosed(d));
+    QCOMPARE(wt.getSummary(2, 2022).seconds, february - 4 * 60 * 60);
+    QVERIFY(wt.setCheckIn(QTime(8, 0), d));
+    QCOMPARE(wt.getSummary(2, 2022).seconds, february);
+
+    // Month with unknown schedule can't be closed
+    QVERIFY(q.exec("UPDATE worktime SET Schedule = 999 WHERE Date = '2022-03-10'"));
+    wt.refreshSnapshot();
+    QVERIFY(!wt.closeMonth(3, 2022));
+
+    clear(&db);
+}
+
+void TestWorktimeTracker::employees()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    auto d = QDate(1996, 11, 26);
+
+    QCOMPARE(wt.employee(), 0);
+    QVERIFY(wt.insertRecord(d, QTime(8, 0), QTime(17, 0)));
+    QVERIFY(wt.insertLeavePass(QTime(10, 0), QTime(11, 0), d, "e0"));
+
+    // The same date for another employee
+    auto wt1 = wt;
+    wt1.setEmployee(1);
+    QCOMPARE(wt1.employee(), 1);
+    QVERIFY(!wt1.getRecord(d).isValid());
+    QVERIFY(wt1.getLeavePassList(d).isEmpty());
+
+    QVERIFY(wt1.insertRecord(d, QTime(9, 0), QTime(17, 0)));
+    QVERIFY(wt1.insertLeavePass(QTime(12, 0), QTime(12, 30), d, "e1"));
+    QVERIFY(!wt1.insertRecord(d, QTime(9, 0), QTime(17, 0))); // Error: Already in table
+
+    QCOMPARE(wt.getRecord(d).checkIn, QTime(8, 0));
+    QCOMPARE(wt1.getRecord(d).checkIn, QTime(9, 0));
+    QCOMPARE(wt.getLeavePassList(d).size(), 1);
+    QCOMPARE(wt.getLeavePassList(d)[0].comment, QString("e0"));
+    QCOMPARE(wt1.getLeavePassList(d).size(), 1);
+    QCOMPARE(wt1.getLeavePassList(d)[0].id, 0);
+    QCOMPARE(wt1.getLeavePassList(d)[0].comment, QString("e1"));
+
+    // Updates don't touch other employees
+    QVERIFY(wt1.setCheckOut(QTime(18, 0), d));
+    QVERIFY(wt1.setLeavePassComment("e1e1", d, 0));
+    QCOMPARE(wt.getRecord(d).checkOut, QTime(17, 0));
+    QCOMPARE(wt.getLeavePassList(d)[0].comment, QString("e0"));
+
+    QCOMPARE(wt.getSummary(d).seconds, -60 * 60);
+    QCOMPARE(wt1.getSummary(d).seconds, -30 * 60);
+    QVERIFY(!wt1.getScheduleBeforeDate(d.addDays(1)).name.isEmpty());
+
+    // Snapshot follows the employee
+    QVERIFY(wt1.setSnapshotEnabled(true));
+    QCOMPARE(wt1.getSummary(d).seconds, -30 * 60);
+    wt1.setEmployee(0);
+    QVERIFY(wt1.isSnapshotEnabled());
+    QCOMPARE(wt1.snapshot()->employee(), 0);
+    QCOMPARE(wt1.getSummary(d).seconds, -60 * 60);
+
+    clear(&db);
+}
+
+void TestWorktimeTracker::getSummaries()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+
+    wt.insertSchedule("custom", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0));
+
+    auto d = QDate(2022, 01, 18);
+
+    for (int employee = 1; employee <= 5; ++employee)
+    {
+        wt.setEmployee(employee);
+
+        for (int i = 0; i < 20; ++i)
+            wt.insertRecord(d.addDays(i), QTime(8, 0).addSecs(employee * 60 * i), QTime(17, 0).addSecs(-60 * i));
+
+        wt.setSchedule("custom", d.addDays(employee), d.addDays(employee + 2));
+        wt.insertLeavePass(QTime(10, 0), QTime(10, 15 + employee), d.addDays(employee));
+        wt.insertLeavePass(QTime(10, 10), QTime(10, 40), d.addDays(employee));
+        wt.insertLeavePass(QTime(15, 0), QTime(14, 0), d.addDays(2 * employee));
+    }
+
+    // Leave pass without a record is ignored
+    wt.insertLeavePass(QTime(9, 0), QTime(10, 0), d.addDays(-1));
+
+    // Every summary has to be the same as the one from getSummary()
+    QList<QPair<QDate, QDate>> ranges = {
+        { d, d.addDays(19) },
+        { d.addDays(3), d.addDays(7) },
+        { d.addDays(10), d.addDays(-10) },
+        { d.addDays(4), QDate() }
+    };
+
+    for (auto range : ranges)
+    {
+        auto summaries = wt.getSummaries({1, 2, 3, 4, 5, 6}, range.first, range.second);
+        QCOMPARE(summaries.size(), 6);
+
+        for (int employee = 1; employee <= 6; ++employee)
+        {
+            wt.setEmployee(employee);
+            QCOMPARE(summaries.value(employee).seconds, wt.getSummary(range.first, range.second).seconds);
+        }
+    }
+
+    QCOMPARE(wt.getSummaries({2, 4}, d, d.addDays(19)).keys(), QList<int>({2, 4}));
+    QVERIFY(wt.getSummaries({}, d, d.addDays(19)).isEmpty());
+    QVERIFY(wt.getSummaries({1}, QDate(), d).isEmpty());
+
+    clear(&db);
+}
+
+void TestWorktimeTracker::getSummarySeries()
+{
+    QSqlDatabase db = createDb();
+    auto wt = example(db);
+
+    wt.insertSchedule("custom", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0));
+    wt.setSchedule("custom", QDate(2022, 02, 7), QDate(2022, 02, 9));
+    wt.setCheckIn(QTime(11, 0), QDate(2022, 02, 8));
+
+    auto from = QDate(2022, 01, 10);
+    auto to   = QDate(2022, 04, 02);
+
+    for (bool snapshot : {false, true})
+    {
+        wt.setSnapshotEnabled(snapshot);
+
+        for (auto period : {SummaryPeriod::Day, SummaryPeriod::Week, SummaryPeriod::Month})
+        {
+            auto series = wt.getSummarySeries(to, from, period);
+
+            // Every period of the range is present, even without records
+            QCOMPARE(series.firstKey(), periodBegin(from, period));
+            QCOMPARE(series.lastKey(), periodBegin(to, period));
+
+            qint64 total = 0;
+            for (auto it = series.constBegin(); it != series.constEnd(); ++it)
+            {
+                auto p = it.key();
+                QCOMPARE(it.value().seconds, wt.getSummary(qMax(p, from), qMin(periodEnd(p, period), to)).seconds);
+                total += it.value().seconds;
+            }
+
+            QCOMPARE(total, wt.getSummary(from, to).seconds);
+        }
+    }
+
+    auto months = wt.getSummarySeries(from, to, SummaryPeriod::Month);
+    QCOMPARE(months.keys(), QList<QDate>({QDate(2022, 01, 01), QDate(2022, 02, 01), QDate(2022, 03, 01), QDate(2022, 04, 01)}));
+    QCOMPARE(months[QDate(2022, 01, 01)].seconds, wt.getSummary(1, 2022).seconds);
+
+    QVERIFY(wt.getSummarySeries(QDate(), to, SummaryPeriod::Day).isEmpty());
+
+    clear(&db);
+}
+
+void TestWorktimeTracker::transaction()
+{
+    QSqlDatabase db = createDb();
+    WorktimeTracker wt(db);
+    wt.setSnapshotEnabled(true);
+
+    auto d = QDate(2022, 1, 10);
+    QVERIFY(!wt.getSummary(d).seconds);
+
+    // Scope which isn't committed is rolled back with cached summaries
+    {
+        WorktimeTracker::Transaction transaction(&wt);
+        QVERIFY(transaction.isActive());
+        QVERIFY(wt.insertRecord(d, QTime(9, 0), QTime(17, 0)));
+        QVERIFY(wt.insertSchedule("custom", QTime(10, 0), QTime(12, 0), QTime(10, 30), QTime(11, 0)));
+        QCOMPARE(wt.getSummary(d).seconds, qint64(-3600));
+    }
+    QVERIFY(!wt.getRecord(d).isValid());
+    QVERIFY(!wt.getSchedule("custom").isValid());
+    QCOMPARE(wt.getSummary(d).seconds, qint64(0));
+
+    {
+        WorktimeTracker::Transaction transaction(&wt);
+        QVERIFY(wt.insertRecord(d, QTime(8, 0), QTime(17, 0)));
+        QVERIFY(wt.insertLeavePass(QTime(10, 0), QTime(11, 0), d));
+
+        // Nested scope rolls back only its own writes
+        {
+            WorktimeTracker::Transaction nested(&wt);
+            QVERIFY(wt.setCheckIn(QTime(9, 0), d));
+            QCOMPARE(wt.getSummary(d).seconds, qint64(-7200));
+            nested.rollback();
+            QVERIFY(!nested.isActive());
+            QVERIFY(!nested.commit());
+        }
+        QCOMPARE(wt.getRecord(d).checkIn, QTime(8, 0));
+        QCOMPARE(wt.getSummary(d).seconds, qint64(-3600));
+
+        QVERIFY(transaction.commit());
+        QVERIFY(!transaction.isActive());
+    }
+    QCOMPARE(wt.getRecord(d).checkIn, QTime(8, 0));
+    QCOMPARE(wt.getLeavePassList(d).size(), 1);
+    QCOMPARE(wt.getSummary(d).seconds, qint64(-3600));
+
+    // Failed write doesn't roll back the outer scope
+    {
+        WorktimeTracker::Transaction transaction(&wt);
+        QVERIFY(wt.setCheckOut(QTime(18, 0), d));
+        QVERIFY(!wt.setCheckIn(QTime(9, 0), d.addDays(1)));
+        QVERIFY(transaction.commit());
+    }
+    QCOMPARE(wt.getSummary(d).seconds, qint64(0));
+
+    clear(&db);
+}
+
+void TestWorktimeTracker::groupCommit()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // Pending writes are seen only by the connection of the tracker
+    auto db = QSqlDatabase::addDatabase("QSQLITE", "group");
+    db.setDatabaseName(dir.filePath("worktime.db"));
+    QVERIFY(db.open());
+
+    auto reader = QSqlDatabase::addDatabase("QSQLITE", "group-reader");
+    reader.setDatabaseName(dir.filePath("worktime.db"));
+    QVERIFY(reader.open());
+
+    auto committed = [&reader]() {
+        QSqlQuery query(reader);
+        query.exec("SELECT COUNT(*) FROM worktime");
+        return query.next() ? query.value(0).toInt() : -1;
+    };
+
+    {
+        WorktimeTracker wt(db);
+        wt.setGroupCommit(3);
+
+        auto d = QDate(2022, 1, 10);
+        QVERIFY(wt.insertRecord(d, QTime(8, 0), QTime(17, 0)));
+        QVERIFY(wt.insertRecord(d.addDays(1), QTime(8, 0), QTime(17, 0)));
+        QVERIFY(wt.getRecord(d).isValid());
+        QCOMPARE(committed(), 0);
+
+        // The third write commits the group
+        QVERIFY(wt.insertRecord(d.addDays(2), QTime(8, 0), QTime(17, 0)));
+        QCOMPARE(committed(), 3);
+
+        QVERIFY(wt.insertRecord(d.addDays(3), QTime(8, 0), QTime(17, 0)));
+        QCOMPARE(committed(), 3);
+
+        // Transaction scope is a part of the group
+        {
+            WorktimeTracker::Transaction transaction(&wt);
+            QVERIFY(wt.insertRecord(d.addDays(4), QTime(8, 0), QTime(17, 0)));
+            QVERIFY(!wt.flushGroupCommit());
+        }
+        QVERIFY(!wt.getRecord(d.addDays(4)).isValid());
+        QVERIFY(wt.flushGroupCommit());
+        QCOMPARE(committed(), 4);
+        QVERIFY(wt.flushGroupCommit());
+
+        QVERIFY(wt.insertRecord(d.addDays(5), QTime(8, 0), QTime(17, 0)));
+        QCOMPARE(committed(), 4);
+        wt.setGroupCommit(0);
+        QCOMPARE(committed(), 5);
+
+        // Without group every write is committed at once
+        QVERIFY(wt.insertRecord(d.addDays(6), QTime(8, 0), QTime(17, 0)));
+        QCOMPARE(committed(), 6);
+
+        // Open group is committed when the tracker is destroyed
+        wt.setGroupCommit(10);
+        QVERIFY(wt.insertRecord(d.addDays(7), QTime(8, 0), QTime(17, 0)));
+        QCOMPARE(committed(), 6);
+
+        // Another tracker of the connection writes into the open group
+        WorktimeTracker other(db);
+        other.setEmployee(1);
+        QVERIFY(other.insertRecord(d, QTime(8, 0), QTime(17, 0)));
+        QCOMPARE(committed(), 6);
+        QVERIFY(other.flushGroupCommit());
+        QCOMPARE(committed(), 8);
+
+        // Group is committed by the timer without further writes
+        wt.setGroupCommit(10, 50);
+        QVERIFY(wt.insertRecord(d.addDays(8), QTime(8, 0), QTime(17, 0)));
+        QCOMPARE(committed(), 8);
+        QTest::qWait(200);
+        QCOMPARE(committed(), 9);
+
+        QVERIFY(wt.insertRecord(d.addDays(9), QTime(8, 0), QTime(17, 0)));
+        QCOMPARE(committed(), 9);
+    }
+    QCOMPARE(committed(), 10);
+
+    reader.close();
+    db.close();
+    reader = QSqlDatabase();
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase("group-reader");
+    QSqlDatabase::removeDatabase("group");
+}
+
+void TestWorktimeTracker::migration()
+{
+    QSqlDatabase db = createDb();
+
+    // Tables of the first version, schedules are referenced by name
+    QSqlQuery query(db);
+    QVERIFY(query.exec("CREATE TABLE schedule (Name TEXT PRIMARY KEY NOT NULL, Begin TEXT, End TEXT, "
+                       "LunchTimeBegin TEXT, LunchTimeEnd TEXT)"));
+    QVERIFY(query.exec("INSERT INTO schedule VALUES ('default', '08:00:00', '17:00:00', '12:00:00', '13:00:00')"));
+    QVERIFY(query.exec("INSERT INTO schedule VALUES ('short', '10:00:00', '14:00:00', '12:00:00', '12:30:00')"));
+    QVERIFY(query.exec("CREATE TABLE worktime (Date TEXT PRIMARY KEY NOT NULL, Schedule TEXT, CheckIn TEXT, CheckOut TEXT)"));
+    QVERIFY(query.exec("INSERT INTO worktime VALUES ('2022-01-10', 'default', '08:00:00', '17:00:00')"));
+    QVERIFY(query.exec("INSERT INTO worktime VALUES ('2022-01-11', 'short', '10:00:00', '15:00:00')"));
+    QVERIFY(query.exec("INSERT INTO worktime VALUES ('2022-01-12', 'removed', '08:00:00', '17:00:00')"));
+    QVERIFY(query.exec("CREATE TABLE leavepass (Date TEXT NOT NULL, Id INT, Begin TEXT, End TEXT, Comment TEXT, "
+                       "PRIMARY KEY (Date, Id))"));
+    QVERIFY(query.exec("INSERT INTO leavepass VALUES ('2022-01-10', 0, '10:00:00', '10:30:00', 'doctor')"));
+
+    WorktimeTracker wt(db);
+    auto d = QDate(2022, 1, 10);
+
+    QCOMPARE(wt.getSchedule("default").id, 1);
+    QCOMPARE(wt.getSchedule("short").id, 2);
+    QCOMPARE(wt.getRecord(d).schedule->name, QString("default"));
+    QCOMPARE(wt.getRecord(d.addDays(1)).schedule->name, QString("short"));
+    QCOMPARE(wt.getSummary(d.addDays(1)).seconds, qint64(60 * 60));
+    QVERIFY(!wt.getRecord(d.addDays(2)).schedule.isValid());
+
+    QVERIFY(query.exec("SELECT COUNT(*) FROM worktime WHERE typeof(Schedule) = 'text'"));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), 0);
+
+    // Data of a single-employee database belongs to employee 0
+    QCOMPARE(wt.getLeavePassList(d).size(), 1);
+    QCOMPARE(wt.getLeavePassList(d)[0].comment, QString("doctor"));
+    QVERIFY(!wt.getLeavePassList(d)[0].generated);
+    QCOMPARE(wt.getSummary(d).seconds, qint64(-30 * 60));
+
+    auto other = wt;
+    other.setEmployee(1);
+    QVERIFY(!other.getRecord(d).isValid());
+    QVERIFY(other.insertRecord(d, QTime(9, 0), QTime(17, 0)));
+    QVERIFY(other.insertLeavePass(QTime(10, 0), QTime(10, 30), d));
+    QCOMPARE(other.getLeavePassList(d)[0].id, 0);
+    QCOMPARE(wt.getRecord(d).checkIn, QTime(8, 0));
+
+    // New schedules and records use the migrated tables
+    QVERIFY(wt.insertSchedule("long", QTime(7, 0), QTime(19, 0), QTime(12, 0), QTime(13, 0)));
+    QCOMPARE(wt.getSchedule("long").id, 3);
+    QVERIFY(wt.insertRecord(d.addDays(3), QTime(7, 0), QTime(19, 0), "long"));
+    QCOMPARE(wt.getRecord(d.addDays(3)).schedule->name, QString("long"));
+
+    // Migrated tables are kept as they are
+    WorktimeTracker again(db);
+    QCOMPARE(again.getRecord(d.addDays(1)).schedule->name, QString("short"));
+    QCOMPARE(again.getRecords(d, d.addDays(3)).size(), 4);
+    QCOMPARE(again.getLeavePassList(d).size(), 1);
+
+    clear(&db);
+}
+
 QSqlDatabase TestWorktimeTracker::createDb() const
 {
     auto db = QSqlDatabase::addDatabase("QSQLITE", ":memory:");
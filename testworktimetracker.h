@@ -16,20 +16,36 @@ public:
 private slots:
     void insertSchedule();
     void insertRecord();
+    void insertRecords();
+    void fillMissingDays();
+    void aggregatePunches();
     void getRecord();
     void getRecords();
+    void getRecordPage();
+    void getCompactRecords();
     void getScheduleBeforeDate();
     void getSchedule();
     void setSchedule();
+    void setSchedule_ranges();
     void setCheckIn();
     void setCheckOut();
     void insertLeavePass();
     void getLeavePassList();
+    void getLeavePasses();
     void setLeavePassBegin();
     void setLeavePassEnd();
     void setLeavePassComment();
     void getSummary();
     void getSummary_leavepass();
+    void getSummary_cache();
+    void getSummary_calendar();
+    void closeMonth();
+    void employees();
+    void getSummaries();
+    void getSummarySeries();
+    void transaction();
+    void groupCommit();
+    void migration();
 
 private:
     QSqlDatabase createDb() const;
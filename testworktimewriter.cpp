@@ -0,0 +1,174 @@
+#include "testworktimewriter.h"
+#include <thread>
+
+void TestWorktimeWriter::commands()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QSqlDatabase db = createDb(dir);
+    WorktimeTracker wt(db);
+
+    auto d = QDate(2022, 1, 10);
+    wt.insertRecord(d, QTime(8, 0), QTime(17, 0));
+    QCOMPARE(wt.getSummary(d).seconds, qint64(0));
+
+    QList<QDate> changed;
+    wt.addChangeListener([&changed](int employee, const QDate& from, const QDate&) {
+        if (employee == 0)
+            changed.append(from);
+    });
+
+    {
+        WorktimeWriter writer(wt);
+
+        auto checkIn  = writer.setCheckIn(0, QTime(9, 0), d);
+        auto checkOut = writer.setCheckOut(0, QTime(18, 30), d);
+        auto pass     = writer.insertLeavePass(0, QTime(12, 0), QTime(13, 0), d);
+        auto record   = writer.insertRecord(0, d.addDays(1), QTime(8, 30), QTime(17, 0));
+        auto missing  = writer.insertRecord(0, d.addDays(2));
+        auto other    = writer.insertRecord(1, d, QTime(7, 0), QTime(17, 0));
+
+        // Rejected commands don't affect the others of the batch
+        auto duplicate = writer.insertRecord(0, d, QTime(8, 0), QTime(17, 0));
+        auto schedule  = writer.insertRecord(0, d.addDays(3), QTime(8, 0), QTime(17, 0), "unknown");
+        auto inverted  = writer.setCheckIn(0, QTime(19, 0), d);
+
+        QVERIFY(checkIn.get());
+        QVERIFY(checkOut.get());
+        QVERIFY(pass.get());
+        QVERIFY(record.get());
+        QVERIFY(missing.get());
+        QVERIFY(other.get());
+        QVERIFY(!duplicate.get());
+        QVERIFY(!schedule.get());
+        QVERIFY(!inverted.get());
+
+        QVERIFY(writer.batches() >= 1);
+    }
+
+    auto r = wt.getRecord(d);
+    QCOMPARE(r.checkIn, QTime(9, 0));
+    QCOMPARE(r.checkOut, QTime(18, 30));
+    QCOMPARE(wt.getLeavePassList(d).size(), 1);
+    QCOMPARE(wt.getRecord(d.addDays(1)).checkIn, QTime(8, 30));
+    QVERIFY(wt.getRecord(d.addDays(2)).isValid());
+    QVERIFY(!wt.getRecord(d.addDays(3)).isValid());
+
+    // Cached summary is invalidated by the writer
+    QCOMPARE(wt.getSummary(d).seconds, qint64(-30 * 60));
+    QVERIFY(changed.contains(d));
+    QVERIFY(changed.contains(d.addDays(2)));
+
+    wt.setEmployee(1);
+    QCOMPARE(wt.getRecord(d).checkIn, QTime(7, 0));
+
+    clear(&db);
+}
+
+void TestWorktimeWriter::producers()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QSqlDatabase db = createDb(dir);
+    WorktimeTracker wt(db);
+
+    constexpr int producerCount = 8;
+    constexpr int dayCount      = 50;
+
+    auto d = QDate(2022, 1, 1);
+    QVector<int> failed(producerCount, 0);
+
+    {
+        WorktimeWriter writer(wt, 64);
+
+        std::vector<std::thread> producers;
+        for (int p = 0; p < producerCount; ++p)
+        {
+            producers.emplace_back([&writer, &failed, d, p]() {
+                std::vector<std::future<bool>> results;
+                for (int i = 0; i < dayCount; ++i) {
+                    // Commands of a producer are applied in order
+                    results.push_back(writer.insertRecord(p, d.addDays(i), QTime(8, 0), QTime(17, 0)));
+                    results.push_back(writer.setCheckIn(p, QTime(8, 0).addSecs(p * 60), d.addDays(i)));
+                }
+                for (auto& result : results)
+                    failed[p] += !result.get();
+            });
+        }
+
+        for (auto& producer : producers)
+            producer.join();
+
+        QVERIFY(writer.batches() >= 1);
+        QVERIFY(writer.batches() <= producerCount * dayCount * 2);
+    }
+
+    for (int p = 0; p < producerCount; ++p)
+    {
+        QCOMPARE(failed[p], 0);
+
+        wt.setEmployee(p);
+        auto records = wt.getRecords(d, d.addDays(dayCount - 1));
+        QCOMPARE(records.size(), dayCount);
+        QCOMPARE(records.last().checkIn, QTime(8, 0).addSecs(p * 60));
+    }
+
+    clear(&db);
+}
+
+void TestWorktimeWriter::state()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QSqlDatabase db = createDb(dir);
+    WorktimeTracker wt(db);
+    QVERIFY(wt.setSnapshotEnabled(true));
+
+    auto d = QDate(2022, 1, 10);
+    wt.insertRecord(d, QTime(8, 0), QTime(17, 0));
+    auto version = wt.state()->version();
+
+    {
+        WorktimeWriter writer(wt);
+
+        // Result of a command comes after its write is published
+        QVERIFY(writer.setCheckIn(0, QTime(9, 0), d).get());
+
+        auto state = wt.state();
+        QVERIFY(state->version() > version);
+        QCOMPARE(state->getRecord(d).checkIn, QTime(9, 0));
+        QCOMPARE(state->getSummary(d).seconds, qint64(-3600));
+
+        // Writes of other employees don't change the state
+        version = state->version();
+        QVERIFY(writer.insertRecord(1, d, QTime(8, 0), QTime(17, 0)).get());
+        QCOMPARE(wt.state()->version(), version);
+    }
+
+    // Snapshot of the tracker reloads the notified range
+    QCOMPARE(wt.snapshot()->checkIns().first(), 9 * 3600);
+    QCOMPARE(wt.getSummary(d).seconds, qint64(-3600));
+
+    QVERIFY(wt.insertRecord(d.addDays(1), QTime(8, 0), QTime(17, 0)));
+    QCOMPARE(wt.state()->getRecord(d).checkIn, QTime(9, 0));
+
+    clear(&db);
+}
+
+QSqlDatabase TestWorktimeWriter::createDb(const QTemporaryDir& dir) const
+{
+    // Writer needs a database shared by connections
+    auto db = QSqlDatabase::addDatabase("QSQLITE", "writer");
+    db.setDatabaseName(dir.filePath("worktime.db"));
+    db.open();
+    return db;
+}
+
+void TestWorktimeWriter::clear(QSqlDatabase *db)
+{
+    db->close();
+    QSqlDatabase::removeDatabase("writer");
+}
@@ -0,0 +1,25 @@
+#ifndef TESTWORKTIMEWRITER_H
+#define TESTWORKTIMEWRITER_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QTemporaryDir>
+#include <QtTest/QTest>
+#include "worktimewriter.h"
+#include "worktimestate.h"
+
+class TestWorktimeWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void commands();
+    void producers();
+    void state();
+
+private:
+    QSqlDatabase createDb(const QTemporaryDir& dir) const;
+    void clear(QSqlDatabase* db);
+};
+
+#endif // TESTWORKTIMEWRITER_H
@@ -0,0 +1,168 @@
+#include "workingcalendar.h"
+#include <QtAlgorithms>
+#include <QStringList>
+#include <algorithm>
+
+constexpr int WorkingCalendar::WEEKDAYS;
+constexpr int WorkingCalendar::ALL_DAYS;
+constexpr int WorkingCalendar::WORDS;
+
+WorkingCalendar::WorkingCalendar(int workingWeekDays)
+    : m_workingWeekDays(workingWeekDays & ALL_DAYS)
+{
+
+}
+
+int WorkingCalendar::workingWeekDays() const
+{
+    return m_workingWeekDays;
+}
+
+bool WorkingCalendar::isWorkingDay(const QDate &date) const
+{
+    if (!date.isValid())
+        return false;
+
+    auto it = m_years.constFind(date.year());
+    if (it == m_years.constEnd())
+        return m_workingWeekDays & (1 << (date.dayOfWeek() - 1));
+
+    int day = date.dayOfYear() - 1;
+    return it->words[day / 64] & (quint64(1) << (day % 64));
+}
+
+void WorkingCalendar::setWorkingDay(const QDate &date, bool working)
+{
+    if (!date.isValid())
+        return;
+
+    auto it = m_years.find(date.year());
+    if (it == m_years.end())
+        it = m_years.insert(date.year(), year(date.year()));
+
+    int day = date.dayOfYear() - 1;
+    if (working)
+        it->words[day / 64] |= quint64(1) << (day % 64);
+    else
+        it->words[day / 64] &= ~(quint64(1) << (day % 64));
+}
+
+void WorkingCalendar::setHoliday(const QDate &date)
+{
+    setWorkingDay(date, false);
+}
+
+int WorkingCalendar::workingDays(const QDate &from, const QDate &to) const
+{
+    if (!from.isValid() || !to.isValid())
+        return 0;
+
+    QDate _from = qMin(from, to);
+    QDate _to   = qMax(from, to);
+
+    int count = 0;
+
+    for (int y = _from.year(); y <= _to.year(); ++y)
+    {
+        // There is no year 0
+        if (y == 0)
+            continue;
+
+        auto bits  = year(y);
+        int  first = y == _from.year() ? _from.dayOfYear() - 1 : 0;
+        int  last  = y == _to.year() ? _to.dayOfYear() - 1 : QDate(y, 12, 31).dayOfYear() - 1;
+
+        for (int w = first / 64; w <= last / 64; ++w)
+        {
+            quint64 word = bits.words[w];
+            if (w == first / 64)
+                word &= ~quint64(0) << (first % 64);
+            if (w == last / 64)
+                word &= ~quint64(0) >> (63 - last % 64);
+
+            count += qPopulationCount(word);
+        }
+    }
+
+    return count;
+}
+
+QString WorkingCalendar::toString() const
+{
+    QString str = QString::number(m_workingWeekDays);
+
+    auto years = m_years.keys();
+    std::sort(years.begin(), years.end());
+
+    for (int y : years)
+    {
+        const auto& bits = m_years[y];
+        int days = QDate(y, 1, 1).daysInYear();
+
+        str += ";" + QString::number(y) + ":";
+        for (int day = 0; day < days; ++day)
+            str += bits.words[day / 64] & (quint64(1) << (day % 64)) ? '1' : '0';
+    }
+
+    return str;
+}
+
+WorkingCalendar WorkingCalendar::fromString(const QString &str, bool *ok)
+{
+    if (ok)
+        *ok = false;
+
+    auto parts = str.split(';');
+
+    bool valid;
+    int weekDays = parts[0].toInt(&valid);
+    if (!valid || weekDays < 0 || weekDays > ALL_DAYS)
+        return WorkingCalendar();
+
+    WorkingCalendar calendar(weekDays);
+
+    for (int i = 1; i < parts.size(); ++i)
+    {
+        int colon = parts[i].indexOf(':');
+        int y     = parts[i].left(colon).toInt(&valid);
+        auto days = parts[i].mid(colon + 1);
+
+        if (colon < 0 || !valid || y == 0 || !QDate(y, 1, 1).isValid() || days.size() != QDate(y, 1, 1).daysInYear())
+            return WorkingCalendar();
+
+        Year bits = {};
+        for (int day = 0; day < days.size(); ++day)
+        {
+            if (days[day] == '1')
+                bits.words[day / 64] |= quint64(1) << (day % 64);
+            else if (days[day] != '0')
+                return WorkingCalendar();
+        }
+
+        calendar.m_years.insert(y, bits);
+    }
+
+    if (ok)
+        *ok = true;
+
+    return calendar;
+}
+
+WorkingCalendar::Year WorkingCalendar::year(int year) const
+{
+    auto it = m_years.constFind(year);
+    if (it != m_years.constEnd())
+        return *it;
+
+    Year bits = {};
+
+    QDate first(year, 1, 1);
+    int days      = first.daysInYear();
+    int dayOfWeek = first.dayOfWeek() - 1;
+
+    for (int day = 0; day < days; ++day, dayOfWeek = (dayOfWeek + 1) % 7)
+        if (m_workingWeekDays & (1 << dayOfWeek))
+            bits.words[day / 64] |= quint64(1) << (day % 64);
+
+    return bits;
+}
@@ -0,0 +1,47 @@
+#ifndef WORKINGCALENDAR_H
+#define WORKINGCALENDAR_H
+
+#include <QDate>
+#include <QHash>
+#include <QString>
+
+// Working days of a calendar are kept as one bitset per year, bit i is
+// the day i + 1 of the year. Years without changed days follow working week days.
+// Working days of a range are counted by popcount of the bitset words
+
+class WorkingCalendar
+{
+public:
+    // Bit (dayOfWeek - 1) is set for each working day of a week
+    static constexpr int WEEKDAYS = 0x1F;
+    static constexpr int ALL_DAYS = 0x7F;
+
+    explicit WorkingCalendar(int workingWeekDays = WEEKDAYS);
+
+    int  workingWeekDays() const;
+    bool isWorkingDay(const QDate& date) const;
+    void setWorkingDay(const QDate& date, bool working = true);
+    void setHoliday(const QDate& date);
+
+    int workingDays(const QDate& from, const QDate& to) const;
+
+    // Text form for storing in database: working week days and the days of each
+    // changed year as '1'/'0' characters, e.g. "31;2022:0011111001..."
+    QString toString() const;
+    static WorkingCalendar fromString(const QString& str, bool* ok = nullptr);
+
+private:
+    static constexpr int WORDS = 6;     // 366 bits
+
+    struct Year
+    {
+        quint64 words[WORDS];
+    };
+
+    int m_workingWeekDays;
+    QHash<int, Year> m_years;
+
+    Year year(int year) const;
+};
+
+#endif // WORKINGCALENDAR_H
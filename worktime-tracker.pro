@@ -1,4 +1,4 @@
-QT       += core gui sql testlib
+QT       += core gui sql testlib concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,19 +9,73 @@ CONFIG += c++11
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    balancekernel.cpp \
     helper.cpp \
+    leavepassindex.cpp \
+    livebalance.cpp \
     main.cpp \
     mainwindow.cpp \
+    memoryworktimestorage.cpp \
+    presenceheatmap.cpp \
+    punchaggregator.cpp \
+    rollupengine.cpp \
+    summarycache.cpp \
+    testbalancekernel.cpp \
     testhelper.cpp \
+    testleavepassindex.cpp \
+    testlivebalance.cpp \
+    testpresenceheatmap.cpp \
+    testpunchaggregator.cpp \
+    testrollupengine.cpp \
+    testsummarycache.cpp \
+    testworkingcalendar.cpp \
+    testworktimeimporter.cpp \
+    testworktimesnapshot.cpp \
+    testworktimestate.cpp \
+    testworktimestorage.cpp \
     testworktimetracker.cpp \
-    worktimetracker.cpp
+    testworktimewriter.cpp \
+    workingcalendar.cpp \
+    worktimeimporter.cpp \
+    worktimesnapshot.cpp \
+    worktimestate.cpp \
+    worktimestorage.cpp \
+    worktimetracker.cpp \
+    worktimewriter.cpp
 
 HEADERS += \
+    balancekernel.h \
     helper.h \
+    leavepassindex.h \
+    livebalance.h \
     mainwindow.h \
+    memoryworktimestorage.h \
+    presenceheatmap.h \
+    punchaggregator.h \
+    rollupengine.h \
+    summarycache.h \
+    testbalancekernel.h \
     testhelper.h \
+    testleavepassindex.h \
+    testlivebalance.h \
+    testpresenceheatmap.h \
+    testpunchaggregator.h \
+    testrollupengine.h \
+    testsummarycache.h \
+    testworkingcalendar.h \
+    testworktimeimporter.h \
+    testworktimesnapshot.h \
+    testworktimestate.h \
+    testworktimestorage.h \
     testworktimetracker.h \
-    worktimetracker.h
+    testworktimewriter.h \
+    workingcalendar.h \
+    worktimeimporter.h \
+    worktimesnapshot.h \
+    worktimestate.h \
+    worktimestorage.h \
+    worktimetracker.h \
+    worktimewriter.h
 
 FORMS += \
     mainwindow.ui
@@ -0,0 +1,261 @@
+#include "worktimeimporter.h"
+#include <QFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+constexpr qint64 WorktimeImporter::MIN_CHUNK_SIZE;
+
+WorktimeImporter::WorktimeImporter(WorktimeTracker *tracker)
+    : m_tracker(tracker), m_threadCount(QThread::idealThreadCount())
+{
+    Q_ASSERT(m_tracker);
+}
+
+bool WorktimeImporter::importFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+    {
+        qDebug() << "Can't open" << fileName << ":" << file.errorString();
+        return false;
+    }
+
+    qint64 size = file.size();
+    if (size == 0)
+        return importData(nullptr, 0);
+
+    // Memory-map the whole file so chunks can be parsed in place.
+    // Fall back to reading it if mapping isn't supported.
+    uchar* data = file.map(0, size);
+    if (!data)
+        return importData(file.readAll());
+
+    bool result = importData(reinterpret_cast<const char*>(data), size);
+    file.unmap(data);
+    return result;
+}
+
+bool WorktimeImporter::importData(const QByteArray &data)
+{
+    return importData(data.constData(), data.size());
+}
+
+bool WorktimeImporter::importData(const char *data, qint64 size)
+{
+    m_importedCount = 0;
+    m_errors.clear();
+
+    if (!data || size <= 0)
+        return true;
+
+    // Chunks are parsed on a pool of its own, so threadCount() bounds the parallelism
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_threadCount);
+
+    QList<QFuture<ParsedChunk>> futures;
+    for (const auto& chunk : split(data, size))
+        futures.append(QtConcurrent::run(&pool, &WorktimeImporter::parseChunk, chunk));
+
+    QList<ParsedChunk> parsedChunks;
+    for (const auto& future : futures)
+        parsedChunks.append(future.result());
+
+    // Resolve schedules and collect valid rows. Schedule lookups are cached since
+    // logs usually reference a handful of schedules
+    QHash<QString, WorktimeTracker::ScheduleRef> schedules;
+    QList<WorktimeTracker::Record> records;
+    QList<int> recordLines;
+    int lineOffset = 0;
+
+    for (const auto& chunk : parsedChunks)
+    {
+        for (const auto& row : chunk.rows)
+        {
+            int line = lineOffset + row.line;
+
+            if (!row.error.isEmpty()) {
+                m_errors.append({line, row.error});
+                continue;
+            }
+
+            auto name = row.schedule.isEmpty() ? m_tracker->defaultSchedule().name : row.schedule;
+            if (!schedules.contains(name))
+                schedules.insert(name, m_tracker->scheduleRef(name));
+
+            auto schedule = schedules.value(name);
+            if (!schedule.isValid()) {
+                m_errors.append({line, QString("unknown schedule '%1'").arg(name)});
+                continue;
+            }
+
+            WorktimeTracker::Record r;
+            r.date     = row.date;
+            r.schedule = schedule;
+            r.checkIn  = row.checkIn;
+            r.checkOut = row.checkOut;
+            records.append(r);
+            recordLines.append(line);
+        }
+
+        lineOffset += chunk.lineCount;
+    }
+
+    QList<int> rejected;
+    if (!m_tracker->insertRecords(records, &rejected))
+        return false;
+
+    for (int i : rejected)
+        m_errors.append({recordLines[i], "record is rejected by database"});
+
+    std::sort(m_errors.begin(), m_errors.end(), [](const RowError& e1, const RowError& e2) {
+        return e1.line < e2.line;
+    });
+
+    m_importedCount = records.size() - rejected.size();
+    return true;
+}
+
+int WorktimeImporter::importedCount() const
+{
+    return m_importedCount;
+}
+
+QList<WorktimeImporter::RowError> WorktimeImporter::errors() const
+{
+    return m_errors;
+}
+
+int WorktimeImporter::threadCount() const
+{
+    return m_threadCount;
+}
+
+void WorktimeImporter::setThreadCount(int count)
+{
+    m_threadCount = qMax(1, count);
+}
+
+QList<WorktimeImporter::Chunk> WorktimeImporter::split(const char *data, qint64 size) const
+{
+    QList<Chunk> chunks;
+
+    const char* dataEnd = data + size;
+    qint64 chunkSize = qMax(MIN_CHUNK_SIZE, size / m_threadCount + 1);
+
+    const char* begin = data;
+    while (begin < dataEnd)
+    {
+        // Move chunk end to the next line break so lines are never split
+        const char* end = begin + qMin(chunkSize, qint64(dataEnd - begin));
+        if (end < dataEnd) {
+            auto lineBreak = static_cast<const char*>(memchr(end, '\n', dataEnd - end));
+            end = lineBreak ? lineBreak + 1 : dataEnd;
+        }
+
+        Chunk chunk = {begin, end};
+        chunks.append(chunk);
+        begin = end;
+    }
+
+    return chunks;
+}
+
+WorktimeImporter::ParsedChunk WorktimeImporter::parseChunk(const Chunk &chunk)
+{
+    ParsedChunk parsed;
+
+    const char* lineBegin = chunk.begin;
+    while (lineBegin < chunk.end)
+    {
+        auto lineBreak = static_cast<const char*>(memchr(lineBegin, '\n', chunk.end - lineBegin));
+        const char* lineEnd = lineBreak ? lineBreak : chunk.end;
+
+        ++parsed.lineCount;
+
+        // Skip trailing '\r' of Windows line endings
+        const char* end = lineEnd;
+        if (end > lineBegin && *(end - 1) == '\r')
+            --end;
+
+        if (end > lineBegin && (end - lineBegin < 4 || strncmp(lineBegin, "Date", 4) != 0)) {
+            auto row = parseLine(lineBegin, end);
+            row.line = parsed.lineCount;
+            parsed.rows.append(row);
+        }
+
+        lineBegin = lineEnd + 1;
+    }
+
+    return parsed;
+}
+
+WorktimeImporter::Row WorktimeImporter::parseLine(const char *begin, const char *end)
+{
+    Row row;
+    row.line = 0;
+
+    // Fields are kept as raw [begin, end) ranges with surrounding whitespace trimmed
+    // like QString::trimmed() does, so dates and times are decoded without intermediate strings
+    auto isSpace = [](char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    };
+
+    constexpr int maxFields = 4;
+    Chunk fields[maxFields];
+    int fieldCount = 0;
+
+    const char* fieldBegin = begin;
+    for (const char* p = begin; p <= end; ++p)
+    {
+        if (p == end || *p == ',') {
+            // Extra fields are only counted for the error message
+            if (fieldCount < maxFields) {
+                const char* b = fieldBegin;
+                const char* e = p;
+                while (b < e && isSpace(*b)) ++b;
+                while (e > b && isSpace(*(e - 1))) --e;
+
+                fields[fieldCount] = {b, e};
+            }
+
+            ++fieldCount;
+            fieldBegin = p + 1;
+        }
+    }
+
+    if (fieldCount < 3 || fieldCount > maxFields) {
+        row.error = QString("expected 3 or 4 fields, got %1").arg(fieldCount);
+        return row;
+    }
+
+    auto field = [&fields](int i) {
+        return QString::fromLatin1(fields[i].begin, int(fields[i].end - fields[i].begin));
+    };
+
+    row.date     = parseIsoDate(fields[0].begin, int(fields[0].end - fields[0].begin));
+    row.checkIn  = parseIsoTime(fields[1].begin, int(fields[1].end - fields[1].begin));
+    row.checkOut = parseIsoTime(fields[2].begin, int(fields[2].end - fields[2].begin));
+    if (fieldCount == 4)
+        row.schedule = field(3);
+
+    // Same rules as WorktimeTracker::insertRecord()
+    if (!row.date.isValid())
+        row.error = QString("invalid date '%1'").arg(field(0));
+    else if (!row.checkIn.isValid())
+        row.error = QString("invalid check-in time '%1'").arg(field(1));
+    else if (!row.checkOut.isValid())
+        row.error = QString("invalid check-out time '%1'").arg(field(2));
+    else if (!TimeRange::valid(row.checkIn, row.checkOut) || TimeRange::inverted(row.checkIn, row.checkOut))
+        row.error = "check-in time has to be earlier than check-out time";
+
+    return row;
+}
+
+QString WorktimeImporter::RowError::toString() const
+{
+    return QString("line %1: %2").arg(line).arg(message);
+}
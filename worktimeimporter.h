@@ -0,0 +1,72 @@
+#ifndef WORKTIMEIMPORTER_H
+#define WORKTIMEIMPORTER_H
+
+#include <QByteArray>
+#include "worktimetracker.h"
+
+// Imports badge-reader logs into a WorktimeTracker.
+//
+// Expected input is CSV with one record per line:
+//     Date,CheckIn,CheckOut[,Schedule]
+//     2022-01-18,08:55:00,17:10:00,default
+// Empty lines and a header line starting with "Date" are skipped.
+// Input is split into chunks which are parsed in parallel, then all
+// valid rows are written by WorktimeTracker::insertRecords() in one transaction.
+// Invalid rows don't abort the import, they're reported by errors().
+
+class WorktimeImporter
+{
+public:
+    struct RowError
+    {
+        int     line;
+        QString message;
+        QString toString() const;
+    };
+
+    explicit WorktimeImporter(WorktimeTracker* tracker);
+
+    bool importFile(const QString& fileName);
+    bool importData(const QByteArray& data);
+    bool importData(const char* data, qint64 size);
+
+    int importedCount() const;
+    QList<RowError> errors() const;
+
+    // Maximum number of threads parsing the input, ideal thread count by default
+    int  threadCount() const;
+    void setThreadCount(int count);
+
+private:
+    struct Row
+    {
+        int     line;
+        QDate   date;
+        QTime   checkIn, checkOut;
+        QString schedule;
+        QString error;
+    };
+    struct Chunk
+    {
+        const char* begin;
+        const char* end;
+    };
+    struct ParsedChunk
+    {
+        QList<Row> rows;
+        int        lineCount = 0;
+    };
+
+    WorktimeTracker* m_tracker;
+    int              m_threadCount;
+    int              m_importedCount = 0;
+    QList<RowError>  m_errors;
+
+    static constexpr qint64 MIN_CHUNK_SIZE = 64 * 1024;
+
+    QList<Chunk> split(const char* data, qint64 size) const;
+    static ParsedChunk parseChunk(const Chunk& chunk);
+    static Row parseLine(const char* begin, const char* end);
+};
+
+#endif // WORKTIMEIMPORTER_H
@@ -0,0 +1,448 @@
+#include "worktimesnapshot.h"
+#include <QSqlQuery>
+#include <QVariant>
+#include <QVarLengthArray>
+#include <QPair>
+#include <algorithm>
+
+static inline qint32 toDay(const QVariant& value)
+{
+    return qint32(parseIsoDate(value.toString()).toJulianDay());
+}
+
+static inline qint32 toSeconds(const QVariant& value)
+{
+    return parseIsoTime(value.toString()).msecsSinceStartOfDay() / 1000;
+}
+
+template <typename T>
+static void splice(QVector<T>* column, int first, int last, const QVector<T>& values)
+{
+    QVector<T> result;
+    result.reserve(column->size() - (last - first) + values.size());
+    result += column->mid(0, first);
+    result += values;
+    result += column->mid(last);
+    *column = result;
+}
+
+WorktimeSnapshot::WorktimeSnapshot(int employee)
+    : m_employee(employee)
+{
+    clear();
+}
+
+int WorktimeSnapshot::employee() const
+{
+    return m_employee;
+}
+
+bool WorktimeSnapshot::load(const QSqlDatabase &db)
+{
+    Rows rows;
+    QMap<QDate, qint64> closed;
+    if (!reloadSchedules(db) || !fetch(db, QDate(), QDate(), &rows) ||
+        !fetchClosedBalances(db, QDate(), QDate(), &closed))
+        return false;
+
+    m_rows = rows;
+    m_closedBalances = closed;
+    return true;
+}
+
+bool WorktimeSnapshot::reload(const QSqlDatabase &db, const QDate &from, const QDate &to)
+{
+    if (!from.isValid() || !to.isValid())
+        return false;
+
+    QDate _from = qMin(from, to);
+    QDate _to   = qMax(from, to);
+
+    Rows rows;
+    QMap<QDate, qint64> closed;
+    if (!fetch(db, _from, _to, &rows) || !fetchClosedBalances(db, _from, _to, &closed))
+        return false;
+
+    replace(lowerBound(qint32(_from.toJulianDay())), lowerBound(qint32(_to.toJulianDay()) + 1), rows);
+
+    auto it = m_closedBalances.lowerBound(_from);
+    while (it != m_closedBalances.end() && it.key() <= _to)
+        it = m_closedBalances.erase(it);
+
+    for (auto month = closed.constBegin(); month != closed.constEnd(); ++month)
+        m_closedBalances.insert(month.key(), month.value());
+
+    return true;
+}
+
+bool WorktimeSnapshot::reloadSchedules(const QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!execQueryVerbosely(&query, "SELECT Id, Begin, End FROM schedule ORDER BY Id"))
+        return false;
+
+    // Slot 0 is never used since ids start with 1
+    m_scheduleBegins = QVector<qint32>({-1});
+    m_scheduleEnds   = QVector<qint32>({-1});
+
+    while (query.next())
+    {
+        int id = query.value(0).toInt();
+        if (id <= 0)
+            continue;
+
+        if (m_scheduleBegins.size() <= id) {
+            int size = m_scheduleBegins.size();
+            m_scheduleBegins.resize(id + 1);
+            m_scheduleEnds.resize(id + 1);
+
+            for (int i = size; i < id; ++i)
+                m_scheduleBegins[i] = -1;
+        }
+
+        m_scheduleBegins[id] = toSeconds(query.value(1));
+        m_scheduleEnds[id]   = toSeconds(query.value(2));
+    }
+
+    // Records could reference schedules which were unknown before
+    auto& r = m_rows;
+    for (int i = 0; i < r.days.size(); ++i)
+        plan(r.scheduleIds[i], &r.plannedBegins[i], &r.plannedEnds[i]);
+
+    return true;
+}
+
+void WorktimeSnapshot::clear()
+{
+    m_rows = Rows();
+    m_rows.leavePassOffsets.append(0);
+    m_scheduleBegins.clear();
+    m_scheduleEnds.clear();
+    m_closedBalances.clear();
+}
+
+int WorktimeSnapshot::size() const
+{
+    return m_rows.days.size();
+}
+
+int WorktimeSnapshot::lowerBound(qint32 day) const
+{
+    return int(std::lower_bound(m_rows.days.constBegin(), m_rows.days.constEnd(), day) - m_rows.days.constBegin());
+}
+
+const QVector<qint32> &WorktimeSnapshot::days() const
+{
+    return m_rows.days;
+}
+
+const QVector<qint32> &WorktimeSnapshot::scheduleIds() const
+{
+    return m_rows.scheduleIds;
+}
+
+const QVector<qint32> &WorktimeSnapshot::checkIns() const
+{
+    return m_rows.checkIns;
+}
+
+const QVector<qint32> &WorktimeSnapshot::checkOuts() const
+{
+    return m_rows.checkOuts;
+}
+
+const QVector<qint32> &WorktimeSnapshot::plannedBegins() const
+{
+    return m_rows.plannedBegins;
+}
+
+const QVector<qint32> &WorktimeSnapshot::plannedEnds() const
+{
+    return m_rows.plannedEnds;
+}
+
+const QVector<int> &WorktimeSnapshot::leavePassOffsets() const
+{
+    return m_rows.leavePassOffsets;
+}
+
+const QVector<qint32> &WorktimeSnapshot::leavePassBegins() const
+{
+    return m_rows.leavePassBegins;
+}
+
+const QVector<qint32> &WorktimeSnapshot::leavePassEnds() const
+{
+    return m_rows.leavePassEnds;
+}
+
+const QVector<qint32> &WorktimeSnapshot::scheduleBegins() const
+{
+    return m_scheduleBegins;
+}
+
+const QVector<qint32> &WorktimeSnapshot::scheduleEnds() const
+{
+    return m_scheduleEnds;
+}
+
+const QMap<QDate, qint64> &WorktimeSnapshot::closedBalances() const
+{
+    return m_closedBalances;
+}
+
+void WorktimeSnapshot::setClosedBalance(const QDate &month, qint64 balance)
+{
+    m_closedBalances.insert(month, balance);
+}
+
+void WorktimeSnapshot::removeClosedBalance(const QDate &month)
+{
+    m_closedBalances.remove(month);
+}
+
+TimeSpan WorktimeSnapshot::getSummary(const QDate &from, const QDate &to, bool *valid) const
+{
+    if (valid)
+        *valid = true;
+
+    if (!from.isValid())
+        return TimeSpan();
+
+    auto _from = from;
+    auto _to   = to.isValid() ? to : _from;
+
+    if (_from > _to)
+        qSwap(_from, _to);
+
+    int first = lowerBound(qint32(_from.toJulianDay()));
+    int last  = lowerBound(qint32(_to.toJulianDay()) + 1);
+
+    const auto& r = m_rows;
+
+    // All days are summed up as if they have no leave passes
+    auto sum = sumDebtOvertime(r.checkIns.constData() + first,
+                               r.checkOuts.constData() + first,
+                               r.plannedBegins.constData() + first,
+                               r.plannedEnds.constData() + first,
+                               last - first);
+    if (sum.invalid > 0) {
+        if (valid)
+            *valid = false;
+        return TimeSpan();
+    }
+
+    TimeSpan ts(sum.overtime - sum.debt);
+
+    // then balance of days with leave passes is replaced by the exact one.
+    // Such days are found by the leave passes of the range
+    int lp    = r.leavePassOffsets[first];
+    int lpEnd = r.leavePassOffsets[last];
+
+    while (lp < lpEnd)
+    {
+        int i = int(std::upper_bound(r.leavePassOffsets.constBegin() + first,
+                                     r.leavePassOffsets.constBegin() + last + 1,
+                                     lp) - r.leavePassOffsets.constBegin()) - 1;
+        int next = r.leavePassOffsets[i + 1];
+
+        ts.seconds -= dayBalance(r.checkIns[i], r.checkOuts[i],
+                                 r.plannedBegins[i], r.plannedEnds[i],
+                                 nullptr, nullptr, 0);
+        ts.seconds += dayBalance(r.checkIns[i], r.checkOuts[i],
+                                 r.plannedBegins[i], r.plannedEnds[i],
+                                 r.leavePassBegins.constData() + lp,
+                                 r.leavePassEnds.constData() + lp,
+                                 next - lp);
+        lp = next;
+    }
+
+    return ts;
+}
+
+qint64 WorktimeSnapshot::dayBalance(qint32 checkIn, qint32 checkOut, qint32 scheduleBegin, qint32 scheduleEnd, const qint32 *leavePassBegins, const qint32 *leavePassEnds, int leavePassCount)
+{
+    auto day = dayDebtOvertime(checkIn, checkOut, scheduleBegin, scheduleEnd, leavePassBegins, leavePassEnds, leavePassCount);
+    return day.overtime - day.debt;
+}
+
+DebtOvertime WorktimeSnapshot::dayDebtOvertime(qint32 checkIn, qint32 checkOut, qint32 scheduleBegin, qint32 scheduleEnd, const qint32 *leavePassBegins, const qint32 *leavePassEnds, int leavePassCount)
+{
+    DebtOvertime day;
+
+    // Overtime ranges [checkIn, begin] and [end, checkOut] never overlap since begin < end
+    day.overtime = qMax(0, scheduleBegin - checkIn) + qMax(0, checkOut - scheduleEnd);
+
+    QVarLengthArray<QPair<qint32, qint32>, 8> debt;
+
+    if (checkIn > scheduleBegin)
+        debt.append(qMakePair(scheduleBegin, checkIn));
+
+    if (scheduleEnd > checkOut)
+        debt.append(qMakePair(checkOut, scheduleEnd));
+
+    for (int i = 0; i < leavePassCount; ++i)
+        debt.append(qMakePair(leavePassBegins[i], leavePassEnds[i]));
+
+    // TimeRange::unite() returns a single range as is, even if it's inverted
+    if (debt.size() == 1) {
+        day.debt = debt[0].second - debt[0].first;
+        return day;
+    }
+
+    std::sort(debt.begin(), debt.end());
+
+    // Length of the union of valid ranges
+    qint32 begin = 0, end = 0;
+    bool   merging = false;
+
+    for (const auto& range : debt)
+    {
+        if (range.first >= range.second)
+            continue;
+
+        if (merging && range.first <= end) {
+            end = qMax(end, range.second);
+            continue;
+        }
+
+        if (merging)
+            day.debt += end - begin;
+
+        begin   = range.first;
+        end     = range.second;
+        merging = true;
+    }
+
+    if (merging)
+        day.debt += end - begin;
+
+    return day;
+}
+
+bool WorktimeSnapshot::fetch(const QSqlDatabase &db, const QDate &from, const QDate &to, Rows *rows) const
+{
+    // Invalid 'from' means all dates
+    QString condition = " WHERE Employee = :employee";
+    if (from.isValid())
+        condition += " AND Date BETWEEN date(:from) AND date(:to)";
+
+    QSqlQuery records(db);
+    records.setForwardOnly(true);
+    records.prepare("SELECT Date, " + scheduleColumnSql() + ", CheckIn, CheckOut FROM worktime" + condition + " ORDER BY Date");
+
+    QSqlQuery leavePasses(db);
+    leavePasses.setForwardOnly(true);
+    leavePasses.prepare("SELECT Date, Begin, End FROM leavepass" + condition + " ORDER BY Date, Id");
+
+    records.bindValue(":employee", m_employee);
+    leavePasses.bindValue(":employee", m_employee);
+
+    if (from.isValid()) {
+        records.bindValue(":from", from.toString(Qt::ISODate));
+        records.bindValue(":to", to.toString(Qt::ISODate));
+        leavePasses.bindValue(":from", from.toString(Qt::ISODate));
+        leavePasses.bindValue(":to", to.toString(Qt::ISODate));
+    }
+
+    if (!execQueryVerbosely(&records) || !execQueryVerbosely(&leavePasses))
+        return false;
+
+    *rows = Rows();
+    rows->leavePassOffsets.append(0);
+
+    // Both queries are sorted by date, so leave passes are merged into records
+    // in one pass. Leave passes of days without a record are skipped
+    bool   hasLeavePass = leavePasses.next();
+    qint32 leavePassDay = hasLeavePass ? toDay(leavePasses.value(0)) : 0;
+
+    while (records.next())
+    {
+        qint32 day = toDay(records.value(0));
+
+        rows->days.append(day);
+        rows->scheduleIds.append(records.value(1).toInt());
+        rows->checkIns.append(toSeconds(records.value(2)));
+        rows->checkOuts.append(toSeconds(records.value(3)));
+
+        qint32 begin, end;
+        plan(rows->scheduleIds.last(), &begin, &end);
+        rows->plannedBegins.append(begin);
+        rows->plannedEnds.append(end);
+
+        while (hasLeavePass && leavePassDay <= day)
+        {
+            if (leavePassDay == day) {
+                rows->leavePassBegins.append(toSeconds(leavePasses.value(1)));
+                rows->leavePassEnds.append(toSeconds(leavePasses.value(2)));
+            }
+
+            hasLeavePass = leavePasses.next();
+            leavePassDay = hasLeavePass ? toDay(leavePasses.value(0)) : 0;
+        }
+
+        rows->leavePassOffsets.append(rows->leavePassBegins.size());
+    }
+
+    return true;
+}
+
+void WorktimeSnapshot::replace(int first, int last, const Rows &rows)
+{
+    auto& r = m_rows;
+
+    int leavePassFirst = r.leavePassOffsets[first];
+    int leavePassLast  = r.leavePassOffsets[last];
+    int delta = rows.leavePassBegins.size() - (leavePassLast - leavePassFirst);
+
+    QVector<int> offsets;
+    offsets.reserve(r.leavePassOffsets.size() - (last - first) + rows.days.size());
+
+    for (int i = 0; i <= first; ++i)
+        offsets.append(r.leavePassOffsets[i]);
+    for (int i = 1; i < rows.leavePassOffsets.size(); ++i)
+        offsets.append(leavePassFirst + rows.leavePassOffsets[i]);
+    for (int i = last + 1; i < r.leavePassOffsets.size(); ++i)
+        offsets.append(r.leavePassOffsets[i] + delta);
+
+    splice(&r.days, first, last, rows.days);
+    splice(&r.scheduleIds, first, last, rows.scheduleIds);
+    splice(&r.checkIns, first, last, rows.checkIns);
+    splice(&r.checkOuts, first, last, rows.checkOuts);
+    splice(&r.plannedBegins, first, last, rows.plannedBegins);
+    splice(&r.plannedEnds, first, last, rows.plannedEnds);
+    splice(&r.leavePassBegins, leavePassFirst, leavePassLast, rows.leavePassBegins);
+    splice(&r.leavePassEnds, leavePassFirst, leavePassLast, rows.leavePassEnds);
+    r.leavePassOffsets = offsets;
+}
+
+bool WorktimeSnapshot::fetchClosedBalances(const QSqlDatabase &db, const QDate &from, const QDate &to, QMap<QDate, qint64> *balances) const
+{
+    // Invalid 'from' means all months
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT Month, Balance FROM closedperiod WHERE Employee = :employee") +
+                  (from.isValid() ? " AND Month BETWEEN date(:from) AND date(:to)" : ""));
+    query.bindValue(":employee", m_employee);
+
+    if (from.isValid()) {
+        query.bindValue(":from", from.toString(Qt::ISODate));
+        query.bindValue(":to", to.toString(Qt::ISODate));
+    }
+
+    if (!execQueryVerbosely(&query))
+        return false;
+
+    balances->clear();
+    while (query.next())
+        balances->insert(parseIsoDate(query.value(0).toString()), query.value(1).toLongLong());
+
+    return true;
+}
+
+void WorktimeSnapshot::plan(int id, qint32 *begin, qint32 *end) const
+{
+    bool known = id > 0 && id < m_scheduleBegins.size();
+    *begin = known ? m_scheduleBegins[id] : -1;
+    *end   = known ? m_scheduleEnds[id] : -1;
+}
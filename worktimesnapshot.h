@@ -0,0 +1,95 @@
+#ifndef WORKTIMESNAPSHOT_H
+#define WORKTIMESNAPSHOT_H
+
+#include <QSqlDatabase>
+#include <QVector>
+#include <QMap>
+#include "helper.h"
+#include "balancekernel.h"
+
+class WorktimeStorage;
+
+// In-memory struct-of-arrays copy of the worktime and leavepass tables
+// of one employee used for analytical queries like getSummary(), with
+// balances of the closed months of the employee.
+//
+// Records are sorted by day, days are Julian days and times are seconds
+// since midnight. Leave passes of record i are stored in
+// leavePassBegins()/leavePassEnds() at [leavePassOffsets()[i], leavePassOffsets()[i + 1]).
+// Schedule begin/end are indexed by schedule id, unknown ids have begin = -1.
+// plannedBegins()/plannedEnds() are schedule begin/end of each record, so days
+// without leave passes are summed up by the SIMD kernel from balancekernel.h.
+// reload() of a range reloads closed months starting in it too
+
+class WorktimeSnapshot
+{
+public:
+    explicit WorktimeSnapshot(int employee = 0);
+
+    int employee() const;
+
+    // See WorktimeStorage::loadSnapshot() for other storages
+    bool load(const QSqlDatabase& db);
+    bool reload(const QSqlDatabase& db, const QDate& from, const QDate& to);
+    bool reloadSchedules(const QSqlDatabase& db);
+    void clear();
+
+    int size() const;
+    int lowerBound(qint32 day) const;
+
+    const QVector<qint32>& days() const;
+    const QVector<qint32>& scheduleIds() const;
+    const QVector<qint32>& checkIns() const;
+    const QVector<qint32>& checkOuts() const;
+    const QVector<qint32>& plannedBegins() const;
+    const QVector<qint32>& plannedEnds() const;
+
+    const QVector<int>&    leavePassOffsets() const;
+    const QVector<qint32>& leavePassBegins() const;
+    const QVector<qint32>& leavePassEnds() const;
+
+    const QVector<qint32>& scheduleBegins() const;
+    const QVector<qint32>& scheduleEnds() const;
+
+    // Balances in seconds by the first day of the month
+    const QMap<QDate, qint64>& closedBalances() const;
+    void setClosedBalance(const QDate& month, qint64 balance);
+    void removeClosedBalance(const QDate& month);
+
+    // Summary is zero if the range has a day with unknown schedule, in that case 'valid' is set to false
+    TimeSpan getSummary(const QDate& from, const QDate& to = QDate(), bool* valid = nullptr) const;
+
+    // Balance, debt and overtime of one day in seconds, the same rules as WorktimeTracker::getSummary()
+    static qint64 dayBalance(qint32 checkIn, qint32 checkOut,
+                             qint32 scheduleBegin, qint32 scheduleEnd,
+                             const qint32* leavePassBegins, const qint32* leavePassEnds,
+                             int leavePassCount);
+    static DebtOvertime dayDebtOvertime(qint32 checkIn, qint32 checkOut,
+                                        qint32 scheduleBegin, qint32 scheduleEnd,
+                                        const qint32* leavePassBegins, const qint32* leavePassEnds,
+                                        int leavePassCount);
+
+private:
+    friend class WorktimeStorage;
+
+    struct Rows
+    {
+        QVector<qint32> days, scheduleIds, checkIns, checkOuts;
+        QVector<qint32> plannedBegins, plannedEnds;
+        QVector<int>    leavePassOffsets;
+        QVector<qint32> leavePassBegins, leavePassEnds;
+    };
+
+    int             m_employee;
+    Rows            m_rows;
+    QVector<qint32> m_scheduleBegins;
+    QVector<qint32> m_scheduleEnds;
+    QMap<QDate, qint64> m_closedBalances;
+
+    bool fetch(const QSqlDatabase& db, const QDate& from, const QDate& to, Rows* rows) const;
+    bool fetchClosedBalances(const QSqlDatabase& db, const QDate& from, const QDate& to, QMap<QDate, qint64>* balances) const;
+    void plan(int id, qint32* begin, qint32* end) const;
+    void replace(int first, int last, const Rows& rows);
+};
+
+#endif // WORKTIMESNAPSHOT_H
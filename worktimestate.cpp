@@ -0,0 +1,112 @@
+#include "worktimestate.h"
+
+WorktimeState::WorktimeState(quint64 version,
+                             const WorktimeSnapshot &snapshot,
+                             const QVector<WorktimeTracker::Schedule> &schedules,
+                             const QHash<QString, int> &scheduleIds)
+    : m_version(version),
+      m_snapshot(snapshot),
+      m_schedules(schedules),
+      m_scheduleIds(scheduleIds)
+{
+}
+
+WorktimeState::WorktimeState(quint64 version, const WorktimeSnapshot &snapshot, const WorktimeState &previous)
+    : m_version(version),
+      m_snapshot(snapshot),
+      m_schedules(previous.m_schedules),
+      m_scheduleIds(previous.m_scheduleIds)
+{
+}
+
+quint64 WorktimeState::version() const
+{
+    return m_version;
+}
+
+int WorktimeState::employee() const
+{
+    return m_snapshot.employee();
+}
+
+TimeSpan WorktimeState::getSummary(const QDate &from, const QDate &to, bool *valid) const
+{
+    if (valid)
+        *valid = true;
+
+    if (!from.isValid())
+        return TimeSpan();
+
+    auto _from = from;
+    auto _to   = to.isValid() ? to : _from;
+
+    if (_from > _to)
+        qSwap(_from, _to);
+
+    // Closed months lying entirely in the range are taken as is
+    const auto& closed = m_snapshot.closedBalances();
+
+    TimeSpan ts;
+    bool  ok    = true;
+    QDate begin = _from;
+
+    for (auto it = closed.lowerBound(_from); it != closed.constEnd() && ok; ++it)
+    {
+        auto end = periodEnd(it.key(), SummaryPeriod::Month);
+        if (end > _to)
+            break;
+
+        if (begin < it.key())
+            ts.seconds += m_snapshot.getSummary(begin, it.key().addDays(-1), &ok).seconds;
+
+        ts.seconds += it.value();
+        begin = end.addDays(1);
+    }
+
+    if (begin <= _to && ok)
+        ts.seconds += m_snapshot.getSummary(begin, _to, &ok).seconds;
+
+    if (valid)
+        *valid = ok;
+
+    return ok ? ts : TimeSpan();
+}
+
+WorktimeTracker::Record WorktimeState::getRecord(const QDate &date) const
+{
+    if (!date.isValid())
+        return WorktimeTracker::Record();
+
+    auto day = qint32(date.toJulianDay());
+    int  i   = m_snapshot.lowerBound(day);
+
+    if (i == m_snapshot.size() || m_snapshot.days()[i] != day)
+        return WorktimeTracker::Record();
+
+    int id = m_snapshot.scheduleIds()[i];
+
+    WorktimeTracker::Record r;
+    r.date     = date;
+    r.checkIn  = QTime::fromMSecsSinceStartOfDay(m_snapshot.checkIns()[i] * 1000);
+    r.checkOut = QTime::fromMSecsSinceStartOfDay(m_snapshot.checkOuts()[i] * 1000);
+
+    if (getSchedule(id).isValid())
+        r.schedule = WorktimeTracker::ScheduleRef(&m_schedules.at(id));
+
+    return r;
+}
+
+WorktimeTracker::Schedule WorktimeState::getSchedule(const QString &name) const
+{
+    return getSchedule(m_scheduleIds.value(name));
+}
+
+WorktimeTracker::Schedule WorktimeState::getSchedule(int id) const
+{
+    return m_schedules.value(id);
+}
+
+const WorktimeSnapshot &WorktimeState::snapshot() const
+{
+    return m_snapshot;
+}
@@ -0,0 +1,47 @@
+#ifndef WORKTIMESTATE_H
+#define WORKTIMESTATE_H
+
+#include <QHash>
+#include <QVector>
+#include "worktimetracker.h"
+
+// Immutable version of the data of the current employee of a tracker: the snapshot
+// of records and leave passes, interned schedules and balances of closed months.
+// The tracker publishes a new version after each committed write and readers take
+// it with WorktimeTracker::state(). A published version is never changed, so it's
+// read from any thread without locks and queries while the tracker builds the next one.
+// Working calendar isn't a part of the state, getSummary() counts records only
+
+class WorktimeState
+{
+public:
+    WorktimeState(quint64 version,
+                  const WorktimeSnapshot& snapshot,
+                  const QVector<WorktimeTracker::Schedule>& schedules,
+                  const QHash<QString, int>& scheduleIds);
+    // New version of the data with schedules of 'previous'
+    WorktimeState(quint64 version, const WorktimeSnapshot& snapshot, const WorktimeState& previous);
+
+    // Versions of one tracker grow with every publication
+    quint64 version() const;
+    int     employee() const;
+
+    // The same as WorktimeTracker::getSummary() without working calendar
+    TimeSpan getSummary(const QDate& from, const QDate& to = QDate(), bool* valid = nullptr) const;
+
+    // Schedule references of the record stay valid while the state exists
+    WorktimeTracker::Record getRecord(const QDate& date) const;
+
+    WorktimeTracker::Schedule getSchedule(const QString& name) const;
+    WorktimeTracker::Schedule getSchedule(int id) const;
+
+    const WorktimeSnapshot& snapshot() const;
+
+private:
+    quint64                            m_version;
+    WorktimeSnapshot                   m_snapshot;
+    QVector<WorktimeTracker::Schedule> m_schedules;
+    QHash<QString, int>                m_scheduleIds;
+};
+
+#endif // WORKTIMESTATE_H
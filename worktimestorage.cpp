@@ -0,0 +1,486 @@
+#include "worktimestorage.h"
+#include <QSqlQuery>
+#include <QVariant>
+#include <QHash>
+
+static inline QString dateToString(const QDate& date)
+{
+    return date.toString(Qt::ISODate);
+}
+
+static inline QVariant timeToVariant(quint32 seconds)
+{
+    if (seconds == WorktimeTracker::CompactRecord::NO_TIME)
+        return QVariant();
+
+    return QTime::fromMSecsSinceStartOfDay(int(seconds) * 1000).toString(Qt::ISODate);
+}
+
+static WorktimeStorage::Record readRecord(const QSqlQuery& query)
+{
+    WorktimeTracker::Record r;
+    r.date     = parseIsoDate(query.value(0).toString());
+    r.checkIn  = parseIsoTime(query.value(2).toString());
+    r.checkOut = parseIsoTime(query.value(3).toString());
+
+    auto c = WorktimeTracker::CompactRecord::fromRecord(r);
+    c.setScheduleId(query.value(1).toInt());
+    return c;
+}
+
+static WorktimeStorage::LeavePass readLeavePass(const QSqlQuery& query)
+{
+    WorktimeStorage::LeavePass pass = {};
+    pass.date    = parseIsoDate(query.value(0).toString());
+    pass.id      = query.value(1).toInt();
+    pass.from    = parseIsoTime(query.value(2).toString());
+    pass.to      = parseIsoTime(query.value(3).toString());
+    pass.comment   = query.value(4).toString();
+    pass.generated = query.value(5).toBool();
+    return pass;
+}
+
+static WorktimeStorage::Schedule readSchedule(const QSqlQuery& query)
+{
+    WorktimeStorage::Schedule s;
+    s.id             = query.value(0).toInt();
+    s.name           = query.value(1).toString();
+    s.begin          = parseIsoTime(query.value(2).toString());
+    s.end            = parseIsoTime(query.value(3).toString());
+    s.lunchTimeBegin = parseIsoTime(query.value(4).toString());
+    s.lunchTimeEnd   = parseIsoTime(query.value(5).toString());
+    return s;
+}
+
+// Scans of all dates have no range condition
+static QString rangeCondition(const QDate& from)
+{
+    return from.isValid() ? " AND Date BETWEEN date(:from) AND date(:to)" : "";
+}
+
+static void bindRange(QSqlQuery* query, const QDate& from, const QDate& to)
+{
+    if (!from.isValid())
+        return;
+
+    auto _to = to.isValid() ? to : from;
+    query->bindValue(":from", dateToString(qMin(from, _to)));
+    query->bindValue(":to", dateToString(qMax(from, _to)));
+}
+
+WorktimeStorage::~WorktimeStorage()
+{
+
+}
+
+void WorktimeStorage::invalidate()
+{
+
+}
+
+QSqlDatabase WorktimeStorage::database() const
+{
+    return QSqlDatabase();
+}
+
+bool WorktimeStorage::loadSnapshot(WorktimeSnapshot *snapshot) const
+{
+    QVector<Schedule>  schedules;
+    QVector<Record>    records;
+    QVector<LeavePass> leavePasses;
+
+    if (!getSchedules(&schedules) ||
+        !getRecords(snapshot->m_employee, QDate(), QDate(), &records) ||
+        !getLeavePasses(snapshot->m_employee, QDate(), QDate(), &leavePasses))
+        return false;
+
+    snapshot->m_scheduleBegins = QVector<qint32>({-1});
+    snapshot->m_scheduleEnds   = QVector<qint32>({-1});
+
+    for (const auto& schedule : schedules)
+    {
+        if (schedule.id <= 0)
+            continue;
+
+        // Gaps of ids are unknown schedules
+        while (snapshot->m_scheduleBegins.size() <= schedule.id) {
+            snapshot->m_scheduleBegins.append(-1);
+            snapshot->m_scheduleEnds.append(-1);
+        }
+
+        snapshot->m_scheduleBegins[schedule.id] = schedule.begin.msecsSinceStartOfDay() / 1000;
+        snapshot->m_scheduleEnds[schedule.id]   = schedule.end.msecsSinceStartOfDay() / 1000;
+    }
+
+    WorktimeSnapshot::Rows rows;
+    rows.leavePassOffsets.append(0);
+
+    // The same merge as in WorktimeSnapshot::fetch(), missing times are midnight like empty columns
+    int lp = 0;
+    for (const auto& record : records)
+    {
+        auto seconds = [](quint32 time) {
+            return time != Record::NO_TIME ? qint32(time) : 0;
+        };
+
+        rows.days.append(record.day);
+        rows.scheduleIds.append(qint32(record.scheduleId()));
+        rows.checkIns.append(seconds(record.checkIn));
+        rows.checkOuts.append(seconds(record.checkOut));
+
+        qint32 begin, end;
+        snapshot->plan(qint32(record.scheduleId()), &begin, &end);
+        rows.plannedBegins.append(begin);
+        rows.plannedEnds.append(end);
+
+        for (; lp < leavePasses.size() && leavePasses[lp].date.toJulianDay() <= record.day; ++lp)
+        {
+            if (leavePasses[lp].date.toJulianDay() == record.day) {
+                rows.leavePassBegins.append(leavePasses[lp].from.msecsSinceStartOfDay() / 1000);
+                rows.leavePassEnds.append(leavePasses[lp].to.msecsSinceStartOfDay() / 1000);
+            }
+        }
+
+        rows.leavePassOffsets.append(rows.leavePassBegins.size());
+    }
+
+    // Storage doesn't keep closed months
+    snapshot->m_rows = rows;
+    snapshot->m_closedBalances.clear();
+    return true;
+}
+
+
+SqlWorktimeStorage::SqlWorktimeStorage(const QSqlDatabase &db)
+    : m_db(db)
+{
+
+}
+
+bool SqlWorktimeStorage::insertRecord(int employee, const Record &record)
+{
+    if (!record.isValid() || !m_db.isOpen())
+        return false;
+
+    if (!m_insertRecord) {
+        m_insertRecord.reset(new QSqlQuery(m_db));
+        m_insertRecord->prepare("INSERT INTO worktime (Date, Schedule, CheckIn, CheckOut, Employee) "
+                                "VALUES (:d, :schedule, :checkIn, :checkOut, :employee)");
+    }
+
+    auto& query = *m_insertRecord;
+    query.bindValue(":d", dateToString(record.date()));
+    query.bindValue(":schedule", record.scheduleId());
+    query.bindValue(":checkIn", timeToVariant(record.checkIn));
+    query.bindValue(":checkOut", timeToVariant(record.checkOut));
+    query.bindValue(":employee", employee);
+
+    return execQueryVerbosely(&query);
+}
+
+bool SqlWorktimeStorage::updateRecord(int employee, const Record &record)
+{
+    if (!record.isValid())
+        return false;
+
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE worktime SET Schedule = :schedule, CheckIn = :checkIn, CheckOut = :checkOut "
+                  "WHERE Employee = :employee AND Date = date(:d)");
+    query.bindValue(":schedule", record.scheduleId());
+    query.bindValue(":checkIn", timeToVariant(record.checkIn));
+    query.bindValue(":checkOut", timeToVariant(record.checkOut));
+    query.bindValue(":employee", employee);
+    query.bindValue(":d", dateToString(record.date()));
+
+    return changed(&query);
+}
+
+bool SqlWorktimeStorage::removeRecord(int employee, const QDate &date)
+{
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM worktime WHERE Employee = :employee AND Date = date(:d)");
+    query.bindValue(":employee", employee);
+    query.bindValue(":d", dateToString(date));
+
+    return changed(&query);
+}
+
+bool SqlWorktimeStorage::getRecord(int employee, const QDate &date, Record *record) const
+{
+    QSqlQuery query(m_db);
+    query.prepare("SELECT Date, " + scheduleColumnSql() + ", CheckIn, CheckOut FROM worktime "
+                  "WHERE Employee = :employee AND Date = date(:d)");
+    query.bindValue(":employee", employee);
+    query.bindValue(":d", dateToString(date));
+
+    if (!execQueryVerbosely(&query) || !query.next())
+        return false;
+
+    *record = readRecord(query);
+    return true;
+}
+
+bool SqlWorktimeStorage::getRecords(int employee, const QDate &from, const QDate &to, QVector<Record> *records) const
+{
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT Date, " + scheduleColumnSql() + ", CheckIn, CheckOut FROM worktime "
+                  "WHERE Employee = :employee" + rangeCondition(from) + " ORDER BY Date");
+    query.bindValue(":employee", employee);
+    bindRange(&query, from, to);
+
+    if (!execQueryVerbosely(&query))
+        return false;
+
+    records->clear();
+    while (query.next())
+        records->append(readRecord(query));
+
+    return true;
+}
+
+bool SqlWorktimeStorage::setCheckIns(int employee, const QDate &from, const QDate &to, const QTime &time)
+{
+    return setTimes("CheckIn", "CheckOut >= time(:time)", employee, from, to, time);
+}
+
+bool SqlWorktimeStorage::setCheckOuts(int employee, const QDate &from, const QDate &to, const QTime &time)
+{
+    return setTimes("CheckOut", "CheckIn <= time(:time)", employee, from, to, time);
+}
+
+bool SqlWorktimeStorage::assignSchedule(int employee, int id, const QDate &from, const QDate &to)
+{
+    if (id <= 0 || !from.isValid())
+        return false;
+
+    auto _to   = to.isValid() ? to : from;
+    auto _from = qMin(from, _to);
+    _to        = qMax(from, _to);
+
+    // Assignments of an employee never overlap. Ones intersecting [from, to] are
+    // cut off, then the new one is merged with adjacent assignments of the same schedule
+
+    QSqlQuery query(m_db);
+
+    QHash<QString, QVariant> values = {
+        {":employee",   employee},
+        {":schedule",   id},
+        {":from",       dateToString(_from)},
+        {":to",         dateToString(_to)},
+        {":beforeFrom", dateToString(_from.addDays(-1))},
+        {":afterTo",    dateToString(_to.addDays(1))}
+    };
+
+    // Only placeholders of the statement can be bound
+    auto exec = [&](const QString& queryText) {
+        query.prepare(queryText);
+        for (auto it = values.constBegin(); it != values.constEnd(); ++it)
+            if (queryText.contains(it.key()))
+                query.bindValue(it.key(), it.value());
+        return execQueryVerbosely(&query);
+    };
+
+    bool ok = exec("INSERT INTO scheduleassignment (Begin, End, Schedule, Employee) "
+                   "SELECT :afterTo, End, Schedule, Employee FROM scheduleassignment "
+                   "WHERE Employee = :employee AND Begin < :from AND End > :to") &&
+              exec("UPDATE scheduleassignment SET End = :beforeFrom "
+                   "WHERE Employee = :employee AND Begin < :from AND End >= :from") &&
+              exec("DELETE FROM scheduleassignment "
+                   "WHERE Employee = :employee AND Begin >= :from AND End <= :to") &&
+              exec("UPDATE scheduleassignment SET Begin = :afterTo "
+                   "WHERE Employee = :employee AND Begin BETWEEN :from AND :to");
+    if (!ok)
+        return false;
+
+    auto begin = dateToString(_from);
+    auto end   = dateToString(_to);
+
+    if (!exec("SELECT Begin FROM scheduleassignment WHERE Employee = :employee AND End = :beforeFrom AND Schedule = :schedule"))
+        return false;
+    if (query.next())
+        begin = query.value(0).toString();
+
+    if (!exec("SELECT End FROM scheduleassignment WHERE Employee = :employee AND Begin = :afterTo AND Schedule = :schedule"))
+        return false;
+    if (query.next())
+        end = query.value(0).toString();
+
+    ok = exec("DELETE FROM scheduleassignment WHERE Employee = :employee AND Schedule = :schedule "
+              "AND (End = :beforeFrom OR Begin = :afterTo)");
+    if (!ok)
+        return false;
+
+    query.prepare("INSERT INTO scheduleassignment (Begin, End, Schedule, Employee) VALUES (:begin, :end, :schedule, :employee)");
+    query.bindValue(":begin", begin);
+    query.bindValue(":end", end);
+    query.bindValue(":schedule", id);
+    query.bindValue(":employee", employee);
+    return execQueryVerbosely(&query);
+}
+
+bool SqlWorktimeStorage::insertSchedule(Schedule *schedule)
+{
+    if (!schedule->isValid())
+        return false;
+
+    QSqlQuery query(m_db);
+    query.prepare("INSERT INTO schedule (Name, Begin, End, LunchTimeBegin, LunchTimeEnd) "
+                  "VALUES(:schedule,:begin,:end,:lunchBegin,:lunchEnd)");
+    query.bindValue(":schedule", schedule->name);
+    query.bindValue(":begin", schedule->begin.toString(Qt::ISODate));
+    query.bindValue(":end", schedule->end.toString(Qt::ISODate));
+    query.bindValue(":lunchBegin", schedule->lunchTimeBegin.toString(Qt::ISODate));
+    query.bindValue(":lunchEnd", schedule->lunchTimeEnd.toString(Qt::ISODate));
+
+    if (!execQueryVerbosely(&query))
+        return false;
+
+    schedule->id = query.lastInsertId().toInt();
+    return true;
+}
+
+bool SqlWorktimeStorage::getSchedule(int id, Schedule *schedule) const
+{
+    return fetchSchedule("Id", id, schedule);
+}
+
+bool SqlWorktimeStorage::getSchedule(const QString &name, Schedule *schedule) const
+{
+    return fetchSchedule("Name", name, schedule);
+}
+
+bool SqlWorktimeStorage::getSchedules(QVector<Schedule> *schedules) const
+{
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+
+    if (!execQueryVerbosely(&query, "SELECT Id, Name, Begin, End, LunchTimeBegin, LunchTimeEnd FROM schedule ORDER BY Id"))
+        return false;
+
+    schedules->clear();
+    while (query.next())
+        schedules->append(readSchedule(query));
+
+    return true;
+}
+
+bool SqlWorktimeStorage::insertLeavePass(int employee, LeavePass *pass)
+{
+    if (!pass->date.isValid() || !pass->from.isValid() || !pass->to.isValid())
+        return false;
+
+    // Id is allocated by the insert itself, so concurrent writers can't get the same
+    // one and ids of deleted leave passes aren't reused while later ones exist
+    QSqlQuery query(m_db);
+    query.prepare("INSERT INTO leavepass (Date, Id, Begin, End, Comment, Employee, Generated) "
+                  "SELECT :d, COALESCE(MAX(Id) + 1, 0), :begin, :end, :comment, :employee, :generated "
+                  "FROM leavepass WHERE Employee = :employee AND Date = date(:d)");
+    query.bindValue(":d", dateToString(pass->date));
+    query.bindValue(":begin", pass->from.toString(Qt::ISODate));
+    query.bindValue(":end", pass->to.toString(Qt::ISODate));
+    query.bindValue(":comment", pass->comment);
+    query.bindValue(":employee", employee);
+    query.bindValue(":generated", int(pass->generated));
+
+    if (!execQueryVerbosely(&query))
+        return false;
+
+    query.prepare("SELECT Id FROM leavepass WHERE rowid = last_insert_rowid()");
+    if (!execQueryVerbosely(&query) || !query.next())
+        return false;
+
+    pass->id = query.value(0).toInt();
+    return true;
+}
+
+bool SqlWorktimeStorage::updateLeavePass(int employee, const LeavePass &pass)
+{
+    if (!pass.from.isValid() || !pass.to.isValid())
+        return false;
+
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE leavepass SET Begin = :begin, End = :end, Comment = :comment "
+                  "WHERE Employee = :employee AND Date = date(:d) AND Id = :id");
+    query.bindValue(":begin", pass.from.toString(Qt::ISODate));
+    query.bindValue(":end", pass.to.toString(Qt::ISODate));
+    query.bindValue(":comment", pass.comment);
+    query.bindValue(":employee", employee);
+    query.bindValue(":d", dateToString(pass.date));
+    query.bindValue(":id", pass.id);
+
+    return changed(&query);
+}
+
+bool SqlWorktimeStorage::removeLeavePass(int employee, const QDate &date, int id)
+{
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM leavepass WHERE Employee = :employee AND Date = date(:d) AND Id = :id");
+    query.bindValue(":employee", employee);
+    query.bindValue(":d", dateToString(date));
+    query.bindValue(":id", id);
+
+    return changed(&query);
+}
+
+bool SqlWorktimeStorage::getLeavePasses(int employee, const QDate &from, const QDate &to, QVector<LeavePass> *passes) const
+{
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT Date, Id, Begin, End, Comment, Generated FROM leavepass "
+                  "WHERE Employee = :employee" + rangeCondition(from) + " ORDER BY Date, Id");
+    query.bindValue(":employee", employee);
+    bindRange(&query, from, to);
+
+    if (!execQueryVerbosely(&query))
+        return false;
+
+    passes->clear();
+    while (query.next())
+        passes->append(readLeavePass(query));
+
+    return true;
+}
+
+QSqlDatabase SqlWorktimeStorage::database() const
+{
+    return m_db;
+}
+
+bool SqlWorktimeStorage::fetchSchedule(const QString &column, const QVariant &value, Schedule *schedule) const
+{
+    QSqlQuery query(m_db);
+    query.prepare(QString("SELECT Id, Name, Begin, End, LunchTimeBegin, LunchTimeEnd FROM schedule WHERE %1 = :value").arg(column));
+    query.bindValue(":value", value);
+
+    if (!execQueryVerbosely(&query) || !query.next())
+        return false;
+
+    *schedule = readSchedule(query);
+    return true;
+}
+
+bool SqlWorktimeStorage::changed(QSqlQuery *query) const
+{
+    if (!execQueryVerbosely(query))
+        return false;
+
+    query->exec("SELECT changes()");
+    return query->next() && query->value(0).toInt() > 0;
+}
+
+bool SqlWorktimeStorage::setTimes(const QString &column, const QString &condition,
+                                  int employee, const QDate &from, const QDate &to, const QTime &time)
+{
+    if (!time.isValid())
+        return false;
+
+    QSqlQuery query(m_db);
+    query.prepare(QString("UPDATE worktime SET %1 = :time WHERE Employee = :employee AND %2").arg(column).arg(condition) +
+                  rangeCondition(from));
+    query.bindValue(":time", time.toString(Qt::ISODate));
+    query.bindValue(":employee", employee);
+    bindRange(&query, from, to);
+
+    return changed(&query);
+}
@@ -0,0 +1,112 @@
+#ifndef WORKTIMESTORAGE_H
+#define WORKTIMESTORAGE_H
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QVector>
+#include <memory>
+#include "worktimetracker.h"
+
+// Storage operations on records, leave passes and schedules: CRUD of one item, range
+// scans and range writes of an employee. WorktimeTracker reads and writes them through its storage.
+// SqlWorktimeStorage works on the tables of WorktimeTracker, MemoryWorktimeStorage keeps
+// everything in memory alone or as a write-through cache in front of another storage.
+// Records are compact, schedules are referenced by id. Rules of the tracker (closed
+// months, schedule assignments, leave passes within the schedule) aren't applied by storages.
+//
+// Write methods return false on error, if the item to insert exists or the item to
+// update/remove doesn't. Read methods return false on error or if the item doesn't exist.
+// Invalid 'from' of a range scan means all dates, scans are sorted by date (and id)
+
+class WorktimeStorage
+{
+public:
+    typedef WorktimeTracker::CompactRecord Record;
+    typedef WorktimeTracker::LeavePass     LeavePass;
+    typedef WorktimeTracker::Schedule      Schedule;
+
+    virtual ~WorktimeStorage();
+
+    virtual bool insertRecord(int employee, const Record& record) = 0;
+    virtual bool updateRecord(int employee, const Record& record) = 0;
+    virtual bool removeRecord(int employee, const QDate& date) = 0;
+    virtual bool getRecord(int employee, const QDate& date, Record* record) const = 0;
+    virtual bool getRecords(int employee, const QDate& from, const QDate& to, QVector<Record>* records) const = 0;
+
+    // Check in is set in records of the range where it isn't after check out, check out
+    // where it isn't before check in. They return false if no record is changed
+    virtual bool setCheckIns(int employee, const QDate& from, const QDate& to, const QTime& time) = 0;
+    virtual bool setCheckOuts(int employee, const QDate& from, const QDate& to, const QTime& time) = 0;
+
+    // Records of the range are read with the schedule, the ones inserted later too
+    // unless they're assigned their own one
+    virtual bool assignSchedule(int employee, int id, const QDate& from, const QDate& to) = 0;
+
+    // Schedule gets the next id, names are unique. Schedules are sorted by id
+    virtual bool insertSchedule(Schedule* schedule) = 0;
+    virtual bool getSchedule(int id, Schedule* schedule) const = 0;
+    virtual bool getSchedule(const QString& name, Schedule* schedule) const = 0;
+    virtual bool getSchedules(QVector<Schedule>* schedules) const = 0;
+
+    // Leave pass gets the next id of its date, the first one is 0
+    virtual bool insertLeavePass(int employee, LeavePass* pass) = 0;
+    virtual bool updateLeavePass(int employee, const LeavePass& pass) = 0;
+    virtual bool removeLeavePass(int employee, const QDate& date, int id) = 0;
+    virtual bool getLeavePasses(int employee, const QDate& from, const QDate& to, QVector<LeavePass>* passes) const = 0;
+
+    // Drops data taken from another storage, e.g. after a rolled back transaction
+    // of the tables. Storages without cached data do nothing
+    virtual void invalidate();
+
+    // Connection of the tables the storage writes to. It's invalid if data
+    // is kept apart from them
+    virtual QSqlDatabase database() const;
+
+    // Loads records, leave passes and schedules of the employee of the snapshot
+    bool loadSnapshot(WorktimeSnapshot* snapshot) const;
+};
+
+// Storage in worktime, leavepass and schedule tables. The tables are created by
+// WorktimeTracker, records are read with the assigned schedule like WorktimeTracker::getRecord()
+
+class SqlWorktimeStorage : public WorktimeStorage
+{
+public:
+    explicit SqlWorktimeStorage(const QSqlDatabase& db);
+
+    bool insertRecord(int employee, const Record& record) override;
+    bool updateRecord(int employee, const Record& record) override;
+    bool removeRecord(int employee, const QDate& date) override;
+    bool getRecord(int employee, const QDate& date, Record* record) const override;
+    bool getRecords(int employee, const QDate& from, const QDate& to, QVector<Record>* records) const override;
+
+    // One statement for the whole range. Assignments are intervals in scheduleassignment table
+    bool setCheckIns(int employee, const QDate& from, const QDate& to, const QTime& time) override;
+    bool setCheckOuts(int employee, const QDate& from, const QDate& to, const QTime& time) override;
+    bool assignSchedule(int employee, int id, const QDate& from, const QDate& to) override;
+
+    bool insertSchedule(Schedule* schedule) override;
+    bool getSchedule(int id, Schedule* schedule) const override;
+    bool getSchedule(const QString& name, Schedule* schedule) const override;
+    bool getSchedules(QVector<Schedule>* schedules) const override;
+
+    bool insertLeavePass(int employee, LeavePass* pass) override;
+    bool updateLeavePass(int employee, const LeavePass& pass) override;
+    bool removeLeavePass(int employee, const QDate& date, int id) override;
+    bool getLeavePasses(int employee, const QDate& from, const QDate& to, QVector<LeavePass>* passes) const override;
+
+    QSqlDatabase database() const override;
+
+private:
+    QSqlDatabase m_db;
+
+    // Prepared once, bulk inserts of the tracker reuse it
+    std::unique_ptr<QSqlQuery> m_insertRecord;
+
+    bool changed(QSqlQuery* query) const;
+    bool setTimes(const QString& column, const QString& condition,
+                  int employee, const QDate& from, const QDate& to, const QTime& time);
+    bool fetchSchedule(const QString& column, const QVariant& value, Schedule* schedule) const;
+};
+
+#endif // WORKTIMESTORAGE_H
@@ -1,13 +1,113 @@
 #include "worktimetracker.h"
+#include "worktimestate.h"
+#include "worktimestorage.h"
+#include "leavepassindex.h"
 #include <QSqlQuery>
 #include <QSqlTableModel>
 #include <QSqlError>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QDebug>
 #include <QSqlRecord>
+#include <QHash>
+#include <QPair>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QSet>
+#include <QStringList>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <vector>
+
+struct WorktimeTracker::ChangeListeners
+{
+    QMutex                     mutex;
+    QWaitCondition             idle;
+    QMap<int, ChangeListener>  listeners;
+    int                        nextId = 0;
+    int                        calls  = 0;     // Notifications in progress
+};
+
+// Leave passes of days inserted into by the trackers sharing it. Indexes are updated
+// by leave pass writes, so overlaps are checked without reading the day again
+struct WorktimeTracker::LeavePassIndexes
+{
+    static const int MAX_DAYS = 1024;   // Per employee, older days are dropped all at once
+
+    QMutex mutex;
+    QHash<int, QMap<QDate, LeavePassIndex>> days;
+};
+
+// Depth of notifications on the current thread, a listener removing
+// listeners can't wait for its own call
+static thread_local int notificationDepth = 0;
+
+// Interned schedules are never freed or changed while the table exists, so references
+// to them stay valid when schedules are reloaded. Lookups may run on several threads
+struct WorktimeTracker::ScheduleTable
+{
+    QMutex                  mutex;
+    QVector<const Schedule*> byId;   // Index 0 is never used since ids start with 1
+    QHash<QString, int>     ids;
+    std::vector<std::unique_ptr<Schedule>> schedules;
+};
+
+struct WorktimeTracker::PublishedState
+{
+    // Loaded and stored atomically. The rest is guarded by the mutex, since
+    // notifyDataChanged() publishes from threads of other connections
+    std::shared_ptr<const WorktimeState> state;
+    QMutex  mutex;
+    quint64 version = 0;
+
+    // Ranges published by notifyDataChanged() which the snapshot
+    // of the tracker hasn't reloaded yet, invalid range is everything
+    QVector<QPair<QDate, QDate>> notified;
+};
+
+struct WorktimeTracker::TransactionState
+{
+    struct Change
+    {
+        int   employee;
+        QDate from, to;
+    };
+
+    QSqlDatabase db;
+    int  depth = 0;
+
+    // Group commit is disabled while maxMutations is 0
+    int  maxMutations = 0;
+    int  maxDelay     = 0;
+    bool group        = false;
+    int  groupMutations = 0;
+    quint64 groupNumber = 0;   // Tells a delayed flush whether its group is still open
+    QElapsedTimer groupTimer;
+
+    // Dates touched by writes which aren't committed yet, they're
+    // refreshed again if the writes are rolled back
+    QVector<Change> changes;
+    int scheduleInserts = 0;
+
+    ~TransactionState()
+    {
+        if (group && !db.commit())
+            db.rollback();
+    }
+};
 
 WorktimeTracker::WorktimeTracker(const QSqlDatabase &db, const QTime &scheduleBegin, const QTime &scheduleEnd, const QTime &lunchBegin, const QTime &lunchEnd)
-    : m_db(db)
+    : m_db(db),
+      m_storage(std::make_shared<SqlWorktimeStorage>(db)),
+      m_schedules(std::make_shared<ScheduleTable>()),
+      m_published(std::make_shared<PublishedState>()),
+      m_summaryCache(std::make_shared<SummaryCache>()),
+      m_calendar(std::make_shared<std::shared_ptr<const WorkingCalendar>>()),
+      m_changeListeners(std::make_shared<ChangeListeners>()),
+      m_leavePassIndexes(std::make_shared<LeavePassIndexes>()),
+      m_transaction(transactionState(db))
 {
     // TODO: Using Q_ASSERT for checking db and time is not safe. It'd be better to hide constructor
     // in private/protected area and create WorktimeTracker instances via static method like
@@ -16,11 +116,12 @@ WorktimeTracker::WorktimeTracker(const QSqlDatabase &db, const QTime &scheduleBe
     Q_ASSERT(m_db.isOpen());
 
     // Use temp schedule object to check if time arguments are valid
-    Schedule temp = { DEFAULT_SCHEDULE_NAME,
-                      scheduleBegin,
-                      scheduleEnd,
-                      lunchBegin,
-                      lunchEnd };
+    Schedule temp;
+    temp.name           = DEFAULT_SCHEDULE_NAME;
+    temp.begin          = scheduleBegin;
+    temp.end            = scheduleEnd;
+    temp.lunchTimeBegin = lunchBegin;
+    temp.lunchTimeEnd   = lunchEnd;
 
     Q_ASSERT(temp.isValid());
 
@@ -29,6 +130,14 @@ WorktimeTracker::WorktimeTracker(const QSqlDatabase &db, const QTime &scheduleBe
     initScheduleTable();
     initLeavepassTable();
     initWorktimeTable();
+    initClosedPeriodTable();
+    initScheduleAssignmentTable();
+    initPunchEventTable();
+    initWorkingCalendarTable();
+
+    loadSchedules();
+    loadWorkingCalendar();
+    m_defaultSchedule.id = scheduleRef(m_defaultSchedule.name).id();
 }
 
 TimeSpan WorktimeTracker::getSummary(const QDate &from, const QDate &to) const
@@ -42,23 +151,93 @@ TimeSpan WorktimeTracker::getSummary(const QDate &from, const QDate &to) const
     if (_from > _to)
         qSwap(_from, _to);
 
+    TimeSpan ts;
+    if (m_summaryCache->find(m_employee, _from, _to, &ts))
+        return ts;
+
+    bool ok;
+    ts = calculateSummary(_from, _to, &ok);
+
+    // Failed queries aren't cached
+    if (ok)
+        m_summaryCache->insert(m_employee, _from, _to, ts);
+
+    return ts;
+}
+
+TimeSpan WorktimeTracker::calculateSummary(const QDate &from, const QDate &to, bool *ok) const
+{
+    // Closed months lying entirely in the range are taken as is,
+    // only the remaining open days are computed
+    auto closed = closedBalances(from, to, ok);
+    if (!*ok)
+        return TimeSpan();
+
+    TimeSpan ts;
+    bool valid = true;
+    QDate begin = from;
+
+    for (auto it = closed.constBegin(); it != closed.constEnd() && *ok && valid; ++it)
+    {
+        if (begin < it.key())
+            ts.seconds += calculateOpenSummary(begin, it.key().addDays(-1), ok, &valid).seconds;
+
+        ts.seconds += it.value();
+        begin = periodEnd(it.key(), SummaryPeriod::Month).addDays(1);
+    }
+
+    if (begin <= to && *ok && valid)
+        ts.seconds += calculateOpenSummary(begin, to, ok, &valid).seconds;
+
+    // Any day with unknown schedule makes the whole summary zero
+    return *ok && valid ? ts : TimeSpan();
+}
+
+TimeSpan WorktimeTracker::calculateOpenSummary(const QDate &from, const QDate &to, bool *ok, bool *valid) const
+{
+    *ok    = true;
+    *valid = true;
+
+    reloadNotifiedRanges();
+
+    auto ts = m_snapshot ? m_snapshot->getSummary(from, to, valid) : calculateRecordSummary(from, to, ok, valid);
+
+    if (workingCalendar() && *ok && *valid)
+        ts.seconds -= scheduledTime(from, to, true, ok);
+
+    return *ok ? ts : TimeSpan();
+}
+
+TimeSpan WorktimeTracker::calculateRecordSummary(const QDate &from, const QDate &to, bool *ok, bool *valid) const
+{
     QSqlQuery query(m_db);
-    query.prepare("SELECT * FROM worktime WHERE Date BETWEEN date(:from) AND date(:to)");
-    query.bindValue(":from", dateToString(_from));
-    query.bindValue(":to", dateToString(_to));
+    query.prepare("SELECT Date, " + scheduleColumnSql() + ", CheckIn, CheckOut FROM worktime "
+                  "WHERE Employee = :employee AND Date BETWEEN date(:from) AND date(:to)");
+    query.bindValue(":employee", m_employee);
+    query.bindValue(":from", dateToString(from));
+    query.bindValue(":to", dateToString(to));
+
+    *ok = execQueryVerbosely(&query);
+    if (!*ok)
+        return TimeSpan();
 
-    if (!execQueryVerbosely(&query))
+    LeavePassMap leavePassMap;
+    *ok = readLeavePasses(from, to, &leavePassMap);
+    if (!*ok)
         return TimeSpan();
 
     TimeSpan ts;
+    auto columns = recordColumns(query);
 
     while (query.next())
     {
-        auto date = query.value("Date").toDate();
+        auto date = stringToDate(query.value(columns.date).toString());
 
-        auto schedule = getSchedule(query.value("Schedule").toString());
-        if (!schedule.isValid())
+        auto schedule = getSchedule(query.value(columns.schedule).toInt());
+        if (!schedule.isValid()) {
+            *valid = false;
             return TimeSpan();
+        }
 
         QList<TimeRange> debtList;
         QList<TimeRange> overtimeList;
@@ -67,14 +246,14 @@ TimeSpan WorktimeTracker::getSummary(const QDate &from, const QDate &to) const
 
         // TODO: exclude lunch time
 
-        auto checkIn = query.value("CheckIn").toTime();
+        auto checkIn = stringToTime(query.value(columns.checkIn).toString());
 
         if (checkIn > schedule.begin)
             debtList.append(TimeRange(schedule.begin, checkIn));
         else
             overtimeList.append(TimeRange(checkIn, schedule.begin));
 
-        auto checkOut = query.value("CheckOut").toTime();
+        auto checkOut = stringToTime(query.value(columns.checkOut).toString());
 
         if (schedule.end > checkOut)
             debtList.append(TimeRange(checkOut, schedule.end));
@@ -83,9 +262,9 @@ TimeSpan WorktimeTracker::getSummary(const QDate &from, const QDate &to) const
 
         // Fill debt and overtime lists by calculating leave passes
 
-        auto leavePasses = getLeavePassList(date);
-        for (auto leavePass : leavePasses)
-            debtList.append(TimeRange(leavePass.from, leavePass.to));
+        int i = leavePassMap.indexOf(date);
+        for (auto lp = leavePassMap.begin(i); lp != leavePassMap.end(i); ++lp)
+            debtList.append(TimeRange(lp->from, lp->to));
 
         // Time ranges can overlap each other so they have to
         // be merged by unite()
@@ -102,6 +281,138 @@ TimeSpan WorktimeTracker::getSummary(const QDate &from, const QDate &to) const
     return ts;
 }
 
+qint64 WorktimeTracker::scheduledTime(const QDate &from, const QDate &to, bool missingDaysOnly, bool *ok) const
+{
+    // Days between records are split into runs with the same schedule by schedule
+    // assignments, working days of each run are counted by the calendar
+
+    QVector<qint32> days, scheduleIds;
+
+    reloadNotifiedRanges();
+
+    if (m_snapshot) {
+        int first = m_snapshot->lowerBound(qint32(from.toJulianDay()));
+        int last  = m_snapshot->lowerBound(qint32(to.toJulianDay()) + 1);
+        days        = m_snapshot->days().mid(first, last - first);
+        scheduleIds = m_snapshot->scheduleIds().mid(first, last - first);
+    }
+    else {
+        QSqlQuery records(m_db);
+        records.setForwardOnly(true);
+        records.prepare("SELECT Date, " + scheduleColumnSql() + " FROM worktime "
+                        "WHERE Employee = :employee AND Date BETWEEN date(:from) AND date(:to) ORDER BY Date");
+        records.bindValue(":employee", m_employee);
+        records.bindValue(":from", dateToString(from));
+        records.bindValue(":to", dateToString(to));
+
+        *ok = execQueryVerbosely(&records);
+        if (!*ok)
+            return 0;
+
+        while (records.next()) {
+            days.append(qint32(stringToDate(records.value(0).toString()).toJulianDay()));
+            scheduleIds.append(records.value(1).toInt());
+        }
+    }
+
+    struct Assignment
+    {
+        qint64 begin, end;
+        int    schedule;
+    };
+    QVector<Assignment> assignments;
+
+    auto calendar = workingCalendar();
+
+    if (calendar) {
+        QSqlQuery query(m_db);
+        query.prepare("SELECT Begin, End, Schedule FROM scheduleassignment "
+                      "WHERE Employee = :employee AND End >= :from AND Begin <= :to ORDER BY Begin");
+        query.bindValue(":employee", m_employee);
+        query.bindValue(":from", dateToString(from));
+        query.bindValue(":to", dateToString(to));
+
+        *ok = execQueryVerbosely(&query);
+        if (!*ok)
+            return 0;
+
+        while (query.next())
+            assignments.append({stringToDate(query.value(0).toString()).toJulianDay(),
+                                stringToDate(query.value(1).toString()).toJulianDay(),
+                                query.value(2).toInt()});
+    }
+
+    *ok = true;
+
+    auto length = [this](int id) {
+        auto s = getSchedule(id);
+        if (!s.isValid())
+            s = m_defaultSchedule;
+        return qint64(s.begin.secsTo(s.end));
+    };
+
+    qint64 total = 0;
+    int schedule = getScheduleBeforeDate(from).id;
+    int a = 0;
+
+    qint64 day = from.toJulianDay();
+    qint64 end = to.toJulianDay();
+
+    for (int r = 0; r <= days.size(); ++r)
+    {
+        qint64 next = r < days.size() ? days[r] : end + 1;
+
+        // Working days without records up to the next record
+        while (calendar && day < next)
+        {
+            while (a < assignments.size() && assignments[a].end < day)
+                ++a;
+
+            qint64 last = next - 1;
+            int id = schedule;
+
+            if (a < assignments.size() && assignments[a].begin <= day) {
+                last = qMin(last, assignments[a].end);
+                id   = assignments[a].schedule;
+            }
+            else if (a < assignments.size()) {
+                last = qMin(last, assignments[a].begin - 1);
+            }
+
+            total += calendar->workingDays(QDate::fromJulianDay(day), QDate::fromJulianDay(last)) * length(id);
+            day = last + 1;
+        }
+
+        if (r == days.size())
+            break;
+
+        auto date = QDate::fromJulianDay(next);
+        if (!missingDaysOnly && (!calendar || calendar->isWorkingDay(date)))
+            total += length(scheduleIds[r]);
+
+        schedule = scheduleIds[r];
+        day = next + 1;
+    }
+
+    return total;
+}
+
+TimeSpan WorktimeTracker::getExpectedTime(const QDate &from, const QDate &to) const
+{
+    if (!from.isValid())
+        return TimeSpan();
+
+    auto _from = from;
+    auto _to   = to.isValid() ? to : _from;
+
+    if (_from > _to)
+        qSwap(_from, _to);
+
+    bool ok;
+    auto seconds = scheduledTime(_from, _to, false, &ok);
+    return ok ? TimeSpan(seconds) : TimeSpan();
+}
+
 TimeSpan WorktimeTracker::getSummary(int month, int year)
 {
     if (month < 1 || month > 12)
@@ -115,399 +426,2317 @@ TimeSpan WorktimeTracker::getSummary(int month, int year)
     return getSummary(monthStart, monthEnd);
 }
 
-WorktimeTracker::Record WorktimeTracker::getRecord(const QDate &date) const
+QMap<QDate, TimeSpan> WorktimeTracker::getSummarySeries(const QDate &from, const QDate &to, SummaryPeriod period) const
 {
-    if (!date.isValid())
-        return Record();
+    if (!from.isValid() || !to.isValid())
+        return QMap<QDate, TimeSpan>();
 
-    QSqlQuery query(m_db);
-    query.prepare("SELECT * FROM worktime WHERE Date = date(:d)");
-    query.bindValue(":d", dateToString(date));
+    QDate _from = qMin(from, to);
+    QDate _to   = qMax(from, to);
 
-    if (!execQueryVerbosely(&query))
-        return Record();
+    // The same as getSummary(): only a month period can cover a closed month
+    bool ok = true;
+    QMap<QDate, qint64> closed;
+    if (m_snapshot && period == SummaryPeriod::Month)
+        closed = closedBalances(_from, _to, &ok);
 
-    if (!query.next())
-        return Record();
+    QMap<QDate, TimeSpan> series;
+    for (auto p = periodBegin(_from, period); p <= _to; p = periodEnd(p, period).addDays(1))
+    {
+        TimeSpan ts;
+        bool valid = true;
 
-    Record r;
-    r.schedule = getSchedule(query.value("Schedule").toString());
-    r.date = query.value("Date").toDate();
-    r.checkIn = query.value("CheckIn").toTime();
-    r.checkOut = query.value("CheckOut").toTime();
+        // Snapshot summary with missing working days of the calendar
+        if (m_snapshot && closed.contains(p))
+            ts.seconds = closed.value(p);
+        else if (m_snapshot && ok)
+            ts = calculateOpenSummary(qMax(p, _from), qMin(periodEnd(p, period), _to), &ok, &valid);
 
-    return r;
-}
+        series.insert(p, m_snapshot && ok && valid ? ts : TimeSpan());
+    }
 
-QList<WorktimeTracker::Record> WorktimeTracker::getRecords(const QDate &from, const QDate &to) const
-{
-    if (!from.isValid() || !to.isValid())
-        return QList<Record>();
+    if (m_snapshot)
+        return series;
 
-    if (from == to)
-        return QList<Record>({getRecord(from)});
+    // The same as getSummary(): summary of a period is invalid if any schedule is unknown
+    QSet<QDate> invalid;
 
-    QDate _from = qMin(from, to);
-    QDate _to   = qMax(from, to);
+    for (const auto& day : getDayBalances({m_employee}, _from, _to, period))
+    {
+        auto p = periodBegin(day.date, period);
+        if (!day.valid)
+            invalid.insert(p);
+        else
+            series[p].seconds += day.overtime - day.debt;
+    }
 
-    QSqlQuery query(m_db);
-    query.prepare(QString("SELECT * FROM worktime WHERE Date BETWEEN date(:from) AND date(:to)"));
-    query.bindValue(":from", dateToString(_from));
-    query.bindValue(":to", dateToString(_to));
+    for (auto p : invalid)
+        series[p] = TimeSpan();
 
-    if (!execQueryVerbosely(&query))
-        return QList<Record>();
+    return series;
+}
 
-    QList<Record> records;
+QMap<int, TimeSpan> WorktimeTracker::getSummaries(const QList<int> &employees, const QDate &from, const QDate &to) const
+{
+    QMap<int, TimeSpan> summaries;
 
-    while (query.next())
+    if (!from.isValid() || employees.isEmpty())
+        return summaries;
+
+    for (int employee : employees)
+        summaries.insert(employee, TimeSpan());
+
+    QSet<int> invalid;
+
+    // The whole range covers the same closed months as its month periods
+    for (const auto& day : getDayBalances(employees, from, to, SummaryPeriod::Month))
     {
-        Record r;
-        r.schedule = getSchedule(query.value("Schedule").toString());
-        r.date = query.value("Date").toDate();
-        r.checkIn = query.value("CheckIn").toTime();
-        r.checkOut = query.value("CheckOut").toTime();
-        records.append(r);
+        // The same as getSummary(): summary is invalid if any schedule is unknown
+        if (!day.valid)
+            invalid.insert(day.employee);
+        else
+            summaries[day.employee].seconds += day.overtime - day.debt;
     }
 
-    return records;
+    for (int employee : invalid)
+        summaries[employee] = TimeSpan();
+
+    return summaries;
 }
 
-bool WorktimeTracker::insertRecord(const QDate &date, const QTime &checkIn, const QTime &checkOut, const QString &schedule)
+QVector<WorktimeTracker::DayBalance> WorktimeTracker::getDayBalances(const QList<int> &employees, const QDate &from, const QDate &to) const
 {
-    if (schedule.isEmpty() || !date.isValid())
-        return false;
+    if (!from.isValid() || employees.isEmpty())
+        return QVector<DayBalance>();
 
-    // If there is no schedule with this name
+    auto _from = from;
+    auto _to   = to.isValid() ? to : _from;
 
-    auto s = getSchedule(schedule);
+    if (_from > _to)
+        qSwap(_from, _to);
 
-    if (schedule != defaultSchedule().name && !getSchedule(schedule).isValid())
-        return false;
+    // Employee ids are integers, so they're put into query text directly
+    // instead of binding thousands of values
+    QStringList ids;
+    for (int employee : employees)
+        ids.append(QString::number(employee));
 
-    if (!TimeRange::valid(checkIn, checkOut) || TimeRange::inverted(checkIn, checkOut))
-        return false;
+    QString condition = QString(" WHERE Employee IN (%1) AND Date BETWEEN date(:from) AND date(:to)").arg(ids.join(","));
 
-    QSqlQuery query(m_db);
-    query.prepare("INSERT INTO worktime VALUES (:d, :schedule, :arrival, :leaving)");
-    query.bindValue(":d", dateToString(date));
-    query.bindValue(":schedule", schedule);
-    query.bindValue(":arrival", timeToString(checkIn));
-    query.bindValue(":leaving", timeToString(checkOut));
+    QSqlQuery records(m_db);
+    records.setForwardOnly(true);
+    records.prepare("SELECT Employee, Date, " + scheduleColumnSql() + ", CheckIn, CheckOut FROM worktime" + condition +
+                    " ORDER BY Employee, Date");
 
-    return execQueryVerbosely(&query);
-}
+    QSqlQuery leavePasses(m_db);
+    leavePasses.setForwardOnly(true);
+    leavePasses.prepare("SELECT Employee, Date, Begin, End FROM leavepass" + condition +
+                        " ORDER BY Employee, Date, Id");
 
-bool WorktimeTracker::insertRecord(const QDate &date)
-{
-    Schedule schedule = getScheduleBeforeDate(date);
-    if (!schedule.isValid())
-        schedule = defaultSchedule();
+    for (auto query : {&records, &leavePasses}) {
+        query->bindValue(":from", dateToString(_from));
+        query->bindValue(":to", dateToString(_to));
+    }
 
-    return insertRecord(date, schedule.begin, schedule.end, schedule.name);
-}
+    if (!execQueryVerbosely(&records) || !execQueryVerbosely(&leavePasses))
+        return QVector<DayBalance>();
 
-bool WorktimeTracker::setSchedule(const QString &schedule, const QDate &from, const QDate &to)
-{
-    if (schedule.isEmpty())
-        return false;
+    auto seconds = [this](const QVariant& value) {
+        return stringToTime(value.toString()).msecsSinceStartOfDay() / 1000;
+    };
 
-    auto _from  = from.isValid() ? from : QDate::currentDate();
-    auto _to    = to.isValid() ? to : _from;
+    // Both queries are sorted by (employee, date), so leave passes are merged
+    // into records in one pass
+    typedef QPair<int, QString> Key;
 
-    return updateColumnData("worktime", "Schedule", _from, _to, schedule);
-}
+    bool hasLeavePass = leavePasses.next();
+    Key  leavePassKey = hasLeavePass ? Key(leavePasses.value(0).toInt(), leavePasses.value(1).toString()) : Key();
 
-bool WorktimeTracker::insertSchedule(const QString &name, const QTime &begin, const QTime &end, const QTime &lunchBegin, const QTime &lunchEnd)
-{
-    if (name.isEmpty())
-        return false;
+    QVector<DayBalance> days;
+    QVector<int> scheduleIds;
+    QVarLengthArray<qint32, 8> leavePassBegins, leavePassEnds;
 
-    TimeRange schedule(begin, end);
-    TimeRange lunch(lunchBegin, lunchEnd);
+    while (records.next())
+    {
+        Key key(records.value(0).toInt(), records.value(1).toString());
 
-    if (!schedule.isValid())
-        return false;
+        leavePassBegins.clear();
+        leavePassEnds.clear();
 
-    if (!lunch.isValid() || !schedule.contains(lunch))
-        return false;
+        while (hasLeavePass && !(key < leavePassKey))
+        {
+            if (leavePassKey == key) {
+                leavePassBegins.append(seconds(leavePasses.value(2)));
+                leavePassEnds.append(seconds(leavePasses.value(3)));
+            }
 
-    QSqlQuery query(m_db);
+            hasLeavePass = leavePasses.next();
+            leavePassKey = hasLeavePass ? Key(leavePasses.value(0).toInt(), leavePasses.value(1).toString()) : Key();
+        }
 
-    query.prepare("INSERT INTO schedule VALUES(:schedule,:begin,:end,:lunchBegin,:lunchEnd)");
-    query.bindValue(":schedule", name);
-    query.bindValue(":begin", timeToString(begin));
-    query.bindValue(":end", timeToString(end));
-    query.bindValue(":lunchBegin", timeToString(lunchBegin));
-    query.bindValue(":lunchEnd", timeToString(lunchEnd));
-    return execQueryVerbosely(&query);
-}
+        DayBalance day;
+        day.employee = key.first;
+        day.date     = stringToDate(key.second);
+        day.debt     = 0;
+        day.overtime = 0;
+
+        auto schedule = scheduleRef(records.value(2).toInt());
+        day.valid = schedule.isValid();
+        scheduleIds.append(records.value(2).toInt());
+
+        if (day.valid) {
+            auto balance = WorktimeSnapshot::dayDebtOvertime(seconds(records.value(3)),
+                                                             seconds(records.value(4)),
+                                                             schedule->begin.msecsSinceStartOfDay() / 1000,
+                                                             schedule->end.msecsSinceStartOfDay() / 1000,
+                                                             leavePassBegins.constData(),
+                                                             leavePassEnds.constData(),
+                                                             leavePassBegins.size());
+            day.debt     = qint32(balance.debt);
+            day.overtime = qint32(balance.overtime);
+        }
 
-bool WorktimeTracker::setCheckIn(const QTime &time, const QDate &from, const QDate &to)
-{
-    if (!time.isValid())
-        return false;
+        days.append(day);
+    }
 
-    auto _from = from.isValid() ? from : QDate::currentDate();
-    auto _to   = to.isValid() ? to : _from;
+    auto calendar = workingCalendar();
+    if (!calendar)
+        return days;
 
-    return updateColumnData("worktime",
-                            "CheckIn",
-                            _from,
-                            _to,
-                            timeToString(time),
-                            "CheckOut >= time(:data)");
+    bool ok;
+    auto missing = missingDayBalances(employees, _from, _to, *calendar, days, scheduleIds, &ok);
+    return ok ? missing : QVector<DayBalance>();
 }
 
-bool WorktimeTracker::setCheckOut(const QTime &time, const QDate &from, const QDate &to)
+QVector<WorktimeTracker::DayBalance> WorktimeTracker::getDayBalances(const QList<int> &employees, const QDate &from, const QDate &to,
+                                                                     SummaryPeriod period) const
 {
-    if (!time.isValid())
-        return false;
+    auto days = getDayBalances(employees, from, to);
 
-    auto _from = from.isValid() ? from : QDate::currentDate();
+    // Days and weeks never cover a whole month
+    if (period != SummaryPeriod::Month || !from.isValid() || employees.isEmpty())
+        return days;
+
+    auto _from = from;
     auto _to   = to.isValid() ? to : _from;
 
-    return updateColumnData("worktime",
-                            "CheckOut",
-                            _from,
-                            _to,
-                            timeToString(time),
-                            "CheckIn <= time(:data)");
-}
+    if (_from > _to)
+        qSwap(_from, _to);
 
-QList<WorktimeTracker::LeavePass> WorktimeTracker::getLeavePassList(const QDate &date) const
-{
-    if (!date.isValid())
-        return QList<LeavePass>();
+    bool ok;
+    auto closed = closedBalances(employees, _from, _to, &ok);
+    if (!ok)
+        return QVector<DayBalance>();
 
-    QSqlQuery query(m_db);
-    query.prepare("SELECT * FROM leavepass WHERE Date = date(:d)");
-    query.bindValue(":d", dateToString(date));
-    if (!execQueryVerbosely(&query))
-        return QList<LeavePass>();
+    if (closed.isEmpty())
+        return days;
 
-    QList<LeavePass> leavePassList;
-    while (query.next())
+    auto sorted = employees;
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    // Frozen balance is kept as the debt or the overtime of the month begin
+    auto frozen = [](int employee, const QDate& month, qint64 balance) {
+        return DayBalance{employee, month, qint32(qMax(-balance, qint64(0))), qint32(qMax(balance, qint64(0))), true};
+    };
+
+    QVector<DayBalance> merged;
+    merged.reserve(days.size());
+
+    int d = 0;
+    for (int employee : sorted)
     {
-        LeavePass lp;
-        lp.date    = stringToDate(query.value("Date").toString());
-        lp.id      = query.value("Id").toInt();
-        lp.from    = stringToTime(query.value("Begin").toString());
-        lp.to      = stringToTime(query.value("End").toString());
-        lp.comment = query.value("Comment").toString();
-        leavePassList.append(lp);
+        const auto months = closed.value(employee);
+        auto month = months.constBegin();
+
+        for (; d < days.size() && days[d].employee == employee; ++d)
+        {
+            for (; month != months.constEnd() && month.key() <= days[d].date; ++month)
+                merged.append(frozen(employee, month.key(), month.value()));
+
+            if (!months.contains(periodBegin(days[d].date, SummaryPeriod::Month)))
+                merged.append(days[d]);
+        }
+
+        for (; month != months.constEnd(); ++month)
+            merged.append(frozen(employee, month.key(), month.value()));
     }
 
-    return leavePassList;
+    return merged;
 }
 
-bool WorktimeTracker::insertLeavePass(const QTime &from, const QTime &to, const QDate &date, const QString &comment)
+QVector<WorktimeTracker::DayBalance> WorktimeTracker::missingDayBalances(const QList<int> &employees, const QDate &from, const QDate &to,
+                                                                         const WorkingCalendar &calendar,
+                                                                         const QVector<DayBalance> &days,
+                                                                         const QVector<int> &scheduleIds, bool *ok) const
 {
-    // TODO: constraint from and to with schedule begin and end of this date
+    // Working days without records are inserted between record days of each employee.
+    // Their schedule is the assigned one or the one of the previous record, the same
+    // as in scheduledTime()
+
+    QStringList ids;
+    for (int employee : employees)
+        ids.append(QString::number(employee));
+
+    QSqlQuery previous(m_db);
+    previous.setForwardOnly(true);
+    previous.prepare(QString("SELECT Employee, " + scheduleColumnSql() + " FROM worktime WHERE Employee IN (%1) AND "
+                             "Date = (SELECT MAX(p.Date) FROM worktime p WHERE p.Employee = worktime.Employee AND p.Date < date(:from))")
+                     .arg(ids.join(",")));
+    previous.bindValue(":from", dateToString(from));
+
+    QSqlQuery assignments(m_db);
+    assignments.setForwardOnly(true);
+    assignments.prepare(QString("SELECT Employee, Begin, End, Schedule FROM scheduleassignment "
+                                "WHERE Employee IN (%1) AND End >= :from AND Begin <= :to ORDER BY Employee, Begin")
+                        .arg(ids.join(",")));
+    assignments.bindValue(":from", dateToString(from));
+    assignments.bindValue(":to", dateToString(to));
+
+    *ok = execQueryVerbosely(&previous) && execQueryVerbosely(&assignments);
+    if (!*ok)
+        return QVector<DayBalance>();
+
+    QHash<int, int> previousSchedules;
+    while (previous.next())
+        previousSchedules.insert(previous.value(0).toInt(), previous.value(1).toInt());
+
+    struct Assignment
+    {
+        qint64 begin, end;
+        int    schedule;
+    };
+    QHash<int, QVector<Assignment>> assigned;
+    while (assignments.next())
+        assigned[assignments.value(0).toInt()].append({stringToDate(assignments.value(1).toString()).toJulianDay(),
+                                                       stringToDate(assignments.value(2).toString()).toJulianDay(),
+                                                       assignments.value(3).toInt()});
+
+    auto length = [this](int id) {
+        auto s = getSchedule(id);
+        if (!s.isValid())
+            s = m_defaultSchedule;
+        return qint32(s.begin.secsTo(s.end));
+    };
+
+    auto sorted = employees;
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    QVector<DayBalance> merged;
+    merged.reserve(days.size());
+
+    int r = 0;
+    for (int employee : sorted)
+    {
+        int schedule = previousSchedules.value(employee);
+        const auto& intervals = assigned[employee];
+        int a = 0;
 
-    // TODO: return false if there's already a leave pass with the same time
+        qint64 day = from.toJulianDay();
+        qint64 end = to.toJulianDay();
 
-    // insertLeavePass(QTime(8,0), QTime(8,10)); -> return true
-    // insertLeavePass(QTime(8,0), QTime(8,10)); -> return false
+        for (;;)
+        {
+            bool record = r < days.size() && days[r].employee == employee;
+            qint64 next = record ? days[r].date.toJulianDay() : end + 1;
 
-    if (!from.isValid() || !to.isValid())
-        return false;
+            for (; day < next; ++day)
+            {
+                auto date = QDate::fromJulianDay(day);
+                if (!calendar.isWorkingDay(date))
+                    continue;
 
-    QSqlQuery query(m_db);
+                while (a < intervals.size() && intervals[a].end < day)
+                    ++a;
 
-    auto _date = date.isValid() ? date : QDate::currentDate();
+                int id = a < intervals.size() && intervals[a].begin <= day ? intervals[a].schedule : schedule;
+                merged.append({employee, date, length(id), 0, true});
+            }
 
-    query.prepare("SELECT Count(*) FROM leavepass WHERE Date = date(:d) ORDER BY Date DESC");
-    query.bindValue(":d", dateToString(_date));
-    if (execQueryVerbosely(&query))
-    {
-        if (query.next())
-        {
-            bool ok;
-            int count = query.value(0).toInt(&ok);
-            if (!ok) return false;
-
-            query.prepare("INSERT INTO leavepass VALUES (:d, :id, :begin, :end, :comment)");
-            query.bindValue(":d", dateToString(_date));
-            query.bindValue(":id", QString::number(count));
-            query.bindValue(":begin", timeToString(from));
-            query.bindValue(":end", timeToString(to));
-            query.bindValue(":comment", comment);
-
-            return execQueryVerbosely(&query);
+            if (!record)
+                break;
+
+            merged.append(days[r]);
+            schedule = scheduleIds[r];
+            day = next + 1;
+            ++r;
         }
     }
 
-    return false;
+    return merged;
 }
 
-bool WorktimeTracker::setLeavePassBegin(const QTime &time, const QDate &date, int id)
+WorktimeTracker::Record WorktimeTracker::getRecord(const QDate &date) const
 {
-    if (!time.isValid())
-        return false;
+    CompactRecord r;
+    if (!date.isValid() || !m_storage->getRecord(m_employee, date, &r))
+        return Record();
 
-    auto _date = date.isValid() ? date : QDate::currentDate();
-    return updateLeavePassData("Begin", _date, id, timeToString(time), "End >= time(:data)");
+    return toRecord(r);
 }
 
-bool WorktimeTracker::setLeavePassEnd(const QTime &time, const QDate &date, int id)
+QList<WorktimeTracker::Record> WorktimeTracker::getRecords(const QDate &from, const QDate &to) const
 {
-    if (!time.isValid())
-        return false;
+    if (!from.isValid() || !to.isValid())
+        return QList<Record>();
 
-    auto _date = date.isValid() ? date : QDate::currentDate();
-    return updateLeavePassData("End", _date, id, timeToString(time), "Begin <= time(:data)");
-}
+    if (from == to)
+        return QList<Record>({getRecord(from)});
 
-bool WorktimeTracker::setLeavePassComment(const QString &comment, const QDate &date, int id)
-{
-    auto _date = date.isValid() ? date : QDate::currentDate();
-    return updateLeavePassData("Comment", _date, id, comment);
-}
+    QVector<CompactRecord> compact;
+    if (!m_storage->getRecords(m_employee, from, to, &compact))
+        return QList<Record>();
 
-WorktimeTracker::Schedule WorktimeTracker::defaultSchedule() const
-{
-    return m_defaultSchedule;
+    QList<Record> records;
+    for (const auto& r : compact)
+        records.append(toRecord(r));
+
+    return records;
 }
 
-void WorktimeTracker::initWorktimeTable()
+QList<WorktimeTracker::Record> WorktimeTracker::getRecordPage(const QDate &cursor, int count, PageDirection direction, QDate *next) const
 {
-    QSqlQuery query(m_db);
+    // 'next' may refer to 'cursor', so it's set only in the end
+    QDate nextCursor;
 
-    execQueryVerbosely(&query, "CREATE TABLE worktime ("
-                               "    Date TEXT PRIMARY KEY NOT NULL,"
-                               "    Schedule TEXT,"
-                               "    CheckIn TEXT,"
-                               "    CheckOut TEXT"
-                               ")");
-}
+    bool forward = direction == PageDirection::Forward;
 
-void WorktimeTracker::initLeavepassTable()
-{
-    QSqlQuery query(m_db);
+    QString queryText = "SELECT Date, " + scheduleColumnSql() + ", CheckIn, CheckOut FROM worktime WHERE Employee = :employee";
+    if (cursor.isValid())
+        queryText += forward ? " AND Date > date(:cursor)" : " AND Date < date(:cursor)";
+    queryText += forward ? " ORDER BY Date" : " ORDER BY Date DESC";
 
-    execQueryVerbosely(&query, "CREATE TABLE leavepass ("
+    // One more record tells if there is the next page
+    queryText += " LIMIT :limit";
+
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(queryText);
+    query.bindValue(":employee", m_employee);
+    query.bindValue(":limit", count + 1);
+    if (cursor.isValid())
+        query.bindValue(":cursor", dateToString(cursor));
+
+    QList<Record> records;
+
+    if (count > 0 && execQueryVerbosely(&query))
+    {
+        auto columns = recordColumns(query);
+        while (query.next())
+            records.append(readRecord(query, columns));
+    }
+
+    bool more = records.size() > count;
+    if (more)
+        records.removeLast();
+
+    if (!forward)
+        std::reverse(records.begin(), records.end());
+
+    if (more)
+        nextCursor = forward ? records.last().date : records.first().date;
+
+    if (next)
+        *next = nextCursor;
+
+    return records;
+}
+
+QVector<WorktimeTracker::CompactRecord> WorktimeTracker::getCompactRecords(const QDate &from, const QDate &to) const
+{
+    if (!from.isValid() || !to.isValid())
+        return QVector<CompactRecord>();
+
+    QVector<CompactRecord> records;
+    if (!m_storage->getRecords(m_employee, from, to, &records))
+        return QVector<CompactRecord>();
+
+    return records;
+}
+
+WorktimeTracker::Record WorktimeTracker::toRecord(const CompactRecord &r) const
+{
+    Record record;
+    record.date     = r.date();
+    record.schedule = scheduleRef(r.scheduleId());
+    record.checkIn  = r.checkInTime();
+    record.checkOut = r.checkOutTime();
+    return record;
+}
+
+bool WorktimeTracker::insertRecord(const QDate &date, const QTime &checkIn, const QTime &checkOut, const QString &schedule)
+{
+    if (schedule.isEmpty() || !date.isValid())
+        return false;
+
+    // If there is no schedule with this name
+    auto s = getSchedule(schedule);
+    if (!s.isValid())
+        return false;
+
+    if (!TimeRange::valid(checkIn, checkOut) || TimeRange::inverted(checkIn, checkOut))
+        return false;
+
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    if (hasClosedMonths(date, date))
+        return false;
+
+    Record r;
+    r.date     = date;
+    r.schedule = scheduleRef(s.id);
+    r.checkIn  = checkIn;
+    r.checkOut = checkOut;
+
+    if (!m_storage->insertRecord(m_employee, CompactRecord::fromRecord(r)) || !keepRecordSchedule(s.id, date))
+        return false;
+
+    dataChanged(date);
+    return transaction.commit();
+}
+
+bool WorktimeTracker::insertRecord(const QDate &date)
+{
+    Schedule schedule = getScheduleForDate(date);
+    return insertRecord(date, schedule.begin, schedule.end, schedule.name);
+}
+
+bool WorktimeTracker::insertRecords(const QList<Record> &records, QList<int> *rejected)
+{
+    // All records are written in one transaction, the storage reuses its prepared
+    // statement. Invalid or conflicting records don't abort the whole batch, their
+    // indexes are returned via 'rejected'
+
+    QSet<QDate> closed;
+    for (const auto& month : closedMonths())
+        closed.insert(month);
+
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    QDate first, last;
+    bool assignments = hasScheduleAssignments();
+
+    for (int i = 0; i < records.size(); ++i)
+    {
+        const auto& r = records[i];
+
+        bool valid = r.date.isValid() && r.schedule.isValid() && getSchedule(r.schedule.id()).isValid() &&
+                     TimeRange::valid(r.checkIn, r.checkOut) && !TimeRange::inverted(r.checkIn, r.checkOut) &&
+                     !closed.contains(periodBegin(r.date, SummaryPeriod::Month));
+
+        if (valid) {
+            valid = m_storage->insertRecord(m_employee, CompactRecord::fromRecord(r)) &&
+                    (!assignments || keepRecordSchedule(r.schedule.id(), r.date));
+        }
+
+        if (valid) {
+            first = first.isValid() ? qMin(first, r.date) : r.date;
+            last  = last.isValid() ? qMax(last, r.date) : r.date;
+        }
+
+        if (!valid && rejected)
+            rejected->append(i);
+    }
+
+    if (first.isValid())
+        dataChanged(first, last);
+
+    return transaction.commit();
+}
+
+bool WorktimeTracker::fillMissingDays(const QDate &from, const QDate &to, const std::function<bool (const QDate &)> &isWorkingDay)
+{
+    if (!from.isValid() || !to.isValid())
+        return false;
+
+    QDate _from = qMin(from, to);
+    QDate _to   = qMax(from, to);
+
+    // Assignments intersecting the range are sorted and don't overlap, so they are
+    // walked along with the days
+    struct Assignment
+    {
+        QDate begin, end;
+        int   schedule;
+    };
+    QVector<Assignment> assignments;
+
+    QSqlQuery query(m_db);
+    query.prepare("SELECT Begin, End, Schedule FROM scheduleassignment "
+                  "WHERE Employee = :employee AND End >= :from AND Begin <= :to ORDER BY Begin");
+    query.bindValue(":employee", m_employee);
+    query.bindValue(":from", dateToString(_from));
+    query.bindValue(":to", dateToString(_to));
+
+    if (!execQueryVerbosely(&query))
+        return false;
+
+    while (query.next())
+        assignments.append({stringToDate(query.value(0).toString()),
+                            stringToDate(query.value(1).toString()),
+                            query.value(2).toInt()});
+
+    // Every day of the range is joined with its record, missing days have null
+    // record date. Schedule of a missing day is the assigned one or the one of
+    // the last record before it
+    query.setForwardOnly(true);
+    query.prepare("WITH RECURSIVE days(Day) AS ("
+                  "    SELECT date(:from) UNION ALL SELECT date(Day, '+1 day') FROM days WHERE Day < date(:to)"
+                  ") "
+                  "SELECT days.Day, worktime.Date IS NULL, " + scheduleColumnSql() + " FROM days "
+                  "LEFT JOIN worktime ON worktime.Employee = :employee AND worktime.Date = days.Day "
+                  "ORDER BY days.Day");
+    query.bindValue(":employee", m_employee);
+    query.bindValue(":from", dateToString(_from));
+    query.bindValue(":to", dateToString(_to));
+
+    if (!execQueryVerbosely(&query))
+        return false;
+
+    Schedule schedule = getScheduleBeforeDate(_from);
+    QList<Record> records;
+    int a = 0;
+
+    while (query.next())
+    {
+        if (!query.value(1).toBool()) {
+            schedule = getSchedule(query.value(2).toInt());
+            continue;
+        }
+
+        auto date = stringToDate(query.value(0).toString());
+        if (isWorkingDay && !isWorkingDay(date))
+            continue;
+
+        while (a < assignments.size() && assignments[a].end < date)
+            ++a;
+
+        Schedule assigned;
+        if (a < assignments.size() && assignments[a].begin <= date)
+            assigned = getSchedule(assignments[a].schedule);
+
+        const auto& s = assigned.isValid() ? assigned : schedule.isValid() ? schedule : m_defaultSchedule;
+
+        Record r;
+        r.date     = date;
+        r.schedule = scheduleRef(s.id);
+        r.checkIn  = s.begin;
+        r.checkOut = s.end;
+        records.append(r);
+    }
+
+    // Closed months reject their records, that's not an error here
+    return records.isEmpty() || insertRecords(records);
+}
+
+bool WorktimeTracker::addPunch(const QDateTime &time, PunchKind kind, const QString &source)
+{
+    if (!time.isValid())
+        return false;
+
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    QSqlQuery query(m_db);
+    query.prepare("INSERT INTO punchevent (Time, Kind, Source, Employee) "
+                  "VALUES (:time, :kind, :source, :employee)");
+    query.bindValue(":time", dateToString(time.date()) + "T" + timeToString(time.time()));
+    query.bindValue(":kind", int(kind));
+    query.bindValue(":source", source);
+    query.bindValue(":employee", m_employee);
+
+    return execQueryVerbosely(&query) && transaction.commit();
+}
+
+int WorktimeTracker::aggregatePunches()
+{
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return -1;
+
+    // Days with punches after the high-water mark
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT Employee, date(Time), MAX(Id), COUNT(*) FROM punchevent "
+                  "WHERE Id > (SELECT COALESCE(MAX(LastId), 0) FROM punchmark) "
+                  "GROUP BY Employee, date(Time)");
+
+    if (!execQueryVerbosely(&query))
+        return -1;
+
+    QVector<QPair<int, QDate>> days;
+    qint64 last  = 0;
+    int    count = 0;
+
+    while (query.next())
+    {
+        days.append(qMakePair(query.value(0).toInt(), stringToDate(query.value(1).toString())));
+        last   = qMax(last, qint64(query.value(2).toLongLong()));
+        count += query.value(3).toInt();
+    }
+    query.finish();
+
+    // Days skipped by previous aggregations since their month was closed
+    if (!execQueryVerbosely(&query, "SELECT Employee, Date FROM punchbacklog"))
+        return -1;
+
+    while (query.next())
+    {
+        auto day = qMakePair(query.value(0).toInt(), stringToDate(query.value(1).toString()));
+        if (!days.contains(day))
+            days.append(day);
+    }
+    query.finish();
+
+    QVector<QPair<int, QDate>> aggregated;
+    bool ok = true;
+
+    for (int i = 0; i < days.size() && ok; ++i)
+    {
+        const auto& day = days[i];
+        bool closed = hasClosedMonths(day.first, day.second, day.second);
+
+        query.prepare(closed ? "INSERT OR IGNORE INTO punchbacklog (Employee, Date) VALUES (:employee, :d)"
+                             : "DELETE FROM punchbacklog WHERE Employee = :employee AND Date = :d");
+        query.bindValue(":employee", day.first);
+        query.bindValue(":d", dateToString(day.second));
+
+        ok = execQueryVerbosely(&query) && (closed || aggregatePunchDay(day.first, day.second));
+        if (!closed)
+            aggregated.append(day);
+    }
+
+    if (ok && count > 0) {
+        query.prepare("INSERT OR REPLACE INTO punchmark (Id, LastId) VALUES (0, :id)");
+        query.bindValue(":id", last);
+        ok = execQueryVerbosely(&query);
+    }
+
+    if (!ok)
+        return -1;
+
+    for (const auto& day : aggregated)
+        dataChanged(day.first, day.second, day.second);
+
+    return transaction.commit() ? count : -1;
+}
+
+qint64 WorktimeTracker::punchHighWaterMark() const
+{
+    QSqlQuery query(m_db);
+    if (!execQueryVerbosely(&query, "SELECT COALESCE(MAX(LastId), 0) FROM punchmark") || !query.next())
+        return 0;
+
+    return query.value(0).toLongLong();
+}
+
+bool WorktimeTracker::setSchedule(const QString &schedule, const QDate &from, const QDate &to)
+{
+    if (schedule.isEmpty())
+        return false;
+
+    auto s = getSchedule(schedule);
+    if (!s.isValid())
+        return false;
+
+    auto _from  = from.isValid() ? from : QDate::currentDate();
+    auto _to    = to.isValid() ? to : _from;
+
+    if (_from > _to)
+        qSwap(_from, _to);
+
+    if (hasClosedMonths(_from, _to))
+        return false;
+
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    // The assignment is written even without records, days filled later take it
+    if (!m_storage->assignSchedule(m_employee, s.id, _from, _to))
+        return false;
+
+    dataChanged(_from, _to);
+    return transaction.commit();
+}
+
+bool WorktimeTracker::insertSchedule(const QString &name, const QTime &begin, const QTime &end, const QTime &lunchBegin, const QTime &lunchEnd)
+{
+    if (name.isEmpty())
+        return false;
+
+    TimeRange schedule(begin, end);
+    TimeRange lunch(lunchBegin, lunchEnd);
+
+    if (!schedule.isValid())
+        return false;
+
+    if (!lunch.isValid() || !schedule.contains(lunch))
+        return false;
+
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    Schedule s;
+    s.name           = name;
+    s.begin          = begin;
+    s.end            = end;
+    s.lunchTimeBegin = lunchBegin;
+    s.lunchTimeEnd   = lunchEnd;
+
+    if (!m_storage->insertSchedule(&s))
+        return false;
+
+    // Records couldn't reference it, the insert is rolled back
+    if (s.id > CompactRecord::MAX_SCHEDULE_ID) {
+        qDebug() << "Schedule id" << s.id << "is out of range of compact records";
+        return false;
+    }
+
+    internSchedule(s);
+    ++m_transaction->scheduleInserts;
+
+    m_summaryCache->clear();
+
+    if (m_snapshot)
+        m_snapshot->reloadSchedules(m_db);
+
+    return transaction.commit();
+}
+
+bool WorktimeTracker::setCheckIn(const QTime &time, const QDate &from, const QDate &to)
+{
+    if (!time.isValid())
+        return false;
+
+    auto _from = from.isValid() ? from : QDate::currentDate();
+    auto _to   = to.isValid() ? to : _from;
+
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    if (hasClosedMonths(qMin(_from, _to), qMax(_from, _to)) || !m_storage->setCheckIns(m_employee, _from, _to, time))
+        return false;
+
+    dataChanged(_from, _to);
+    return transaction.commit();
+}
+
+bool WorktimeTracker::setCheckOut(const QTime &time, const QDate &from, const QDate &to)
+{
+    if (!time.isValid())
+        return false;
+
+    auto _from = from.isValid() ? from : QDate::currentDate();
+    auto _to   = to.isValid() ? to : _from;
+
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    if (hasClosedMonths(qMin(_from, _to), qMax(_from, _to)) || !m_storage->setCheckOuts(m_employee, _from, _to, time))
+        return false;
+
+    dataChanged(_from, _to);
+    return transaction.commit();
+}
+
+QList<WorktimeTracker::LeavePass> WorktimeTracker::getLeavePassList(const QDate &date) const
+{
+    QVector<LeavePass> passes;
+    if (!date.isValid() || !m_storage->getLeavePasses(m_employee, date, date, &passes))
+        return QList<LeavePass>();
+
+    QList<LeavePass> leavePassList;
+    for (const auto& pass : passes)
+        leavePassList.append(pass);
+
+    return leavePassList;
+}
+
+WorktimeTracker::LeavePassMap WorktimeTracker::getLeavePasses(const QDate &from, const QDate &to) const
+{
+    LeavePassMap map;
+    if (!readLeavePasses(from, to, &map))
+        return LeavePassMap();
+
+    return map;
+}
+
+bool WorktimeTracker::insertLeavePass(const QTime &from, const QTime &to, const QDate &date, const QString &comment)
+{
+    // insertLeavePass(QTime(8,0), QTime(8,10)); -> return true
+    // insertLeavePass(QTime(8,0), QTime(8,10)); -> return false
+
+    if (!from.isValid() || !to.isValid())
+        return false;
+
+    auto _date = date.isValid() ? date : QDate::currentDate();
+
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    if (hasClosedMonths(_date, _date))
+        return false;
+
+    // Leave pass of a day with record has to be within its schedule
+    auto record = getRecord(_date);
+    if (record.isValid() && (qMin(from, to) < record.schedule->begin || qMax(from, to) > record.schedule->end))
+        return false;
+
+    // Leave passes of a day can't overlap, the same one can't be inserted twice
+    LeavePassIndex index;
+    if (!leavePassIndex(_date, &index))
+        return false;
+
+    if (index.contains(_date, from, to) || index.overlaps(_date, qMin(from, to), qMax(from, to)))
+        return false;
+
+    LeavePass pass = {};
+    pass.date    = _date;
+    pass.from    = from;
+    pass.to      = to;
+    pass.comment = comment;
+
+    if (!m_storage->insertLeavePass(m_employee, &pass))
+        return false;
+
+    indexLeavePass(m_employee, pass);
+
+    dataChanged(_date);
+    return transaction.commit();
+}
+
+bool WorktimeTracker::setLeavePassBegin(const QTime &time, const QDate &date, int id)
+{
+    if (!time.isValid())
+        return false;
+
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    auto _date = date.isValid() ? date : QDate::currentDate();
+    bool result = updateLeavePass(_date, id, [&time](LeavePass* pass) {
+        if (pass->to < time)
+            return false;
+        pass->from = time;
+        return true;
+    });
+    if (!result)
+        return false;
+
+    dataChanged(_date);
+    return transaction.commit();
+}
+
+bool WorktimeTracker::setLeavePassEnd(const QTime &time, const QDate &date, int id)
+{
+    if (!time.isValid())
+        return false;
+
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    auto _date = date.isValid() ? date : QDate::currentDate();
+    bool result = updateLeavePass(_date, id, [&time](LeavePass* pass) {
+        if (pass->from > time)
+            return false;
+        pass->to = time;
+        return true;
+    });
+    if (!result)
+        return false;
+
+    dataChanged(_date);
+    return transaction.commit();
+}
+
+bool WorktimeTracker::setLeavePassComment(const QString &comment, const QDate &date, int id)
+{
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    auto _date = date.isValid() ? date : QDate::currentDate();
+    return updateLeavePass(_date, id, [&comment](LeavePass* pass) {
+        pass->comment = comment;
+        return true;
+    }) && transaction.commit();
+}
+
+WorktimeTracker::Schedule WorktimeTracker::defaultSchedule() const
+{
+    return m_defaultSchedule;
+}
+
+int WorktimeTracker::employee() const
+{
+    return m_employee;
+}
+
+void WorktimeTracker::setEmployee(int employee)
+{
+    if (employee == m_employee)
+        return;
+
+    m_employee = employee;
+
+    // Copies of the tracker with the previous employee keep publishing into the old slot
+    auto version = m_published->version;
+    m_published  = std::make_shared<PublishedState>();
+    m_published->version = version;
+
+    // Snapshot holds data of one employee only
+    if (m_snapshot) {
+        m_snapshot.reset();
+        setSnapshotEnabled(true);
+    }
+}
+
+bool WorktimeTracker::setSnapshotEnabled(bool enabled)
+{
+    if (!enabled) {
+        m_snapshot.reset();
+        publishState();
+        return true;
+    }
+
+    if (m_snapshot)
+        return true;
+
+    auto snapshot = std::make_shared<WorktimeSnapshot>(m_employee);
+    if (!snapshot->load(m_db))
+        return false;
+
+    m_snapshot = snapshot;
+    publishState();
+    return true;
+}
+
+bool WorktimeTracker::isSnapshotEnabled() const
+{
+    return m_snapshot != nullptr;
+}
+
+bool WorktimeTracker::refreshSnapshot()
+{
+    m_storage->invalidate();
+    clearLeavePassIndexes();
+    m_summaryCache->clear();
+    notifyChange(m_employee, QDate(), QDate());
+    if (!m_snapshot || !m_snapshot->load(m_db))
+        return false;
+
+    publishState();
+    return true;
+}
+
+const WorktimeSnapshot *WorktimeTracker::snapshot() const
+{
+    reloadNotifiedRanges();
+    return m_snapshot.get();
+}
+
+std::shared_ptr<const WorktimeState> WorktimeTracker::state() const
+{
+    return std::atomic_load(&m_published->state);
+}
+
+bool WorktimeTracker::setWorkingCalendar(const WorkingCalendar &calendar)
+{
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR REPLACE INTO workingcalendar (Id, Calendar) VALUES (0, :calendar)");
+    query.bindValue(":calendar", calendar.toString());
+
+    if (!execQueryVerbosely(&query) || !transaction.commit())
+        return false;
+
+    std::atomic_store(m_calendar.get(), std::make_shared<const WorkingCalendar>(calendar));
+    m_summaryCache->clear();
+    notifyChange(m_employee, QDate(), QDate());
+    return true;
+}
+
+bool WorktimeTracker::clearWorkingCalendar()
+{
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    QSqlQuery query(m_db);
+    if (!execQueryVerbosely(&query, "DELETE FROM workingcalendar") || !transaction.commit())
+        return false;
+
+    std::atomic_store(m_calendar.get(), std::shared_ptr<const WorkingCalendar>());
+    m_summaryCache->clear();
+    notifyChange(m_employee, QDate(), QDate());
+    return true;
+}
+
+std::shared_ptr<const WorkingCalendar> WorktimeTracker::workingCalendar() const
+{
+    return std::atomic_load(m_calendar.get());
+}
+
+void WorktimeTracker::loadWorkingCalendar()
+{
+    QSqlQuery query(m_db);
+    if (!execQueryVerbosely(&query, "SELECT Calendar FROM workingcalendar") || !query.next())
+        return;
+
+    bool ok;
+    auto calendar = WorkingCalendar::fromString(query.value(0).toString(), &ok);
+    if (!ok) {
+        qDebug() << "Can't read working calendar:" << query.value(0).toString();
+        return;
+    }
+
+    std::atomic_store(m_calendar.get(), std::make_shared<const WorkingCalendar>(calendar));
+}
+
+bool WorktimeTracker::closeMonth(int month, int year)
+{
+    if (month < 1 || month > 12)
+        return false;
+
+    QDate monthStart = QDate(year, month, 1);
+    QDate monthEnd   = periodEnd(monthStart, SummaryPeriod::Month);
+
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    bool ok, valid;
+    auto ts = calculateOpenSummary(monthStart, monthEnd, &ok, &valid);
+    if (!ok)
+        return false;
+
+    if (!valid) {
+        qDebug() << "Can't close" << monthStart.toString("MM.yyyy") << "since it has days with unknown schedule";
+        return false;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare("INSERT INTO closedperiod (Month, Balance, Employee) VALUES (:month, :balance, :employee)");
+    query.bindValue(":month", dateToString(monthStart));
+    query.bindValue(":balance", ts.seconds);
+    query.bindValue(":employee", m_employee);
+
+    if (!execQueryVerbosely(&query))
+        return false;
+
+    recordChange(m_employee, monthStart, monthEnd);
+    m_summaryCache->invalidate(m_employee, monthStart, monthEnd);
+
+    if (m_snapshot)
+        m_snapshot->setClosedBalance(monthStart, ts.seconds);
+
+    return transaction.commit();
+}
+
+bool WorktimeTracker::reopenMonth(int month, int year)
+{
+    if (month < 1 || month > 12)
+        return false;
+
+    QDate monthStart = QDate(year, month, 1);
+
+    Transaction transaction(this);
+    if (!transaction.isActive())
+        return false;
+
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM closedperiod WHERE Employee = :employee AND Month = date(:month)");
+    query.bindValue(":month", dateToString(monthStart));
+    query.bindValue(":employee", m_employee);
+
+    if (!execQueryVerbosely(&query))
+        return false;
+
+    query.exec("SELECT changes()");
+    if (!query.next() || !query.value(0).toBool())
+        return false;
+
+    // Cached summaries may hold the frozen balance
+    recordChange(m_employee, monthStart, periodEnd(monthStart, SummaryPeriod::Month));
+    m_summaryCache->invalidate(m_employee, monthStart, periodEnd(monthStart, SummaryPeriod::Month));
+
+    if (m_snapshot)
+        m_snapshot->removeClosedBalance(monthStart);
+
+    return transaction.commit();
+}
+
+bool WorktimeTracker::isClosed(const QDate &date) const
+{
+    return date.isValid() && hasClosedMonths(date, date);
+}
+
+QList<QDate> WorktimeTracker::closedMonths() const
+{
+    QSqlQuery query(m_db);
+    query.prepare("SELECT Month FROM closedperiod WHERE Employee = :employee ORDER BY Month");
+    query.bindValue(":employee", m_employee);
+
+    QList<QDate> months;
+    if (!execQueryVerbosely(&query))
+        return months;
+
+    while (query.next())
+        months.append(stringToDate(query.value(0).toString()));
+
+    return months;
+}
+
+void WorktimeTracker::setSummaryCacheCapacity(int capacity)
+{
+    m_summaryCache->setCapacity(capacity);
+}
+
+int WorktimeTracker::summaryCacheCapacity() const
+{
+    return m_summaryCache->capacity();
+}
+
+void WorktimeTracker::clearSummaryCache()
+{
+    m_summaryCache->clear();
+    notifyChange(m_employee, QDate(), QDate());
+}
+
+int WorktimeTracker::addChangeListener(const ChangeListener &listener) const
+{
+    QMutexLocker locker(&m_changeListeners->mutex);
+    int id = m_changeListeners->nextId++;
+    m_changeListeners->listeners.insert(id, listener);
+    return id;
+}
+
+void WorktimeTracker::removeChangeListener(int id) const
+{
+    QMutexLocker locker(&m_changeListeners->mutex);
+    m_changeListeners->listeners.remove(id);
+
+    while (notificationDepth == 0 && m_changeListeners->calls > 0)
+        m_changeListeners->idle.wait(&m_changeListeners->mutex);
+}
+
+void WorktimeTracker::setGroupCommit(int maxMutations, int maxDelay)
+{
+    m_transaction->maxMutations = qMax(0, maxMutations);
+    m_transaction->maxDelay     = qMax(0, maxDelay);
+
+    if (m_transaction->maxMutations == 0)
+        flushGroupCommit();
+}
+
+std::shared_ptr<WorktimeTracker::TransactionState> WorktimeTracker::transactionState(const QSqlDatabase &db)
+{
+    // Trackers of one connection share its transaction, a tracker
+    // can't begin a transaction while another one keeps it open
+    static QMutex mutex;
+    static QHash<QString, std::weak_ptr<TransactionState>> states;
+
+    QMutexLocker locker(&mutex);
+
+    auto state = states.value(db.connectionName()).lock();
+    if (state && state->db.isOpen())
+        return state;
+
+    state = std::make_shared<TransactionState>();
+    state->db = db;
+    states.insert(db.connectionName(), state);
+
+    return state;
+}
+
+void WorktimeTracker::scheduleGroupFlush()
+{
+    auto& state = *m_transaction;
+    if (state.maxDelay <= 0)
+        return;
+
+    // The copy doesn't keep the transaction alive, the group is committed
+    // by the last tracker of the connection if the timer doesn't come
+    WorktimeTracker tracker(*this);
+    tracker.m_transaction.reset();
+
+    std::weak_ptr<TransactionState> weak = m_transaction;
+    auto group = state.groupNumber;
+
+    QTimer::singleShot(state.maxDelay, [tracker, weak, group]() mutable {
+        auto state = weak.lock();
+        if (!state || !state->group || state->groupNumber != group)
+            return;
+
+        tracker.m_transaction = state;
+        tracker.flushGroupCommit();
+        tracker.m_transaction.reset();
+    });
+}
+
+bool WorktimeTracker::flushGroupCommit()
+{
+    auto& state = *m_transaction;
+
+    // Group can't be committed in the middle of a write
+    if (!state.group)
+        return true;
+    if (state.depth > 0)
+        return false;
+
+    state.group = false;
+
+    if (m_db.commit()) {
+        state.changes.clear();
+        publishState();
+        return true;
+    }
+
+    qDebug() << "Can't commit group of" << state.groupMutations << "writes:" << m_db.lastError().text();
+    m_db.rollback();
+    rolledBack(0, true);
+    return false;
+}
+
+WorktimeTracker::Transaction::Transaction(WorktimeTracker *tracker)
+    : m_tracker(tracker)
+{
+    auto& state = *m_tracker->m_transaction;
+
+    m_level     = state.depth;
+    m_changes   = state.changes.size();
+    m_schedules = state.scheduleInserts;
+
+    // Group transaction stays open between writes, scopes are savepoints in it
+    if (state.depth == 0 && !state.group && state.maxMutations > 0 && m_tracker->m_db.transaction()) {
+        state.group          = true;
+        state.groupMutations = 0;
+        ++state.groupNumber;
+        state.groupTimer.start();
+        m_tracker->scheduleGroupFlush();
+    }
+
+    m_savepoint = state.depth > 0 || state.group;
+
+    if (m_savepoint) {
+        QSqlQuery query(m_tracker->m_db);
+        m_active = execQueryVerbosely(&query, "SAVEPOINT " + savepointName());
+    }
+    else {
+        m_active = m_tracker->m_db.transaction();
+    }
+
+    if (m_active)
+        ++state.depth;
+}
+
+WorktimeTracker::Transaction::~Transaction()
+{
+    rollback();
+}
+
+bool WorktimeTracker::Transaction::isActive() const
+{
+    return m_active;
+}
+
+bool WorktimeTracker::Transaction::commit()
+{
+    if (!m_active)
+        return false;
+
+    auto& state = *m_tracker->m_transaction;
+
+    bool ok;
+    if (m_savepoint) {
+        QSqlQuery query(m_tracker->m_db);
+        ok = execQueryVerbosely(&query, "RELEASE " + savepointName());
+    }
+    else {
+        ok = m_tracker->m_db.commit();
+    }
+
+    if (!ok) {
+        rollback();
+        return false;
+    }
+
+    m_active = false;
+    --state.depth;
+
+    if (state.depth > 0)
+        return true;
+
+    if (!state.group) {
+        state.changes.clear();
+        m_tracker->publishState();
+        return true;
+    }
+
+    ++state.groupMutations;
+    if (state.groupMutations >= state.maxMutations ||
+        (state.maxDelay > 0 && state.groupTimer.elapsed() >= state.maxDelay))
+        return m_tracker->flushGroupCommit();
+
+    return true;
+}
+
+void WorktimeTracker::Transaction::rollback()
+{
+    if (!m_active)
+        return;
+
+    auto& state = *m_tracker->m_transaction;
+
+    m_active = false;
+    --state.depth;
+
+    if (m_savepoint) {
+        // Rolled back savepoint stays on the stack until it's released
+        QSqlQuery query(m_tracker->m_db);
+        execQueryVerbosely(&query, "ROLLBACK TO " + savepointName());
+        execQueryVerbosely(&query, "RELEASE " + savepointName());
+    }
+    else {
+        m_tracker->m_db.rollback();
+    }
+
+    m_tracker->rolledBack(m_changes, state.scheduleInserts != m_schedules);
+}
+
+QString WorktimeTracker::Transaction::savepointName() const
+{
+    return QString("tracker_%1").arg(m_level);
+}
+
+void WorktimeTracker::notifyDataChanged(int employee, const QDate &from, const QDate &to, const QSqlDatabase &db) const
+{
+    auto _to = to.isValid() ? to : from;
+    auto _db = db.isValid() ? db : m_db;
+
+    invalidateLeavePassIndexes(employee, from, _to);
+    m_summaryCache->invalidate(employee, from, from.isValid() ? invalidationEnd(employee, _to, _db) : _to);
+
+    // Listeners see the published change
+    if (employee == m_employee)
+        publishNotifiedRange(from, _to, _db);
+
+    notifyChange(employee, from, _to);
+}
+
+void WorktimeTracker::publishNotifiedRange(const QDate &from, const QDate &to, const QSqlDatabase &db) const
+{
+    QMutexLocker locker(&m_published->mutex);
+
+    // Nothing is published while snapshot is disabled
+    auto previous = std::atomic_load(&m_published->state);
+    if (!previous)
+        return;
+
+    // Published versions are immutable, the next one is a copy reloaded through
+    // the connection of the caller. The tracker reloads its own snapshot later
+    WorktimeSnapshot snapshot(previous->snapshot());
+    if (from.isValid() ? !snapshot.reload(db, from, to) : !snapshot.load(db)) {
+        qDebug() << "Can't reload notified changes, worktime state isn't published";
+        return;
+    }
+
+    m_published->notified.append(qMakePair(from, to));
+
+    std::shared_ptr<const WorktimeState> state = std::make_shared<const WorktimeState>(++m_published->version, snapshot, *previous);
+    std::atomic_store(&m_published->state, state);
+}
+
+void WorktimeTracker::reloadNotifiedRanges() const
+{
+    if (!m_snapshot)
+        return;
+
+    QMutexLocker locker(&m_published->mutex);
+    reloadNotifiedRangesLocked();
+}
+
+void WorktimeTracker::reloadNotifiedRangesLocked() const
+{
+    for (const auto& range : m_published->notified)
+    {
+        bool ok = range.first.isValid() && m_snapshot->reload(m_db, range.first, range.second);
+        if (!ok && !m_snapshot->load(m_db))
+            qDebug() << "Can't reload notified changes into worktime snapshot";
+    }
+    m_published->notified.clear();
+}
+
+QSqlDatabase WorktimeTracker::database() const
+{
+    return m_db;
+}
+
+bool WorktimeTracker::setStorage(const std::shared_ptr<WorktimeStorage> &storage)
+{
+    if (!storage)
+        return false;
+
+    auto db = storage->database();
+    if (!db.isValid() || db.connectionName() != m_db.connectionName()) {
+        qDebug() << "Storage doesn't write to the tables of the tracker";
+        return false;
+    }
+
+    m_storage = storage;
+    clearLeavePassIndexes();
+    return true;
+}
+
+std::shared_ptr<WorktimeStorage> WorktimeTracker::storage() const
+{
+    return m_storage;
+}
+
+void WorktimeTracker::initWorktimeTable()
+{
+    QSqlQuery query(m_db);
+
+    QString definition = "    Date TEXT NOT NULL,"
+                         "    Schedule INT REFERENCES schedule(Id),"
+                         "    CheckIn TEXT,"
+                         "    CheckOut TEXT,"
+                         "    Employee INT NOT NULL DEFAULT 0,"
+                         "    PRIMARY KEY (Employee, Date)";
+
+    execQueryVerbosely(&query, "CREATE TABLE worktime (" + definition + ")");
+
+    // Records of older databases reference schedules by name, which are replaced
+    // by ids (NULL for unknown names). Single-employee databases have no Employee
+    // column and are keyed by date, their records belong to employee 0
+    auto columns = tableColumns("worktime");
+    bool names   = columns.value("Schedule") == "TEXT";
+
+    if (names || !columns.contains("Employee")) {
+        migrateTable("worktime", definition,
+                     {"Date", "Schedule", "CheckIn", "CheckOut", "Employee"},
+                     {"Date", names ? "(SELECT Id FROM schedule WHERE Name = worktime.Schedule)" : "Schedule",
+                      "CheckIn", "CheckOut", columns.contains("Employee") ? "Employee" : "0"});
+    }
+}
+
+void WorktimeTracker::initLeavepassTable()
+{
+    QSqlQuery query(m_db);
+
+    QString definition = "    Date TEXT NOT NULL,"
+                         "    Id INT,"
+                         "    Begin TEXT,"
+                         "    End TEXT,"
+                         "    Comment TEXT,"
+                         "    Employee INT NOT NULL DEFAULT 0,"
+                         "    Generated INT NOT NULL DEFAULT 0,"
+                         "    PRIMARY KEY (Employee, Date, Id)";
+
+    execQueryVerbosely(&query, "CREATE TABLE leavepass (" + definition + ")");
+
+    // Generated is 1 for leave passes made by aggregatePunches(). Tables created before
+    // miss it, ones of single-employee databases miss Employee too and are keyed by date
+    auto columns = tableColumns("leavepass");
+
+    if (!columns.contains("Employee")) {
+        migrateTable("leavepass", definition,
+                     {"Date", "Id", "Begin", "End", "Comment", "Employee", "Generated"},
+                     {"Date", "Id", "Begin", "End", "Comment", "0",
+                      columns.contains("Generated") ? "Generated" : "0"});
+    }
+    else if (!columns.contains("Generated")) {
+        execQueryVerbosely(&query, "ALTER TABLE leavepass ADD COLUMN Generated INT NOT NULL DEFAULT 0");
+    }
+}
+
+void WorktimeTracker::initScheduleTable()
+{
+    QSqlQuery query(m_db);
+
+    QString definition = "    Id INTEGER PRIMARY KEY,"
+                         "    Name TEXT UNIQUE NOT NULL,"
+                         "    Begin TEXT,"
+                         "    End TEXT,"
+                         "    LunchTimeBegin TEXT,"
+                         "    LunchTimeEnd   TEXT";
+
+    execQueryVerbosely(&query, "CREATE TABLE schedule (" + definition + ")");
+
+    // Schedules of older databases are keyed by name, they get ids in the order of the table
+    QStringList columns = {"Name", "Begin", "End", "LunchTimeBegin", "LunchTimeEnd"};
+    if (!tableColumns("schedule").contains("Id"))
+        migrateTable("schedule", definition, columns, columns);
+
+    query.prepare("INSERT INTO schedule (Name, Begin, End, LunchTimeBegin, LunchTimeEnd) "
+                  "VALUES(:name,:begin,:end,:lunchBegin,:lunchEnd)");
+    query.bindValue(":name", m_defaultSchedule.name);
+    query.bindValue(":begin", timeToString(m_defaultSchedule.begin));
+    query.bindValue(":end", timeToString(m_defaultSchedule.end));
+    query.bindValue(":lunchBegin", timeToString(m_defaultSchedule.lunchTimeBegin));
+    query.bindValue(":lunchEnd", timeToString(m_defaultSchedule.lunchTimeEnd));
+    execQueryVerbosely(&query);
+
+//    query.prepare("INSERT INTO schedule VALUES('floating_first_hour',:begin,:end)");
+//    query.bindValue(":begin", timeToString(scheduleBegin));
+//    query.bindValue(":end", timeToString(scheduleEnd));
+    //    execQueryVerbosely(&query);
+}
+
+void WorktimeTracker::initClosedPeriodTable()
+{
+    QSqlQuery query(m_db);
+
+    execQueryVerbosely(&query, "CREATE TABLE closedperiod ("
+                               "    Month TEXT NOT NULL,"
+                               "    Balance INT NOT NULL,"
+                               "    Employee INT NOT NULL DEFAULT 0,"
+                               "    PRIMARY KEY (Employee, Month)"
+                               ")");
+}
+
+void WorktimeTracker::initScheduleAssignmentTable()
+{
+    QSqlQuery query(m_db);
+
+    execQueryVerbosely(&query, "CREATE TABLE scheduleassignment ("
+                               "    Begin TEXT NOT NULL,"
+                               "    End TEXT NOT NULL,"
+                               "    Schedule INT REFERENCES schedule(Id),"
+                               "    Employee INT NOT NULL DEFAULT 0,"
+                               "    PRIMARY KEY (Employee, Begin)"
+                               ")");
+}
+
+void WorktimeTracker::initPunchEventTable()
+{
+    QSqlQuery query(m_db);
+
+    // Punches are only appended, rowid order is the order of arrival
+    execQueryVerbosely(&query, "CREATE TABLE punchevent ("
+                               "    Id INTEGER PRIMARY KEY,"
+                               "    Time TEXT NOT NULL,"
+                               "    Kind INT NOT NULL,"
+                               "    Source TEXT,"
+                               "    Employee INT NOT NULL DEFAULT 0"
+                               ")");
+    execQueryVerbosely(&query, "CREATE INDEX punchevent_employee_time ON punchevent (Employee, Time)");
+
+    // The last aggregated punch id, the table has one row at most
+    execQueryVerbosely(&query, "CREATE TABLE punchmark ("
+                               "    Id INTEGER PRIMARY KEY CHECK (Id = 0),"
+                               "    LastId INT NOT NULL"
+                               ")");
+
+    // Days with punches below the mark which weren't aggregated since their month was closed
+    execQueryVerbosely(&query, "CREATE TABLE punchbacklog ("
+                               "    Employee INT NOT NULL,"
                                "    Date TEXT NOT NULL,"
-                               "    Id INT,"
-                               "    Begin TEXT,"
-                               "    End TEXT,"
-                               "    Comment TEXT,"
-                               "    PRIMARY KEY (Date, Id)"
+                               "    PRIMARY KEY (Employee, Date)"
+                               ")");
+}
+
+void WorktimeTracker::initWorkingCalendarTable()
+{
+    QSqlQuery query(m_db);
+
+    // The calendar of all employees, the table has one row at most
+    execQueryVerbosely(&query, "CREATE TABLE workingcalendar ("
+                               "    Id INTEGER PRIMARY KEY CHECK (Id = 0),"
+                               "    Calendar TEXT NOT NULL"
                                ")");
 }
 
-void WorktimeTracker::initScheduleTable()
+QHash<QString, QString> WorktimeTracker::tableColumns(const QString &table) const
+{
+    // Column names of the table and their declared types
+    QHash<QString, QString> columns;
+
+    QSqlQuery query(m_db);
+    if (!execQueryVerbosely(&query, QString("PRAGMA table_info(%1)").arg(table)))
+        return columns;
+
+    while (query.next())
+        columns.insert(query.value(1).toString(), query.value(2).toString().toUpper());
+
+    return columns;
+}
+
+bool WorktimeTracker::migrateTable(const QString &table, const QString &definition, const QStringList &columns, const QStringList &values)
+{
+    // A table of an older schema is copied into a new one, which replaces it. SQLite can't
+    // alter columns and keys, so that's the way it recommends. Everything is done in a
+    // savepoint, a failed migration leaves the old table as it is
+
+    QSqlQuery query(m_db);
+    auto migration = table + "_migration";
+
+    if (!execQueryVerbosely(&query, "SAVEPOINT migration"))
+        return false;
+
+    bool ok = execQueryVerbosely(&query, QString("CREATE TABLE %1 (%2)").arg(migration).arg(definition)) &&
+              execQueryVerbosely(&query, QString("INSERT INTO %1 (%2) SELECT %3 FROM %4")
+                                         .arg(migration).arg(columns.join(", ")).arg(values.join(", ")).arg(table)) &&
+              execQueryVerbosely(&query, "DROP TABLE " + table) &&
+              execQueryVerbosely(&query, QString("ALTER TABLE %1 RENAME TO %2").arg(migration).arg(table));
+    if (!ok) {
+        qDebug() << "Can't migrate table" << table;
+        execQueryVerbosely(&query, "ROLLBACK TO migration");
+    }
+
+    return execQueryVerbosely(&query, "RELEASE migration") && ok;
+}
+
+void WorktimeTracker::loadSchedules()
+{
+    QVector<Schedule> schedules;
+    if (!m_storage->getSchedules(&schedules))
+        return;
+
+    // Schedules which are gone (e.g. their insert is rolled back) aren't found anymore
+    {
+        QMutexLocker locker(&m_schedules->mutex);
+        m_schedules->byId.clear();
+        m_schedules->ids.clear();
+    }
+
+    for (const auto& schedule : schedules)
+        internSchedule(schedule);
+}
+
+const WorktimeTracker::Schedule *WorktimeTracker::internSchedule(const Schedule &schedule) const
+{
+    if (schedule.id <= 0)
+        return nullptr;
+
+    auto& table = *m_schedules;
+    QMutexLocker locker(&table.mutex);
+
+    if (table.byId.size() <= schedule.id)
+        table.byId.resize(schedule.id + 1);
+
+    // Interned schedule may be referenced, so a changed one is interned anew
+    auto interned = table.byId[schedule.id];
+    if (!interned || !(*interned == schedule)) {
+        table.schedules.emplace_back(new Schedule(schedule));
+        interned = table.schedules.back().get();
+        table.byId[schedule.id] = interned;
+    }
+
+    table.ids.insert(schedule.name, schedule.id);
+    return interned;
+}
+
+void WorktimeTracker::dataChanged(const QDate &from, const QDate &to)
+{
+    dataChanged(m_employee, from, to);
+}
+
+void WorktimeTracker::dataChanged(int employee, const QDate &from, const QDate &to)
+{
+    auto _to = to.isValid() ? to : from;
+
+    recordChange(employee, from, _to);
+    m_summaryCache->invalidate(employee, from, invalidationEnd(employee, _to, m_db));
+    notifyChange(employee, from, _to);
+
+    if (!m_snapshot || employee != m_employee)
+        return;
+
+    // Stale snapshot gives wrong summaries, so it's dropped if it can't be updated
+    if (!m_snapshot->reload(m_db, from, _to) && !m_snapshot->load(m_db)) {
+        qDebug() << "Can't update worktime snapshot, it's disabled";
+        m_snapshot.reset();
+    }
+}
+
+QDate WorktimeTracker::invalidationEnd(int employee, const QDate &to, const QSqlDatabase &db) const
+{
+    // With a working calendar missing days are planned with the schedule of the last
+    // record before them, so summaries up to the next record after 'to' depend on
+    // the written dates. Invalid date means all dates after 'to'
+    if (!workingCalendar())
+        return to;
+
+    QSqlQuery query(db);
+    query.prepare("SELECT MIN(Date) FROM worktime WHERE Employee = :employee AND Date > date(:to)");
+    query.bindValue(":employee", employee);
+    query.bindValue(":to", dateToString(to));
+
+    if (!execQueryVerbosely(&query) || !query.next())
+        return QDate();
+
+    return stringToDate(query.value(0).toString());
+}
+
+void WorktimeTracker::recordChange(int employee, const QDate &from, const QDate &to)
 {
-    QSqlQuery query(m_db);
+    if (m_transaction->depth > 0 || m_transaction->group)
+        m_transaction->changes.append({employee, from, to});
+}
 
-    execQueryVerbosely(&query, "CREATE TABLE schedule ("
-                               "    Name TEXT PRIMARY KEY NOT NULL,"
-                               "    Begin TEXT,"
-                               "    End TEXT,"
-                               "    LunchTimeBegin TEXT,"
-                               "    LunchTimeEnd   TEXT"
-                               ")");
+void WorktimeTracker::rolledBack(int changes, bool schedules)
+{
+    // Caches and snapshot have seen the rolled back writes, so touched dates are refreshed again
+    m_storage->invalidate();
+    clearLeavePassIndexes();
+
+    auto touched = m_transaction->changes.mid(changes);
+    m_transaction->changes.resize(changes);
+
+    if (schedules) {
+        loadSchedules();
+        m_summaryCache->clear();
+        if (m_snapshot)
+            m_snapshot->reloadSchedules(m_db);
+    }
 
-    query.prepare("INSERT INTO schedule VALUES(:name,:begin,:end,:lunchBegin,:lunchEnd)");
-    query.bindValue(":name", m_defaultSchedule.name);
-    query.bindValue(":begin", timeToString(m_defaultSchedule.begin));
-    query.bindValue(":end", timeToString(m_defaultSchedule.end));
-    query.bindValue(":lunchBegin", timeToString(m_defaultSchedule.lunchTimeBegin));
-    query.bindValue(":lunchEnd", timeToString(m_defaultSchedule.lunchTimeEnd));
-    execQueryVerbosely(&query);
+    for (const auto& change : touched)
+        dataChanged(change.employee, change.from, change.to);
+}
 
-//    query.prepare("INSERT INTO schedule VALUES('floating_first_hour',:begin,:end)");
-//    query.bindValue(":begin", timeToString(scheduleBegin));
-//    query.bindValue(":end", timeToString(scheduleEnd));
-    //    execQueryVerbosely(&query);
+void WorktimeTracker::notifyChange(int employee, const QDate &from, const QDate &to) const
+{
+    // Listeners are called unlocked since they may write through the tracker
+    QList<int> ids;
+    {
+        QMutexLocker locker(&m_changeListeners->mutex);
+        ids = m_changeListeners->listeners.keys();
+        ++m_changeListeners->calls;
+    }
+
+    ++notificationDepth;
+    for (int id : ids)
+    {
+        // Listener could be removed by a previous one
+        ChangeListener listener;
+        {
+            QMutexLocker locker(&m_changeListeners->mutex);
+            listener = m_changeListeners->listeners.value(id);
+        }
+        if (listener)
+            listener(employee, from, to);
+    }
+    --notificationDepth;
+
+    QMutexLocker locker(&m_changeListeners->mutex);
+    if (--m_changeListeners->calls == 0)
+        m_changeListeners->idle.wakeAll();
 }
 
-bool WorktimeTracker::updateColumnData(const QString &table, const QString &column, const QDate &from, const QDate &to, const QString& data, const QString &additionalCondition) const
+void WorktimeTracker::publishState()
 {
-    if (!from.isValid() && !to.isValid())
-        return false;
+    std::shared_ptr<const WorktimeState> state;
+
+    QMutexLocker locker(&m_published->mutex);
+
+    if (m_snapshot) {
+        // Writes notified by other connections would be lost by the next version otherwise
+        reloadNotifiedRangesLocked();
+
+        QVector<Schedule>   schedules;
+        QHash<QString, int> scheduleIds;
+        {
+            QMutexLocker locker(&m_schedules->mutex);
+            schedules.resize(m_schedules->byId.size());
+            for (int id = 1; id < schedules.size(); ++id)
+                if (m_schedules->byId[id])
+                    schedules[id] = *m_schedules->byId[id];
+            scheduleIds = m_schedules->ids;
+        }
+
+        // Copies share data with the snapshot until the next write of it
+        state = std::make_shared<const WorktimeState>(++m_published->version, *m_snapshot,
+                                                      schedules, scheduleIds);
+    }
+
+    // Readers keep the version they've loaded, it's freed with the last of them
+    std::atomic_store(&m_published->state, state);
+}
+
+QMap<QDate, qint64> WorktimeTracker::closedBalances(const QDate &from, const QDate &to, bool *ok) const
+{
+    return closedBalances({m_employee}, from, to, ok).value(m_employee);
+}
 
+QHash<int, QMap<QDate, qint64>> WorktimeTracker::closedBalances(const QList<int> &employees, const QDate &from, const QDate &to,
+                                                                bool *ok) const
+{
+    QStringList ids;
+    for (int employee : employees)
+        ids.append(QString::number(employee));
+
+    // Months lying entirely in [from, to]
     QSqlQuery query(m_db);
+    query.prepare(QString("SELECT Employee, Month, Balance FROM closedperiod "
+                          "WHERE Employee IN (%1) AND Month BETWEEN date(:from) AND date(:to)").arg(ids.join(",")));
+    query.bindValue(":from", dateToString(from));
+    query.bindValue(":to", dateToString(to));
 
-    // Swap if from > to
-    QDate _from = qMin(from, to);
-    QDate _to   = qMax(from, to);
+    QHash<int, QMap<QDate, qint64>> balances;
 
-    QString queryText = "UPDATE %1 SET %2=:data WHERE Date BETWEEN date(:from) AND date(:to)";
-    if (!additionalCondition.isEmpty()) queryText += " AND %3";
+    *ok = execQueryVerbosely(&query);
+    if (!*ok)
+        return balances;
 
-    query.prepare(queryText.arg(table).arg(column).arg(additionalCondition));
-    query.bindValue(":from", dateToString(_from));
-    query.bindValue(":to", dateToString(_to));
-    query.bindValue(":data", data);
+    while (query.next())
+    {
+        auto month = stringToDate(query.value(1).toString());
+        if (periodEnd(month, SummaryPeriod::Month) <= to)
+            balances[query.value(0).toInt()].insert(month, query.value(2).toLongLong());
+    }
+
+    return balances;
+}
+
+bool WorktimeTracker::hasClosedMonths(const QDate &from, const QDate &to) const
+{
+    return hasClosedMonths(m_employee, from, to);
+}
+
+bool WorktimeTracker::hasClosedMonths(int employee, const QDate &from, const QDate &to) const
+{
+    QSqlQuery query(m_db);
+    query.prepare("SELECT Month FROM closedperiod WHERE Employee = :employee AND Month BETWEEN date(:from) AND date(:to) LIMIT 1");
+    query.bindValue(":employee", employee);
+    query.bindValue(":from", dateToString(periodBegin(from, SummaryPeriod::Month)));
+    query.bindValue(":to", dateToString(to));
 
+    // Data of closed months must not change, so writes are rejected if it can't be checked
     if (!execQueryVerbosely(&query))
-        return false;
+        return true;
 
-    query.exec("SELECT changes()");
+    if (!query.next())
+        return false;
 
-    return query.next() ? query.value(0).toBool() : false;
+    qDebug() << "Can't change data of closed month" << stringToDate(query.value(0).toString()).toString("MM.yyyy");
+    return true;
 }
 
-bool WorktimeTracker::updateLeavePassData(const QString &column, const QDate &date, int id, const QString &data, const QString &additionalCondition) const
+bool WorktimeTracker::aggregatePunchDay(int employee, const QDate &date)
 {
-    if (!date.isValid())
+    QSqlQuery punches(m_db);
+    punches.setForwardOnly(true);
+    punches.prepare("SELECT time(Time), Kind FROM punchevent "
+                    "WHERE Employee = :employee AND Time >= :from AND Time < :to ORDER BY Time, Id");
+    punches.bindValue(":employee", employee);
+    punches.bindValue(":from", dateToString(date));
+    punches.bindValue(":to", dateToString(date.addDays(1)));
+
+    if (!execQueryVerbosely(&punches))
+        return false;
+
+    QTime checkIn, checkOut, leaving;
+    bool  present = false;
+    QList<QPair<QTime, QTime>> gaps;
+
+    while (punches.next())
+    {
+        auto time = stringToTime(punches.value(0).toString());
+
+        if (PunchKind(punches.value(1).toInt()) == PunchKind::In) {
+            if (!checkIn.isValid())
+                checkIn = time;
+            else if (!present && leaving.isValid())
+                gaps.append(qMakePair(leaving, time));
+            present = true;
+        }
+        else {
+            if (present)
+                leaving = time;
+            checkOut = time;
+            present  = false;
+        }
+    }
+
+    // Check out of an employee who is still at work isn't known yet
+    if (present)
+        checkOut = QTime();
+
+    // The record of the day or the last one before it for the schedule
+    CompactRecord record;
+    bool     exists = m_storage->getRecord(employee, date, &record);
+    Schedule schedule;
+    QTime    defaultIn, defaultOut;
+
+    if (exists) {
+        schedule   = getSchedule(record.scheduleId());
+        defaultIn  = record.checkInTime();
+        defaultOut = record.checkOutTime();
+    }
+    else {
+        QSqlQuery query(m_db);
+        query.prepare("SELECT " + scheduleColumnSql() + " FROM worktime "
+                      "WHERE Employee = :employee AND Date < date(:d) ORDER BY Date DESC LIMIT 1");
+        query.bindValue(":employee", employee);
+        query.bindValue(":d", dateToString(date));
+
+        if (!execQueryVerbosely(&query))
+            return false;
+
+        if (query.next())
+            schedule = getSchedule(query.value(0).toInt());
+    }
+
+    if (!schedule.isValid())
+        schedule = m_defaultSchedule;
+
+    if (!exists) {
+        defaultIn  = schedule.begin;
+        defaultOut = schedule.end;
+    }
+
+    // Stored check out of the day is outdated once the employee has come back
+    if (!checkIn.isValid())
+        checkIn = checkOut.isValid() ? qMin(defaultIn, checkOut) : defaultIn;
+    if (!checkOut.isValid())
+        checkOut = qMax(present ? schedule.end : defaultOut, checkIn);
+
+    // Schedule of an existing record is kept as it is
+    auto scheduleId = record.scheduleId();
+
+    Record r;
+    r.date     = date;
+    r.schedule = scheduleRef(schedule.id);
+    r.checkIn  = checkIn;
+    r.checkOut = checkOut;
+    record = CompactRecord::fromRecord(r);
+
+    if (exists) {
+        record.setScheduleId(scheduleId);
+        if (!m_storage->updateRecord(employee, record))
+            return false;
+    }
+    else if (!m_storage->insertRecord(employee, record)) {
+        return false;
+    }
+
+    // Leave passes of the day made by the previous aggregation are replaced,
+    // other ones are kept
+    QVector<LeavePass> passes;
+    if (!m_storage->getLeavePasses(employee, date, date, &passes))
         return false;
 
+    for (const auto& pass : passes)
+        if (pass.generated && !m_storage->removeLeavePass(employee, date, pass.id))
+            return false;
+
+    invalidateLeavePassIndexes(employee, date, date);
+
+    for (const auto& gap : gaps)
+    {
+        LeavePass pass = {};
+        pass.date      = date;
+        pass.from      = qMax(gap.first, schedule.begin);
+        pass.to        = qMin(gap.second, schedule.end);
+        pass.comment   = PUNCH_COMMENT;
+        pass.generated = true;
+        if (pass.from >= pass.to)
+            continue;
+
+        if (!m_storage->insertLeavePass(employee, &pass))
+            return false;
+    }
+
+    return true;
+}
+
+bool WorktimeTracker::keepRecordSchedule(int id, const QDate &date)
+{
+    // Explicit schedule of a new record wins over the assignment covering its date,
+    // so the date is cut out of the assignment
+    auto assigned = getAssignedSchedule(date);
+    return !assigned.isValid() || assigned.id == id || m_storage->assignSchedule(m_employee, id, date, date);
+}
+
+bool WorktimeTracker::hasScheduleAssignments() const
+{
     QSqlQuery query(m_db);
+    query.prepare("SELECT 1 FROM scheduleassignment WHERE Employee = :employee LIMIT 1");
+    query.bindValue(":employee", m_employee);
+    return !execQueryVerbosely(&query) || query.next();
+}
 
-    QString queryText = "UPDATE leavepass SET %2=:data WHERE Date = date(:d) AND Id = :id";
-    if (!additionalCondition.isEmpty()) queryText += " AND %3";
+bool WorktimeTracker::updateLeavePass(const QDate &date, int id, const std::function<bool (LeavePass *)> &update) const
+{
+    if (!date.isValid() || hasClosedMonths(date, date))
+        return false;
 
-    query.prepare(queryText.arg(column).arg(additionalCondition));
-    query.bindValue(":d", dateToString(date));
-    query.bindValue(":id", QString::number(id));
-    query.bindValue(":data", data);
+    QVector<LeavePass> passes;
+    if (!m_storage->getLeavePasses(m_employee, date, date, &passes))
+        return false;
 
-    if (!execQueryVerbosely(&query))
+    for (auto pass : passes)
+    {
+        if (pass.id != id)
+            continue;
+
+        if (!update(&pass) || !m_storage->updateLeavePass(m_employee, pass))
+            return false;
+
+        indexLeavePass(m_employee, pass);
+        return true;
+    }
+
+    return false;
+}
+
+bool WorktimeTracker::leavePassIndex(const QDate &date, LeavePassIndex *index) const
+{
+    {
+        QMutexLocker locker(&m_leavePassIndexes->mutex);
+        const auto& days = m_leavePassIndexes->days[m_employee];
+        auto it = days.constFind(date);
+        if (it != days.constEnd()) {
+            *index = it.value();
+            return true;
+        }
+    }
+
+    LeavePassMap map;
+    if (!readLeavePasses(date, date, &map))
         return false;
 
-    query.exec("SELECT changes()");
+    *index = LeavePassIndex(map);
+
+    QMutexLocker locker(&m_leavePassIndexes->mutex);
+    auto& days = m_leavePassIndexes->days[m_employee];
+    if (days.size() >= LeavePassIndexes::MAX_DAYS)
+        days.clear();
+
+    days.insert(date, *index);
+    return true;
+}
+
+void WorktimeTracker::indexLeavePass(int employee, const LeavePass &pass) const
+{
+    // Only days which are indexed already are updated
+    QMutexLocker locker(&m_leavePassIndexes->mutex);
+    auto& days = m_leavePassIndexes->days[employee];
+    auto it = days.find(pass.date);
+    if (it == days.end())
+        return;
+
+    it->remove(pass.date, pass.id);
+    it->insert(pass);
+}
+
+void WorktimeTracker::invalidateLeavePassIndexes(int employee, const QDate &from, const QDate &to) const
+{
+    QMutexLocker locker(&m_leavePassIndexes->mutex);
+    auto& days = m_leavePassIndexes->days[employee];
 
-    return query.next() ? query.value(0).toBool() : false;
+    // Invalid range is everything
+    if (!from.isValid()) {
+        days.clear();
+        return;
+    }
+
+    auto it = days.lowerBound(from);
+    while (it != days.end() && (!to.isValid() || it.key() <= to))
+        it = days.erase(it);
+}
+
+void WorktimeTracker::clearLeavePassIndexes() const
+{
+    QMutexLocker locker(&m_leavePassIndexes->mutex);
+    m_leavePassIndexes->days.clear();
 }
 
 WorktimeTracker::Schedule WorktimeTracker::getSchedule(const QString &name) const
 {
-    QSqlQuery query(m_db);
-    query.prepare("SELECT * FROM schedule WHERE Name = :name");
-    query.bindValue(":name", name);
+    return *scheduleRef(name);
+}
+
+WorktimeTracker::Schedule WorktimeTracker::getSchedule(int id) const
+{
+    return *scheduleRef(id);
+}
+
+WorktimeTracker::ScheduleRef WorktimeTracker::scheduleRef(const QString &name) const
+{
+    if (name.isEmpty())
+        return ScheduleRef();
+
+    {
+        QMutexLocker locker(&m_schedules->mutex);
+        int id = m_schedules->ids.value(name);
+        if (id > 0 && m_schedules->byId[id])
+            return ScheduleRef(m_schedules->byId[id]);
+    }
+
+    // Schedule could be inserted by another tracker or connection
+    Schedule fetched;
+    if (!m_storage->getSchedule(name, &fetched))
+        return ScheduleRef();
+
+    auto schedule = internSchedule(fetched);
+    return schedule && schedule->isValid() ? ScheduleRef(schedule) : ScheduleRef();
+}
+
+WorktimeTracker::ScheduleRef WorktimeTracker::scheduleRef(int id) const
+{
+    if (id <= 0)
+        return ScheduleRef();
+
+    {
+        QMutexLocker locker(&m_schedules->mutex);
+        if (id < m_schedules->byId.size() && m_schedules->byId[id])
+            return ScheduleRef(m_schedules->byId[id]);
+    }
+
+    Schedule fetched;
+    if (!m_storage->getSchedule(id, &fetched))
+        return ScheduleRef();
+
+    auto schedule = internSchedule(fetched);
+    return schedule && schedule->isValid() ? ScheduleRef(schedule) : ScheduleRef();
+}
+
+WorktimeTracker::Schedule WorktimeTracker::getScheduleBeforeDate(const QDate &date) const
+{
+    if (!date.isValid())
+        return Schedule();
 
+    QSqlQuery query(m_db);
+    query.prepare("SELECT " + scheduleColumnSql() + " FROM worktime WHERE Employee = :employee AND Date < date(:d) ORDER BY Date DESC LIMIT 1");
+    query.bindValue(":employee", m_employee);
+    query.bindValue(":d", dateToString(date));
     if (!execQueryVerbosely(&query))
         return Schedule();
 
     if (!query.next())
         return Schedule();
 
-    Schedule s;
-    s.name = query.value("Name").toString();
-    s.begin = stringToTime(query.value("Begin").toString());
-    s.end = stringToTime(query.value("End").toString());
-    s.lunchTimeBegin = stringToTime(query.value("LunchTimeBegin").toString());
-    s.lunchTimeEnd = stringToTime(query.value("LunchTimeEnd").toString());
-    return s;
+    return getSchedule(query.value(0).toInt());
 }
 
-WorktimeTracker::Schedule WorktimeTracker::getScheduleBeforeDate(const QDate &date) const
+WorktimeTracker::Schedule WorktimeTracker::getAssignedSchedule(const QDate &date) const
 {
     if (!date.isValid())
         return Schedule();
 
+    // Assignments don't overlap, so the only candidate is the last one beginning before the date
     QSqlQuery query(m_db);
-    query.prepare("SELECT Schedule FROM worktime WHERE Date < date(:d) ORDER BY Date DESC LIMIT 1");
+    query.prepare("SELECT End, Schedule FROM scheduleassignment "
+                  "WHERE Employee = :employee AND Begin <= :d ORDER BY Begin DESC LIMIT 1");
+    query.bindValue(":employee", m_employee);
     query.bindValue(":d", dateToString(date));
-    if (!execQueryVerbosely(&query))
+    if (!execQueryVerbosely(&query) || !query.next())
         return Schedule();
 
-    if (!query.next())
+    if (query.value(0).toString() < dateToString(date))
         return Schedule();
 
-    return getSchedule(query.value(0).toString());
+    return getSchedule(query.value(1).toInt());
+}
+
+WorktimeTracker::Schedule WorktimeTracker::getScheduleForDate(const QDate &date) const
+{
+    Schedule schedule = getAssignedSchedule(date);
+    if (!schedule.isValid())
+        schedule = getScheduleBeforeDate(date);
+    if (!schedule.isValid())
+        schedule = defaultSchedule();
+    return schedule;
+}
+
+WorktimeTracker::RecordColumns WorktimeTracker::recordColumns(const QSqlQuery &query)
+{
+    auto record = query.record();
+
+    RecordColumns columns;
+    columns.date     = record.indexOf("Date");
+    columns.schedule = record.indexOf("Schedule");
+    columns.checkIn  = record.indexOf("CheckIn");
+    columns.checkOut = record.indexOf("CheckOut");
+    return columns;
+}
+
+WorktimeTracker::Record WorktimeTracker::readRecord(const QSqlQuery &query, const RecordColumns &columns) const
+{
+    Record r;
+    r.schedule = scheduleRef(query.value(columns.schedule).toInt());
+    r.date     = stringToDate(query.value(columns.date).toString());
+    r.checkIn  = stringToTime(query.value(columns.checkIn).toString());
+    r.checkOut = stringToTime(query.value(columns.checkOut).toString());
+    return r;
+}
+
+bool WorktimeTracker::readLeavePasses(const QDate &from, const QDate &to, LeavePassMap *map) const
+{
+    if (!from.isValid() || !to.isValid())
+        return false;
+
+    QVector<LeavePass> passes;
+    if (!m_storage->getLeavePasses(m_employee, from, to, &passes))
+        return false;
+
+    for (const auto& lp : passes)
+    {
+        if (map->dates.isEmpty() || map->dates.last() != lp.date) {
+            map->dates.append(lp.date);
+            map->offsets.append(map->passes.size());
+        }
+
+        map->passes.append(lp);
+        map->offsets.last() = map->passes.size();
+    }
+
+    return true;
+}
+
+int WorktimeTracker::LeavePassMap::size() const
+{
+    return dates.size();
+}
+
+int WorktimeTracker::LeavePassMap::indexOf(const QDate &date) const
+{
+    auto it = std::lower_bound(dates.constBegin(), dates.constEnd(), date);
+    return it != dates.constEnd() && *it == date ? int(it - dates.constBegin()) : -1;
+}
+
+int WorktimeTracker::LeavePassMap::count(int index) const
+{
+    return index >= 0 && index < dates.size() ? offsets[index + 1] - offsets[index] : 0;
+}
+
+const WorktimeTracker::LeavePass *WorktimeTracker::LeavePassMap::begin(int index) const
+{
+    return index >= 0 && index < dates.size() ? passes.constData() + offsets[index] : nullptr;
+}
+
+const WorktimeTracker::LeavePass *WorktimeTracker::LeavePassMap::end(int index) const
+{
+    return index >= 0 && index < dates.size() ? passes.constData() + offsets[index + 1] : nullptr;
+}
+
+QList<WorktimeTracker::LeavePass> WorktimeTracker::LeavePassMap::value(const QDate &date) const
+{
+    QList<LeavePass> list;
+
+    int i = indexOf(date);
+    for (auto lp = begin(i); lp != end(i); ++lp)
+        list.append(*lp);
+
+    return list;
 }
 
 bool WorktimeTracker::Schedule::isValid() const
@@ -530,13 +2759,46 @@ QString WorktimeTracker::Schedule::toString() const
             .arg(lunchTimeEnd.toString());
 }
 
-bool WorktimeTracker::Schedule::operator==(const WorktimeTracker::Schedule &s)
+bool WorktimeTracker::Schedule::operator==(const WorktimeTracker::Schedule &s) const
 {
     return name == s.name &&
            begin == s.begin && end == s.end &&
            lunchTimeBegin == s.lunchTimeBegin && lunchTimeEnd == s.lunchTimeEnd;
 }
 
+WorktimeTracker::ScheduleRef::ScheduleRef()
+    : m_schedule(nullptr)
+{
+
+}
+
+WorktimeTracker::ScheduleRef::ScheduleRef(const Schedule *schedule)
+    : m_schedule(schedule)
+{
+
+}
+
+int WorktimeTracker::ScheduleRef::id() const
+{
+    return m_schedule ? m_schedule->id : 0;
+}
+
+bool WorktimeTracker::ScheduleRef::isValid() const
+{
+    return m_schedule != nullptr;
+}
+
+const WorktimeTracker::Schedule &WorktimeTracker::ScheduleRef::operator*() const
+{
+    static const Schedule invalid;
+    return m_schedule ? *m_schedule : invalid;
+}
+
+const WorktimeTracker::Schedule *WorktimeTracker::ScheduleRef::operator->() const
+{
+    return &operator*();
+}
+
 bool WorktimeTracker::LeavePass::isValid() const
 {
     return date.isValid() && from.isValid() && to.isValid();
@@ -554,14 +2816,66 @@ QString WorktimeTracker::LeavePass::toString() const
 
 bool WorktimeTracker::Record::isValid() const
 {
-    return date.isValid() && schedule.isValid() && checkIn.isValid() && checkOut.isValid();
+    return date.isValid() && schedule.isValid() && schedule->isValid() && checkIn.isValid() && checkOut.isValid();
 }
 
 QString WorktimeTracker::Record::toString() const
 {
     return QString("worktime date=%1, schedule={%2}, checkIn=%3, checkOut=%4")
             .arg(date.toString())
-            .arg(schedule.toString())
+            .arg(schedule->toString())
             .arg(checkIn.toString())
             .arg(checkOut.toString());
 }
+
+static_assert(sizeof(WorktimeTracker::CompactRecord) == 12, "CompactRecord is expected to be 12 bytes");
+
+constexpr qint32  WorktimeTracker::CompactRecord::NO_DAY;
+constexpr quint32 WorktimeTracker::CompactRecord::NO_TIME;
+constexpr int     WorktimeTracker::CompactRecord::MAX_SCHEDULE_ID;
+
+WorktimeTracker::CompactRecord WorktimeTracker::CompactRecord::fromRecord(const Record &r)
+{
+    auto packTime = [](const QTime& t) {
+        return t.isValid() ? quint32(t.msecsSinceStartOfDay() / 1000) : NO_TIME;
+    };
+
+    CompactRecord c;
+    c.day      = r.date.isValid() ? qint32(r.date.toJulianDay()) : NO_DAY;
+    c.checkIn  = packTime(r.checkIn);
+    c.checkOut = packTime(r.checkOut);
+    c.setScheduleId(r.schedule.id());
+    return c;
+}
+
+QDate WorktimeTracker::CompactRecord::date() const
+{
+    return day != NO_DAY ? QDate::fromJulianDay(day) : QDate();
+}
+
+QTime WorktimeTracker::CompactRecord::checkInTime() const
+{
+    return checkIn != NO_TIME ? QTime::fromMSecsSinceStartOfDay(int(checkIn) * 1000) : QTime();
+}
+
+QTime WorktimeTracker::CompactRecord::checkOutTime() const
+{
+    return checkOut != NO_TIME ? QTime::fromMSecsSinceStartOfDay(int(checkOut) * 1000) : QTime();
+}
+
+int WorktimeTracker::CompactRecord::scheduleId() const
+{
+    return int(scheduleHigh << 15 | scheduleLow);
+}
+
+void WorktimeTracker::CompactRecord::setScheduleId(int id)
+{
+    auto bits = id > 0 && id <= MAX_SCHEDULE_ID ? quint32(id) : 0;
+    scheduleLow  = bits & 0x7FFF;
+    scheduleHigh = bits >> 15;
+}
+
+bool WorktimeTracker::CompactRecord::isValid() const
+{
+    return day != NO_DAY && scheduleId() != 0 && checkIn != NO_TIME && checkOut != NO_TIME;
+}
@@ -3,40 +3,158 @@
 
 #include <QSqlDatabase>
 #include <QDateTime>
+#include <QHash>
+#include <QMap>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include <functional>
 #include "helper.h"
+#include "worktimesnapshot.h"
+#include "summarycache.h"
+#include "workingcalendar.h"
 
 // TODO: add method variants with TimeSpan, TimeRange
 
+class WorktimeState;
+class WorktimeStorage;
+class LeavePassIndex;
+
 class WorktimeTracker
 {
 public:
     struct Schedule
     {
+        int     id = 0;
         QString name;
         QTime   begin, end;
         QTime   lunchTimeBegin, lunchTimeEnd;
         bool    isValid() const;
         QString toString() const;
-        bool    operator==(const Schedule& s);
+        bool    operator==(const Schedule& s) const;
+    };
+
+    // Schedules are interned in a table shared by all copies of a tracker,
+    // schedules missing in it are read from the database on lookup. ScheduleRef
+    // is a lightweight handle into that table, it stays valid while the tracker
+    // (or any copy of it) exists
+    class ScheduleRef
+    {
+    public:
+        ScheduleRef();
+        int  id() const;
+        bool isValid() const;
+        const Schedule& operator*() const;
+        const Schedule* operator->() const;
+
+    private:
+        friend class WorktimeTracker;
+        friend class WorktimeState;
+        explicit ScheduleRef(const Schedule* schedule);
+
+        const Schedule* m_schedule;
     };
+
     struct LeavePass
     {
         QDate   date;
         int     id;
         QTime   from, to;
         QString comment;
+        bool    generated;          // Made by aggregatePunches()
         bool    isValid() const;
         QString toString() const;
     };
+    // Leave passes of a date range grouped by date. Passes of dates[i] are
+    // passes[offsets[i]] .. passes[offsets[i + 1] - 1], dates are sorted
+    struct LeavePassMap
+    {
+        QVector<QDate>     dates;
+        QVector<int>       offsets = {0};
+        QVector<LeavePass> passes;
+
+        int  size() const;
+        int  indexOf(const QDate& date) const;
+        int  count(int index) const;
+        const LeavePass* begin(int index) const;
+        const LeavePass* end(int index) const;
+        QList<LeavePass> value(const QDate& date) const;
+    };
+    // Debt and overtime of one day of an employee in seconds. Balance of the day is
+    // overtime - debt. The day is invalid if its schedule is unknown, getSummary()
+    // of any range with such day is zero
+    struct DayBalance
+    {
+        int    employee;
+        QDate  date;
+        qint32 debt, overtime;
+        bool   valid;
+    };
     struct Record
     {
-        QDate    date;
-        Schedule schedule;
-        QTime    checkIn, checkOut;
+        QDate       date;
+        ScheduleRef schedule;
+        QTime       checkIn, checkOut;
         bool     isValid() const;
         QString  toString() const;
     };
 
+    // Packed form of Record for keeping large date ranges resident in memory:
+    // 12 bytes, no heap data and no pointers. Times have the same one second
+    // precision as in database, invalid date/time are stored as NO_DAY/NO_TIME.
+    // Schedule ids take 30 bits split into two halves, insertSchedule() doesn't
+    // create schedules above MAX_SCHEDULE_ID. Use WorktimeTracker::toRecord() to get
+    // a Record back
+    struct CompactRecord
+    {
+        qint32  day;                // Julian day
+        quint32 checkIn      : 17;  // Seconds since midnight
+        quint32 scheduleLow  : 15;
+        quint32 checkOut     : 17;
+        quint32 scheduleHigh : 15;
+
+        static constexpr qint32  NO_DAY = -0x7FFFFFFF - 1;
+        static constexpr quint32 NO_TIME = 0x1FFFF;
+        static constexpr int     MAX_SCHEDULE_ID = 0x3FFFFFFF;
+
+        static CompactRecord fromRecord(const Record& r);
+
+        QDate date() const;
+        QTime checkInTime() const;
+        QTime checkOutTime() const;
+        int   scheduleId() const;
+        // Ids out of (0, MAX_SCHEDULE_ID] are stored as no schedule (0)
+        void  setScheduleId(int id);
+        bool  isValid() const;
+    };
+
+    // Writes of the tracker (and of its copies) made while a Transaction exists are one
+    // atomic unit, every write method joins it. Nested scopes are savepoints, so a failed
+    // write rolls back only its own changes. A scope that isn't committed is rolled back
+    // when it's destroyed, caches and snapshot are updated for the dates it touched
+    class Transaction
+    {
+    public:
+        explicit Transaction(WorktimeTracker* tracker);
+        ~Transaction();
+
+        bool isActive() const;
+        bool commit();
+        void rollback();
+
+    private:
+        Q_DISABLE_COPY(Transaction)
+
+        WorktimeTracker* m_tracker;
+        bool m_active    = false;
+        bool m_savepoint = false;
+        int  m_level     = 0;
+        int  m_changes   = 0;
+        int  m_schedules = 0;
+
+        QString savepointName() const;
+    };
+
     WorktimeTracker(const QSqlDatabase& db,
                     const QTime& scheduleBegin = QTime(8, 0),
                     const QTime& scheduleEnd = QTime(17, 0),
@@ -46,18 +164,93 @@ public:
     TimeSpan getSummary(const QDate& from, const QDate& to = QDate()) const;
     TimeSpan getSummary(int month, int year = -1);
 
+    // Scheduled time of working days of the range. Without working calendar
+    // only days with records are counted
+    TimeSpan getExpectedTime(const QDate& from, const QDate& to = QDate()) const;
+
+    // Summary of every day, week or month of the range by period begin, computed
+    // in one scan. The first and the last periods are clipped to the range.
+    // Working calendar is applied the same as in getSummary()
+    QMap<QDate, TimeSpan> getSummarySeries(const QDate& from, const QDate& to, SummaryPeriod period) const;
+
+    // Summaries of several employees computed in one scan of the tables.
+    // Employees without records in the range get zero summary. With working calendar
+    // day balances include missing working days as a debt of their whole schedule
+    QMap<int, TimeSpan> getSummaries(const QList<int>& employees, const QDate& from, const QDate& to = QDate()) const;
+    QVector<DayBalance> getDayBalances(const QList<int>& employees, const QDate& from, const QDate& to = QDate()) const;
+
+    // Day balances for summaries by the period. Closed months covered by one period
+    // are replaced with a single day at the month begin holding their frozen balance
+    QVector<DayBalance> getDayBalances(const QList<int>& employees, const QDate& from, const QDate& to,
+                                       SummaryPeriod period) const;
+
     Record getRecord(const QDate& date) const;
     QList<Record> getRecords(const QDate& from, const QDate& to) const;
+    QVector<CompactRecord> getCompactRecords(const QDate& from, const QDate& to) const;
+
+    // Page of at most 'count' records after (Forward) or before (Backward) the
+    // cursor date, invalid cursor means the first or the last page. Records of a page
+    // are sorted by date. 'next' is the cursor of the following page in the same
+    // direction, it's invalid if there are no more records. Pages are found by
+    // the primary key, so deep pages cost the same as the first one
+    enum class PageDirection
+    {
+        Forward,
+        Backward
+    };
+    QList<Record> getRecordPage(const QDate& cursor, int count,
+                                PageDirection direction = PageDirection::Forward,
+                                QDate* next = nullptr) const;
+    Record toRecord(const CompactRecord& r) const;
 
     bool insertRecord(const QDate& date,
                       const QTime& checkIn,
                       const QTime& checkOut,
                       const QString& schedule = DEFAULT_SCHEDULE_NAME);
     bool insertRecord(const QDate& date);
+    bool insertRecords(const QList<Record>& records, QList<int>* rejected = nullptr);
+
+    // Inserts records for days of the range without them, the same as insertRecord(date)
+    // for each day, in one transaction. Only days accepted by 'isWorkingDay' are filled,
+    // all days if it's empty. Days of closed months are skipped
+    bool fillMissingDays(const QDate& from, const QDate& to,
+                         const std::function<bool(const QDate&)>& isWorkingDay = nullptr);
+
+    // Raw punches of badge readers are appended to the punchevent table which is never
+    // updated, so addPunch() is one sequential insert. aggregatePunches() folds punches
+    // added after the previous aggregation into worktime and leavepass rows of all
+    // employees and moves the high-water mark. Every day with new punches is computed
+    // again from all its punches: the first In is the check in, the last Out is the
+    // check out and each Out - In gap is a leave pass with PUNCH_COMMENT clipped to the
+    // schedule. Only leave passes made by the aggregation are replaced. Days of closed
+    // months are put aside and aggregated once their month is reopened. Returns the
+    // number of punches after the previous high-water mark or -1 on error
+    enum class PunchKind
+    {
+        In,
+        Out
+    };
+    static constexpr auto PUNCH_COMMENT = "punch";
+
+    bool   addPunch(const QDateTime& time, PunchKind kind, const QString& source = QString());
+    int    aggregatePunches();
+    qint64 punchHighWaterMark() const;
 
 
     Schedule getScheduleBeforeDate(const QDate& date) const;
+    // Schedule assigned to the date, invalid if there is no assignment covering it
+    Schedule getAssignedSchedule(const QDate& date) const;
+    // Schedule of a new record of the date: the assigned one, the one of the previous
+    // record or the default schedule
+    Schedule getScheduleForDate(const QDate& date) const;
     Schedule getSchedule(const QString& type) const;
+    Schedule getSchedule(int id) const;
+    ScheduleRef scheduleRef(const QString& name) const;
+    ScheduleRef scheduleRef(int id) const;
+    // Schedules are assigned to date ranges stored in scheduleassignment table,
+    // so the assignment is one write regardless of the range length. A range without
+    // records is assigned ahead for days filled later. Assigned schedule takes precedence over
+    // the one a record had, a record inserted later with an explicit schedule keeps it
     bool setSchedule(const QString& schedule, const QDate& from, const QDate& to = QDate());
     bool insertSchedule(const QString& schedule,
                         const QTime& begin,
@@ -69,6 +262,7 @@ public:
     bool setCheckOut(const QTime& time = QTime(), const QDate& from = QDate(), const QDate& to = QDate());
 
     QList<LeavePass> getLeavePassList(const QDate& date) const;
+    LeavePassMap getLeavePasses(const QDate& from, const QDate& to) const;
     bool insertLeavePass(const QTime& from, const QTime& to, const QDate& date = QDate(), const QString& comment = QString());
     bool setLeavePassBegin(const QTime& time, const QDate& date = QDate(), int id = 0);
     bool setLeavePassEnd(const QTime& time, const QDate& date = QDate(), int id = 0);
@@ -76,15 +270,162 @@ public:
 
     Schedule defaultSchedule() const;
 
+    // All records and leave passes belong to an employee. Tracker reads and
+    // writes data of the current employee only, it's 0 by default
+    int  employee() const;
+    void setEmployee(int employee);
+
+    // With snapshot enabled getSummary() is computed from an in-memory copy
+    // of the tables. The snapshot is updated by the write methods of the tracker and
+    // by notifyDataChanged(), call refreshSnapshot() after the database is modified
+    // by someone else
+    bool setSnapshotEnabled(bool enabled);
+    bool isSnapshotEnabled() const;
+    bool refreshSnapshot();
+    const WorktimeSnapshot* snapshot() const;
+
+    // With snapshot enabled the tracker publishes an immutable WorktimeState after
+    // each committed write (a pending group commit isn't published until it's flushed),
+    // after refreshSnapshot(), notifyDataChanged() and when the employee changes. state() is
+    // an atomic load of the latest version, so other threads read it without locks while
+    // the tracker writes. It's null while snapshot is disabled. state() and notifyDataChanged()
+    // must not race with setEmployee() and setSnapshotEnabled() of the same tracker object
+    std::shared_ptr<const WorktimeState> state() const;
+
+    // With working calendar getSummary() counts each working day without record
+    // as a debt of its whole schedule. Schedule of such day is the assigned one or
+    // the one of the previous record, the same as for insertRecord(date).
+    // The calendar is stored in database, so balances of closed months can be
+    // computed again the same way, and it's shared by all copies of the tracker
+    bool setWorkingCalendar(const WorkingCalendar& calendar);
+    bool clearWorkingCalendar();
+    std::shared_ptr<const WorkingCalendar> workingCalendar() const;
+
+    // Balance of a closed month is frozen, getSummary() takes it from the closedperiod
+    // table instead of computing its days. Writes into closed months are rejected
+    // until the month is reopened
+    bool closeMonth(int month, int year);
+    bool reopenMonth(int month, int year);
+    bool isClosed(const QDate& date) const;
+    QList<QDate> closedMonths() const;
+
+    // With group commit writes made out of Transaction scopes are collected into one
+    // transaction, which is committed by the write that makes it 'maxMutations' long,
+    // by a timer 'maxDelay' ms (if it's not 0) after the first write, by flushGroupCommit()
+    // or when group commit is disabled. The timer needs an event loop on the thread of
+    // the tracker. Trackers of one connection share the group. Reads through the connection
+    // see pending writes, other connections don't. If the commit fails, all writes of
+    // the group are lost. maxMutations 0 disables group commit
+    void setGroupCommit(int maxMutations, int maxDelay = 0);
+    bool flushGroupCommit();
+
+    // Results of getSummary() are cached. Write methods of the tracker invalidate
+    // cached ranges they touch, call clearSummaryCache() after the database is
+    // modified by someone else. Capacity 0 disables the cache
+    void setSummaryCacheCapacity(int capacity);
+    int  summaryCacheCapacity() const;
+    void clearSummaryCache();
+
+    // Listeners are called after a write method of the tracker or of any copy of it
+    // modifies data of 'employee' in [from, to]. Invalid range means that any data
+    // could be changed: the database was modified by someone else (clearSummaryCache(),
+    // refreshSnapshot()) or working calendar was replaced. Listeners are called
+    // on the thread of the write without any lock held, so they may write through
+    // the tracker and add or remove listeners. removeChangeListener() waits for calls
+    // in progress on other threads, after it returns the listener isn't called anymore
+    typedef std::function<void(int employee, const QDate& from, const QDate& to)> ChangeListener;
+    int  addChangeListener(const ChangeListener& listener) const;
+    void removeChangeListener(int id) const;
+
+    // Reports a write of data of 'employee' in [from, to] made through another
+    // connection, e.g. by WorktimeWriter: cached summaries of the range are invalidated,
+    // a new state with the range reloaded through 'db' is published and change listeners
+    // are called. 'db' must be usable on the calling thread, it's the connection of the
+    // tracker if invalid. The snapshot of the tracker reloads the range on its next read
+    void notifyDataChanged(int employee, const QDate& from, const QDate& to,
+                           const QSqlDatabase& db = QSqlDatabase()) const;
+
+    QSqlDatabase database() const;
+
+    // Records, leave passes and schedules are read and written through the storage,
+    // it's SqlWorktimeStorage on the connection of the tracker by default and it's
+    // shared by copies of the tracker. Summaries, assignment reads and punches still query
+    // the tables, so a storage which doesn't write through to the tables of the tracker's
+    // connection is rejected (e.g. MemoryWorktimeStorage without SqlWorktimeStorage behind it).
+    // Caching storages drop their data when a transaction is rolled back and on
+    // refreshSnapshot(), they don't see writes of other connections
+    bool setStorage(const std::shared_ptr<WorktimeStorage>& storage);
+    std::shared_ptr<WorktimeStorage> storage() const;
+
 private:
     QSqlDatabase m_db;
+    int          m_employee = 0;
+
+    std::shared_ptr<WorktimeStorage> m_storage;
 
     Schedule m_defaultSchedule;
     static constexpr auto DEFAULT_SCHEDULE_NAME = "default";
 
+    struct ScheduleTable;
+    std::shared_ptr<ScheduleTable> m_schedules;
+
+    std::shared_ptr<WorktimeSnapshot> m_snapshot;
+
+    struct PublishedState;
+    std::shared_ptr<PublishedState> m_published;
+    std::shared_ptr<SummaryCache>     m_summaryCache;
+    std::shared_ptr<std::shared_ptr<const WorkingCalendar>> m_calendar;
+
+    struct ChangeListeners;
+    std::shared_ptr<ChangeListeners> m_changeListeners;
+
+    struct LeavePassIndexes;
+    std::shared_ptr<LeavePassIndexes> m_leavePassIndexes;
+
+    struct TransactionState;
+    std::shared_ptr<TransactionState> m_transaction;
+    static std::shared_ptr<TransactionState> transactionState(const QSqlDatabase& db);
+    void scheduleGroupFlush();
+
     void initWorktimeTable();
     void initLeavepassTable();
     void initScheduleTable();
+    void initClosedPeriodTable();
+    void initScheduleAssignmentTable();
+    void initPunchEventTable();
+    void initWorkingCalendarTable();
+    QHash<QString, QString> tableColumns(const QString& table) const;
+    bool migrateTable(const QString& table, const QString& definition,
+                      const QStringList& columns, const QStringList& values);
+    void loadWorkingCalendar();
+    void loadSchedules();
+    const Schedule* internSchedule(const Schedule& schedule) const;
+    void dataChanged(const QDate& from, const QDate& to = QDate());
+    void dataChanged(int employee, const QDate& from, const QDate& to);
+    QDate invalidationEnd(int employee, const QDate& to, const QSqlDatabase& db) const;
+    void recordChange(int employee, const QDate& from, const QDate& to);
+    void rolledBack(int changes, bool schedules);
+    void notifyChange(int employee, const QDate& from, const QDate& to) const;
+    void publishState();
+    void publishNotifiedRange(const QDate& from, const QDate& to, const QSqlDatabase& db) const;
+    void reloadNotifiedRanges() const;
+    void reloadNotifiedRangesLocked() const;
+    TimeSpan calculateSummary(const QDate& from, const QDate& to, bool* ok) const;
+    TimeSpan calculateOpenSummary(const QDate& from, const QDate& to, bool* ok, bool* valid) const;
+    TimeSpan calculateRecordSummary(const QDate& from, const QDate& to, bool* ok, bool* valid) const;
+    qint64 scheduledTime(const QDate& from, const QDate& to, bool missingDaysOnly, bool* ok) const;
+    QVector<DayBalance> missingDayBalances(const QList<int>& employees, const QDate& from, const QDate& to,
+                                           const WorkingCalendar& calendar,
+                                           const QVector<DayBalance>& days,
+                                           const QVector<int>& scheduleIds, bool* ok) const;
+    QMap<QDate, qint64> closedBalances(const QDate& from, const QDate& to, bool* ok) const;
+    QHash<int, QMap<QDate, qint64>> closedBalances(const QList<int>& employees, const QDate& from, const QDate& to,
+                                                   bool* ok) const;
+    bool hasClosedMonths(const QDate& from, const QDate& to) const;
+    bool hasClosedMonths(int employee, const QDate& from, const QDate& to) const;
+    bool aggregatePunchDay(int employee, const QDate& date);
+    bool keepRecordSchedule(int id, const QDate& date);
+    bool hasScheduleAssignments() const;
 
     inline QString dateToString(const QDate& date) const {
         return date.toString(Qt::ISODate);
@@ -94,24 +435,31 @@ private:
     }
 
     inline QDate stringToDate(const QString& str) const {
-        return QDate::fromString(str, Qt::ISODate);
+        return parseIsoDate(str);
     }
     inline QTime stringToTime(const QString& str) const {
-        return QTime::fromString(str, Qt::ISODate);
+        return parseIsoTime(str);
     }
 
-    bool updateColumnData(const QString &table,
-                          const QString& column,
-                          const QDate &from,
-                          const QDate& to,
-                          const QString &data,
-                          const QString& additionalCondition = QString()) const;
-
-    bool updateLeavePassData(const QString& column,
-                             const QDate& date,
-                             int id,
-                             const QString& data,
-                             const QString& additionalCondition = QString()) const;
+    // Column indexes are resolved once per statement instead of
+    // looking up every value by column name
+
+    struct RecordColumns
+    {
+        int date, schedule, checkIn, checkOut;
+    };
+
+    static RecordColumns recordColumns(const QSqlQuery& query);
+
+    Record readRecord(const QSqlQuery& query, const RecordColumns& columns) const;
+    bool readLeavePasses(const QDate& from, const QDate& to, LeavePassMap* map) const;
+
+    bool updateLeavePass(const QDate& date, int id, const std::function<bool(LeavePass*)>& update) const;
+
+    bool leavePassIndex(const QDate& date, LeavePassIndex* index) const;
+    void indexLeavePass(int employee, const LeavePass& pass) const;
+    void invalidateLeavePassIndexes(int employee, const QDate& from, const QDate& to) const;
+    void clearLeavePassIndexes() const;
 };
 
 #endif // WORKTIMETRACKER_H
@@ -0,0 +1,227 @@
+#include "worktimewriter.h"
+#include <QSqlError>
+#include <QThread>
+#include <QDebug>
+#include <memory>
+
+WorktimeWriter::WorktimeWriter(const WorktimeTracker &tracker, int maxBatchSize)
+    : m_tracker(tracker),
+      m_maxBatchSize(qMax(1, maxBatchSize)),
+      m_batches(0),
+      m_head(&m_stub),
+      m_tail(&m_stub),
+      m_pending(0)
+{
+    m_stub.next = nullptr;
+    m_thread = std::thread(&WorktimeWriter::run, this);
+}
+
+WorktimeWriter::~WorktimeWriter()
+{
+    submit(nullptr);
+    m_thread.join();
+}
+
+std::future<bool> WorktimeWriter::setCheckIn(int employee, const QTime &time, const QDate &date)
+{
+    return submit([=](WorktimeTracker* tracker) {
+        tracker->setEmployee(employee);
+        return tracker->setCheckIn(time, date, date);
+    });
+}
+
+std::future<bool> WorktimeWriter::setCheckOut(int employee, const QTime &time, const QDate &date)
+{
+    return submit([=](WorktimeTracker* tracker) {
+        tracker->setEmployee(employee);
+        return tracker->setCheckOut(time, date, date);
+    });
+}
+
+std::future<bool> WorktimeWriter::insertRecord(int employee, const QDate &date, const QTime &checkIn, const QTime &checkOut, const QString &schedule)
+{
+    return submit([=](WorktimeTracker* tracker) {
+        tracker->setEmployee(employee);
+        return tracker->insertRecord(date, checkIn, checkOut, schedule);
+    });
+}
+
+std::future<bool> WorktimeWriter::insertRecord(int employee, const QDate &date)
+{
+    return submit([=](WorktimeTracker* tracker) {
+        tracker->setEmployee(employee);
+        return tracker->insertRecord(date);
+    });
+}
+
+std::future<bool> WorktimeWriter::insertLeavePass(int employee, const QTime &from, const QTime &to, const QDate &date, const QString &comment)
+{
+    return submit([=](WorktimeTracker* tracker) {
+        tracker->setEmployee(employee);
+        return tracker->insertLeavePass(from, to, date, comment);
+    });
+}
+
+int WorktimeWriter::batches() const
+{
+    return m_batches;
+}
+
+std::future<bool> WorktimeWriter::submit(const std::function<bool (WorktimeTracker *)> &apply)
+{
+    auto command = new Command;
+    command->apply = apply;
+    auto result = command->result.get_future();
+
+    push(command);
+
+    // Only the producer that makes the queue non-empty wakes the writer up.
+    // The writer checks m_pending under the mutex before sleeping, so the wake up isn't lost
+    if (m_pending.fetch_add(1) == 0) {
+        QMutexLocker locker(&m_mutex);
+        m_wake.wakeOne();
+    }
+
+    return result;
+}
+
+void WorktimeWriter::push(Command *command)
+{
+    command->next.store(nullptr, std::memory_order_relaxed);
+    auto previous = m_head.exchange(command, std::memory_order_acq_rel);
+    previous->next.store(command, std::memory_order_release);
+}
+
+WorktimeWriter::Command *WorktimeWriter::pop()
+{
+    // Returns nullptr if the queue is empty or a push is in progress
+    auto tail = m_tail;
+    auto next = tail->next.load(std::memory_order_acquire);
+
+    if (tail == &m_stub) {
+        if (!next)
+            return nullptr;
+        m_tail = next;
+        tail   = next;
+        next   = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+        m_tail = next;
+        return tail;
+    }
+
+    if (tail != m_head.load(std::memory_order_acquire))
+        return nullptr;
+
+    // The last command is taken only when there is a node after it
+    push(&m_stub);
+
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        m_tail = next;
+        return tail;
+    }
+
+    return nullptr;
+}
+
+QVector<WorktimeWriter::Command*> WorktimeWriter::take()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_pending.load() == 0)
+            m_wake.wait(&m_mutex);
+    }
+
+    int count = qMin(m_pending.load(), m_maxBatchSize);
+
+    QVector<Command*> batch;
+    batch.reserve(count);
+
+    while (batch.size() < count)
+    {
+        // Counted command may be not linked yet by its producer
+        auto command = pop();
+        if (command)
+            batch.append(command);
+        else
+            QThread::yieldCurrentThread();
+    }
+
+    m_pending.fetch_sub(count);
+    return batch;
+}
+
+void WorktimeWriter::run()
+{
+    struct Change
+    {
+        int   employee;
+        QDate from, to;
+    };
+    QVector<Change> changes;
+
+    auto connection = QString("worktime-writer-%1").arg(qulonglong(quintptr(this)));
+    {
+        auto db = QSqlDatabase::cloneDatabase(m_tracker.database().connectionName(), connection);
+
+        std::unique_ptr<WorktimeTracker> tracker;
+        if (db.open()) {
+            auto schedule = m_tracker.defaultSchedule();
+            tracker.reset(new WorktimeTracker(db, schedule.begin, schedule.end, schedule.lunchTimeBegin, schedule.lunchTimeEnd));
+            tracker->addChangeListener([&changes](int employee, const QDate& from, const QDate& to) {
+                changes.append({employee, from, to});
+            });
+        }
+        else {
+            qDebug() << "Can't open connection of worktime writer:" << db.lastError().text();
+        }
+
+        bool stop = false;
+        while (!stop)
+        {
+            auto batch = take();
+
+            // Commands of the batch run in nested savepoints, so a failed command
+            // rolls back only its own writes
+            std::unique_ptr<WorktimeTracker::Transaction> transaction;
+            if (tracker)
+                transaction.reset(new WorktimeTracker::Transaction(tracker.get()));
+
+            for (auto command : batch)
+            {
+                if (!command->apply) {
+                    stop = true;
+                    command->applied = true;
+                    continue;
+                }
+                command->applied = tracker && command->apply(tracker.get());
+            }
+
+            bool committed = transaction && transaction->isActive() && transaction->commit();
+            if (committed) {
+                ++m_batches;
+            }
+            else if (transaction) {
+                qDebug() << "Can't commit worktime writer batch:" << db.lastError().text();
+                for (auto command : batch)
+                    command->applied = false;
+                changes.clear();
+            }
+
+            for (const auto& change : changes)
+                m_tracker.notifyDataChanged(change.employee, change.from, change.to, db);
+            changes.clear();
+
+            for (auto command : batch) {
+                command->result.set_value(command->applied);
+                delete command;
+            }
+        }
+
+        tracker.reset();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connection);
+}
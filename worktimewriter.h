@@ -0,0 +1,89 @@
+#ifndef WORKTIMEWRITER_H
+#define WORKTIMEWRITER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <thread>
+#include "worktimetracker.h"
+
+// Single writer of check-ins, check-outs, records and leave passes for many
+// producer threads (badge readers, API handlers). Commands are pushed into a
+// lock-free multi-producer single-consumer queue and applied in order by one
+// thread that owns its own connection to the database, so producers never wait
+// for SQLite's write lock. All commands waiting in the queue (at most
+// maxBatchSize) are applied in one transaction, results are delivered by futures
+// after the commit. If the commit fails, every command of the batch fails.
+//
+// Writes are reported to the tracker by WorktimeTracker::notifyDataChanged()
+// after the commit. The writer reads schedules once when it starts, schedules
+// inserted later are unknown to it. The database must be a file, not :memory:
+
+class WorktimeWriter
+{
+public:
+    static constexpr int DEFAULT_MAX_BATCH_SIZE = 256;
+
+    explicit WorktimeWriter(const WorktimeTracker& tracker, int maxBatchSize = DEFAULT_MAX_BATCH_SIZE);
+
+    // Waits until all queued commands are applied
+    ~WorktimeWriter();
+
+    // The same as the methods of WorktimeTracker for 'employee'
+    std::future<bool> setCheckIn(int employee, const QTime& time, const QDate& date = QDate());
+    std::future<bool> setCheckOut(int employee, const QTime& time, const QDate& date = QDate());
+    std::future<bool> insertRecord(int employee,
+                                   const QDate& date,
+                                   const QTime& checkIn,
+                                   const QTime& checkOut,
+                                   const QString& schedule = "default");
+    std::future<bool> insertRecord(int employee, const QDate& date);
+    std::future<bool> insertLeavePass(int employee,
+                                      const QTime& from,
+                                      const QTime& to,
+                                      const QDate& date = QDate(),
+                                      const QString& comment = QString());
+
+    // Number of committed transactions
+    int batches() const;
+
+private:
+    Q_DISABLE_COPY(WorktimeWriter)
+
+    // Command without 'apply' stops the writer
+    struct Command
+    {
+        std::function<bool(WorktimeTracker*)> apply;
+        bool                  applied = false;
+        std::promise<bool>    result;
+        std::atomic<Command*> next;
+    };
+
+    WorktimeTracker m_tracker;
+    int             m_maxBatchSize;
+    std::atomic<int> m_batches;
+
+    // Intrusive queue: producers exchange m_head, the writer thread owns m_tail.
+    // m_stub keeps the queue non-empty, so push is one exchange and one store
+    std::atomic<Command*> m_head;
+    Command*              m_tail;
+    Command               m_stub;
+
+    // Pushed but not yet taken commands, the writer sleeps while it's zero
+    std::atomic<int> m_pending;
+    QMutex           m_mutex;
+    QWaitCondition   m_wake;
+
+    std::thread m_thread;
+
+    std::future<bool> submit(const std::function<bool(WorktimeTracker*)>& apply);
+    void push(Command* command);
+    Command* pop();
+    QVector<Command*> take();
+    void run();
+};
+
+#endif // WORKTIMEWRITER_H